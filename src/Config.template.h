@@ -20,6 +20,7 @@
 #mesondefine X86_SSE
 #mesondefine X86_SSE2
 #mesondefine X86_SSE3
+#mesondefine X86_AVX2
 #mesondefine _64BIT
 #mesondefine SERVER
 #mesondefine STATICSERVER
@@ -122,8 +123,6 @@
 #define WINDOWW (XRES + BARSIZE)
 #define WINDOWH (YRES + MENUSIZE)
 
-#define GRAV_DIFF
-
 #define MAXSIGNS 16
 
 //CELL, the size of the pressure, gravity, and wall maps. Larger than 1 to prevent extreme lag
@@ -139,6 +138,11 @@
 #define AIR_VLOSS 0.999f
 #define AIR_PLOSS 0.9999f
 
+//Activity tracking, see Simulation::UpdateSleep
+#define SLEEP_FRAMES 30
+#define SLEEP_TEMP_DELTA 0.05f
+#define SLEEP_AIR_DELTA 0.001f
+
 #define NGOL 24
 
 #define CIRCLE_BRUSH 0
@@ -0,0 +1,234 @@
+#include "Config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#include "common/Profiler.h"
+#include "common/String.h"
+
+#include "client/GameSave.h"
+#include "simulation/Air.h"
+#include "simulation/Gravity.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Loads a save or stamp and steps the simulation as fast as it can, without a
+ * window, for batch runs and for timing on machines without a display.
+ *
+ * Usage: headless <save> [frames:N] [out:prefix] [checkpoint:N] [population:N]
+ *                        [threads:N] [tiled] [check] [seed:N] [trace:file]
+ *
+ * Every checkpoint frames, the state is saved as <prefix>-<frame>.cps, which
+ * includes the random seed so that the run can be picked up from there and
+ * come out the same. Every population frames, the number of particles of each
+ * element is added to <prefix>-population.csv. <prefix>-timings.csv gets the
+ * time each frame spent in each phase, in milliseconds. trace writes a Chrome
+ * trace of the whole run, see Profiler. check runs the tiled update's check
+ * instead of the tiled update, see Simulation::CheckTiledUpdate, and prints
+ * how often particles reached further than tiles allow.
+ */
+
+// See PowderToyRenderer.cpp
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	std::map<ByteString, ByteString> readArguments(int argc, char *argv[])
+	{
+		std::map<ByteString, ByteString> arguments;
+
+		//Defaults
+		arguments["frames"] = "1000";
+		arguments["out"] = "headless";
+		arguments["checkpoint"] = "0";
+		arguments["population"] = "0";
+		arguments["threads"] = "";
+		arguments["tiled"] = "false";
+		arguments["check"] = "false";
+		arguments["seed"] = "";
+		arguments["trace"] = "";
+
+		for (int i = 2; i < argc; i++)
+		{
+			char const *colon = strchr(argv[i], ':');
+			if (colon)
+				arguments[ByteString(argv[i], colon - argv[i])] = colon + 1;
+			else
+				arguments[argv[i]] = "true";
+		}
+		return arguments;
+	}
+
+	bool readFile(ByteString filename, std::vector<char> &storage)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+		storage.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	bool writeFile(ByteString filename, std::vector<char> const &fileData)
+	{
+		std::ofstream file(filename.c_str(), std::ios::binary);
+		if (!file.is_open())
+			return false;
+		file.write(fileData.data(), fileData.size());
+		return true;
+	}
+
+	// Applies the options stored in the save the way GameModel::SetSave does
+	void loadSave(Simulation &sim, GameSave &save)
+	{
+		sim.gravityMode = save.gravityMode;
+		sim.air->airMode = save.airMode;
+		sim.edgeMode = save.edgeMode;
+		sim.legacy_enable = save.legacyEnable;
+		sim.water_equal_test = save.waterEEnabled;
+		sim.aheat_enable = save.aheatEnable;
+		sim.pipelineAir = save.pipelineAir;
+		if (save.gravityEnable)
+			sim.grav->start_grav_async();
+		sim.clear_sim();
+		if (save.hasRngSeed)
+		{
+			sim.rngSeed = save.rngSeed;
+			sim.currentTick = save.currentTick;
+		}
+		sim.Load(&save, true);
+		sim.sys_pause = 0;
+	}
+
+	double since(std::chrono::steady_clock::time_point &start)
+	{
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+		start = now;
+		return elapsed;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: " << argv[0] << " <save> [frames:N] [out:prefix] [checkpoint:N] [population:N] [threads:N] [tiled] [check] [seed:N] [trace:file]" << std::endl;
+		return 1;
+	}
+	std::map<ByteString, ByteString> arguments = readArguments(argc, argv);
+	int frames = atoi(arguments["frames"].c_str());
+	int checkpoint = atoi(arguments["checkpoint"].c_str());
+	int population = atoi(arguments["population"].c_str());
+	ByteString out = arguments["out"];
+
+	std::vector<char> inputFile;
+	if (!readFile(argv[1], inputFile))
+	{
+		std::cerr << "Can't open " << argv[1] << std::endl;
+		return 1;
+	}
+	GameSave *save;
+	try
+	{
+		save = new GameSave(inputFile);
+	}
+	catch (ParseException &e)
+	{
+		std::cerr << "Can't load " << argv[1] << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	Simulation *sim = new Simulation();
+	loadSave(*sim, *save);
+	delete save;
+	if (arguments["threads"].length())
+		sim->updateThreads = std::max(1, atoi(arguments["threads"].c_str()));
+	sim->tiledUpdateCheck = arguments["check"] == "true";
+	sim->tiledUpdate = arguments["tiled"] == "true" || sim->tiledUpdateCheck;
+	if (arguments["seed"].length())
+		sim->rngSeed = strtoull(arguments["seed"].c_str(), nullptr, 0);
+	if (arguments["trace"].length() && frames > 0)
+		Profiler::Ref().StartTrace(arguments["trace"], frames, 0);
+
+	std::ofstream timings((out + "-timings.csv").c_str());
+	timings << "frame,particles,BeforeSim,UpdateParticles,AfterSim" << std::endl;
+	std::ofstream populations;
+	if (population > 0)
+	{
+		populations.open((out + "-population.csv").c_str());
+		populations << "frame,element,count" << std::endl;
+	}
+
+	double total[3] = { 0, 0, 0 };
+	auto started = std::chrono::steady_clock::now();
+	for (int frame = 1; frame <= frames; frame++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		double phase[3];
+		sim->BeforeSim();
+		phase[0] = since(start);
+		sim->UpdateParticles(0, NPART);
+		phase[1] = since(start);
+		sim->AfterSim();
+		phase[2] = since(start);
+		Profiler::Ref().EndFrame();
+
+		// Counted here rather than taken from elementCount, which is only
+		// brought up to date every few frames
+		int count[PT_NUM] = {};
+		int particles = 0;
+		for (int i = 0; i <= sim->parts_lastActiveIndex; i++)
+			if (sim->parts[i].type)
+			{
+				count[sim->parts[i].type]++;
+				particles++;
+			}
+
+		timings << frame << "," << particles;
+		for (int i = 0; i < 3; i++)
+		{
+			timings << "," << phase[i];
+			total[i] += phase[i];
+		}
+		timings << std::endl;
+
+		if (population > 0 && !(frame % population))
+			for (int t = 1; t < PT_NUM; t++)
+				if (count[t])
+					populations << frame << "," << sim->elements[t].Name.ToUtf8() << "," << count[t] << std::endl;
+
+		if (checkpoint > 0 && !(frame % checkpoint))
+		{
+			GameSave *state = sim->Save(true);
+			ByteString filename = ByteString::Build(out, "-", frame, ".cps");
+			if (!writeFile(filename, state->Serialise()))
+				std::cerr << "Can't write " << filename << std::endl;
+			delete state;
+		}
+	}
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+	std::cout << "frames " << frames << std::endl;
+	std::cout << "time " << elapsed << " ms" << std::endl;
+	if (elapsed > 0)
+		std::cout << "fps " << frames * 1000.0 / elapsed << std::endl;
+	if (frames)
+	{
+		std::cout << "BeforeSim " << total[0] / frames << " ms/frame" << std::endl;
+		std::cout << "UpdateParticles " << total[1] / frames << " ms/frame" << std::endl;
+		std::cout << "AfterSim " << total[2] / frames << " ms/frame" << std::endl;
+	}
+	if (sim->tiledUpdateCheck)
+		std::cout << "overreach " << sim->tiledUpdateOverreach << std::endl;
+	delete sim;
+	return 0;
+}
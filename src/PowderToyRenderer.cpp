@@ -14,14 +14,6 @@
 #include "client/GameSave.h"
 #include "simulation/Simulation.h"
 
-
-void EngineProcess() {}
-void ClipboardPush(ByteString) {}
-ByteString ClipboardPull() { return ""; }
-int GetModifiers() { return 0; }
-void SetCursorEnabled(int enabled) {}
-unsigned int GetTicks() { return 0; }
-
 void readFile(ByteString filename, std::vector<char> & storage)
 {
 	std::ifstream fileStream;
@@ -39,6 +39,8 @@
 #include "Format.h"
 #include "Misc.h"
 
+#include "common/Profiler.h"
+
 #include "graphics/Graphics.h"
 
 #include "client/SaveInfo.h"
@@ -591,6 +593,7 @@ void EngineProcess()
 			blit(engine->g->vid);
 #endif
 		}
+		Profiler::Ref().EndFrame();
 
 		int frameTime = SDL_GetTicks() - frameStart;
 		frameTimeAvg = frameTimeAvg * 0.8 + frameTime * 0.2;
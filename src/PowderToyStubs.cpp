@@ -0,0 +1,12 @@
+#include "Config.h"
+
+#include "PowderToy.h"
+
+// What PowderToySDL.cpp provides to the rest of the game, for the programs that
+// are built without the GUI: the renderer, the headless runner and the benchmarks
+void EngineProcess() {}
+void ClipboardPush(ByteString) {}
+ByteString ClipboardPull() { return ""; }
+int GetModifiers() { return 0; }
+void SetCursorEnabled(int enabled) {}
+unsigned int GetTicks() { return 0; }
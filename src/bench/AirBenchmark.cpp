@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "Bench.h"
+#include "simulation/Air.h"
+#include "simulation/Simulation.h"
+#include "simulation/VectorFloat.h"
+
+/*
+ * Compares the scalar and vector paths of Air::update_air. Both start from
+ * the same air state; the benchmark reports cells per second for each and the
+ * largest difference in pressure and velocity after one and after many
+ * updates. It also times Air::update_airh on 1, 2 and 4 threads.
+ *
+ * Usage: bench_air [save file] [frames to run first]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	const int cells = (XRES / CELL) * (YRES / CELL);
+
+	struct AirState
+	{
+		float vx[YRES / CELL][XRES / CELL], vy[YRES / CELL][XRES / CELL], pv[YRES / CELL][XRES / CELL];
+		float ovx[YRES / CELL][XRES / CELL], ovy[YRES / CELL][XRES / CELL], opv[YRES / CELL][XRES / CELL];
+
+		void Save(Air const &air)
+		{
+			std::memcpy(vx, air.vx, sizeof(vx));
+			std::memcpy(vy, air.vy, sizeof(vy));
+			std::memcpy(pv, air.pv, sizeof(pv));
+			std::memcpy(ovx, air.ovx, sizeof(ovx));
+			std::memcpy(ovy, air.ovy, sizeof(ovy));
+			std::memcpy(opv, air.opv, sizeof(opv));
+		}
+
+		void Restore(Air &air) const
+		{
+			std::memcpy(air.vx, vx, sizeof(vx));
+			std::memcpy(air.vy, vy, sizeof(vy));
+			std::memcpy(air.pv, pv, sizeof(pv));
+			std::memcpy(air.ovx, ovx, sizeof(ovx));
+			std::memcpy(air.ovy, ovy, sizeof(ovy));
+			std::memcpy(air.opv, opv, sizeof(opv));
+		}
+	};
+
+	float MaxDifference(AirState const &a, AirState const &b)
+	{
+		float diff = 0;
+		for (int y = 0; y < YRES / CELL; y++)
+			for (int x = 0; x < XRES / CELL; x++)
+			{
+				diff = std::max(diff, std::abs(a.vx[y][x] - b.vx[y][x]));
+				diff = std::max(diff, std::abs(a.vy[y][x] - b.vy[y][x]));
+				diff = std::max(diff, std::abs(a.pv[y][x] - b.pv[y][x]));
+			}
+		return diff;
+	}
+
+	void Run(Air &air, bool vectorise, int updates)
+	{
+		air.vectorise = vectorise;
+		for (int i = 0; i < updates; i++)
+			air.update_air();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Simulation *sim = new Simulation();
+	if (!BenchSetup(*sim, argc > 1 ? argv[1] : nullptr))
+		return 1;
+	int frames = argc > 2 ? atoi(argv[2]) : 10;
+	for (int i = 0; i < frames; i++)
+		BenchFrame(*sim);
+
+	Air &air = *sim->air;
+	// Blobs of pressure and a few walls, so the stencils have something to move around and go around
+	for (int y = 0; y < YRES / CELL; y++)
+		for (int x = 0; x < XRES / CELL; x++)
+		{
+			air.pv[y][x] += 40.0f * std::sin(x * 0.21f) * std::cos(y * 0.17f);
+			if (x % 37 == 20 && y % 23 < 12)
+				air.bmap_blockair[y][x] = 1;
+		}
+	AirState start;
+	start.Save(air);
+
+	BenchReport("implementation", VectorFloat::Width, VECTORFLOAT_NAME);
+	const int repeats = 20, updates = 20;
+	double scalar = BenchTime(repeats, [&]() { start.Restore(air); Run(air, false, updates); });
+	double vector = BenchTime(repeats, [&]() { start.Restore(air); Run(air, true, updates); });
+	BenchReport("scalar", cells * updates / scalar * 1000.0, "cells/s");
+	BenchReport(VECTORFLOAT_NAME, cells * updates / vector * 1000.0, "cells/s");
+	BenchReport("speedup", scalar / vector, "x");
+
+	int const steps[] = { 1, 100 };
+	for (int step : steps)
+	{
+		AirState scalarState, vectorState;
+		start.Restore(air);
+		Run(air, false, step);
+		scalarState.Save(air);
+		start.Restore(air);
+		Run(air, true, step);
+		vectorState.Save(air);
+		BenchReport("maxdiff." + ByteString::Build(step), MaxDifference(scalarState, vectorState), "");
+	}
+
+	for (int n : { 1, 2, 4 })
+	{
+		sim->updateThreads = n;
+		air.pool = n > 1 ? &sim->UpdatePool() : nullptr;
+		double heat = BenchTime(repeats, [&]() {
+			start.Restore(air);
+			for (int i = 0; i < updates; i++)
+				air.update_airh();
+		});
+		BenchReport("heat." + ByteString::Build(n), cells * updates / heat * 1000.0, "cells/s");
+	}
+	delete sim;
+	return 0;
+}
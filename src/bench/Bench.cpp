@@ -0,0 +1,84 @@
+#include "Bench.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "client/GameSave.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/Simulation.h"
+
+bool BenchSetup(Simulation &sim, char const *path)
+{
+	if (path && path[0])
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cerr << "Can't open " << path << std::endl;
+			return false;
+		}
+		std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		try
+		{
+			GameSave save(data);
+			sim.Load(&save, true);
+		}
+		catch (ParseException &e)
+		{
+			std::cerr << "Can't load " << path << ": " << e.what() << std::endl;
+			return false;
+		}
+		sim.sys_pause = 0;
+		return true;
+	}
+
+	// Bands of powders, liquids, gases and solids over the whole screen
+	static const int types[] = {
+		PT_DUST, PT_WATR, PT_OIL, PT_GAS, PT_SAND, PT_SALT, PT_METL, PT_WOOD,
+		PT_LAVA, PT_SNOW, PT_ACID, PT_PLNT, PT_BCOL, PT_NITR, PT_GLAS, PT_STNE,
+	};
+	int ntypes = sizeof(types) / sizeof(types[0]);
+	for (int y = CELL; y < YRES - CELL; y++)
+		for (int x = CELL; x < XRES - CELL; x++)
+			sim.create_part(-2, x, y, types[((y - CELL) / 24 + (x - CELL) / 48) % ntypes]);
+	sim.aheat_enable = 1;
+	return true;
+}
+
+int BenchCountParticles(Simulation const &sim)
+{
+	int count = 0;
+	for (int i = 0; i <= sim.parts_lastActiveIndex; i++)
+		if (sim.parts[i].type)
+			count++;
+	return count;
+}
+
+void BenchFrame(Simulation &sim)
+{
+	sim.BeforeSim();
+	sim.UpdateParticles(0, NPART);
+	sim.AfterSim();
+}
+
+double BenchTime(int repeats, std::function<void()> fn)
+{
+	double best = 0;
+	for (int i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!i || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+void BenchReport(ByteString name, double value, ByteString unit)
+{
+	std::cout << name << " " << value << " " << unit << std::endl;
+}
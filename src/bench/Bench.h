@@ -0,0 +1,33 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include "Config.h"
+
+#include <functional>
+#include "common/String.h"
+
+class Simulation;
+
+/*
+ * Helpers shared by the benchmark programs in this directory. Each program is
+ * a small standalone executable built with -Dbuild_bench=true, prints one
+ * line per measurement and takes an optional save file to run on; without
+ * one it fills the screen with a fixed mix of elements.
+ */
+
+// Loads the save at path into sim, or fills the screen if path is null
+// or empty. Returns false if the save could not be read.
+bool BenchSetup(Simulation &sim, char const *path);
+
+// Number of live particles, without relying on elementCount being current
+int BenchCountParticles(Simulation const &sim);
+
+// Runs one full frame the way GameController::Update does
+void BenchFrame(Simulation &sim);
+
+// Runs fn repeats times and returns the fastest run in milliseconds
+double BenchTime(int repeats, std::function<void()> fn);
+
+// Prints a measurement as "<name> <value> <unit>"
+void BenchReport(ByteString name, double value, ByteString unit);
+
+#endif
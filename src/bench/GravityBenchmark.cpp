@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "Bench.h"
+#include "simulation/GravityDelta.h"
+#include "simulation/GravityFFT.h"
+#include "simulation/VectorFloat.h"
+
+#ifdef GRAVFFT
+# include <fftw3.h>
+#endif
+
+/*
+ * Times the built in FFT gravity solver against summing over all pairs of
+ * cells, which is what builds without FFTW used to do, and against FFTW when
+ * built with it. Accuracy of each is reported as the largest and RMS error in
+ * the field, relative to the largest field value of a direct sum done in
+ * double precision. It also times updating the field for a few changed
+ * cells with GravityDelta, with its error measured the same way.
+ *
+ * Usage: bench_gravity [percentage of cells holding mass]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	const int width = XRES / CELL, height = YRES / CELL, cells = width * height;
+
+	struct Field
+	{
+		std::vector<float> x, y, p;
+		Field() : x(cells), y(cells), p(cells) {}
+	};
+
+	// The old solver without FFTW, masses are skipped if close to zero
+	void Direct(std::vector<float> const &mass, Field &field)
+	{
+		std::fill(field.x.begin(), field.x.end(), 0.0f);
+		std::fill(field.y.begin(), field.y.end(), 0.0f);
+		for (int i = 0; i < height; i++)
+			for (int j = 0; j < width; j++)
+			{
+				float val = mass[i * width + j];
+				if (val < 0.0001f && val > -0.0001f)
+					continue;
+				for (int y = 0; y < height; y++)
+					for (int x = 0; x < width; x++)
+					{
+						if (x == j && y == i)
+							continue;
+						float distance = std::sqrt(float((j - x) * (j - x) + (i - y) * (i - y)));
+						field.x[y * width + x] += M_GRAV * val * (j - x) / (distance * distance * distance);
+						field.y[y * width + x] += M_GRAV * val * (i - y) / (distance * distance * distance);
+					}
+			}
+		for (int i = 0; i < cells; i++)
+			field.p[i] = std::sqrt(field.x[i] * field.x[i] + field.y[i] * field.y[i]);
+	}
+
+	void Reference(std::vector<float> const &mass, std::vector<double> &fx, std::vector<double> &fy)
+	{
+		fx.assign(cells, 0.0);
+		fy.assign(cells, 0.0);
+		for (int i = 0; i < height; i++)
+			for (int j = 0; j < width; j++)
+			{
+				double val = mass[i * width + j];
+				if (val == 0.0)
+					continue;
+				for (int y = 0; y < height; y++)
+					for (int x = 0; x < width; x++)
+					{
+						if (x == j && y == i)
+							continue;
+						double distance = std::sqrt(double((j - x) * (j - x) + (i - y) * (i - y)));
+						fx[y * width + x] += M_GRAV * val * (j - x) / (distance * distance * distance);
+						fy[y * width + x] += M_GRAV * val * (i - y) / (distance * distance * distance);
+					}
+			}
+	}
+
+	void ReportError(ByteString name, Field const &field, std::vector<double> const &fx, std::vector<double> const &fy)
+	{
+		double scale = 0, maxError = 0, sumError = 0;
+		for (int i = 0; i < cells; i++)
+		{
+			scale = std::max(scale, std::sqrt(fx[i] * fx[i] + fy[i] * fy[i]));
+			double ex = field.x[i] - fx[i], ey = field.y[i] - fy[i];
+			double error = std::sqrt(ex * ex + ey * ey);
+			maxError = std::max(maxError, error);
+			sumError += error * error;
+		}
+		BenchReport(name + ".maxerror", maxError / scale, "");
+		BenchReport(name + ".rmserror", std::sqrt(sumError / cells) / scale, "");
+	}
+
+#ifdef GRAVFFT
+	// The same convolution Gravity does with FFTW
+	class FFTWSolver
+	{
+		static const int xblock2 = width * 2, yblock2 = height * 2, tsize = (xblock2 / 2 + 1) * yblock2;
+		float *big, *xbig, *ybig;
+		fftwf_complex *bigt, *xbigt, *ybigt, *ptxt, *ptyt;
+		fftwf_plan plan, planX, planY;
+
+	public:
+		FFTWSolver()
+		{
+			big = fftwf_alloc_real(xblock2 * yblock2);
+			xbig = fftwf_alloc_real(xblock2 * yblock2);
+			ybig = fftwf_alloc_real(xblock2 * yblock2);
+			bigt = fftwf_alloc_complex(tsize);
+			xbigt = fftwf_alloc_complex(tsize);
+			ybigt = fftwf_alloc_complex(tsize);
+			ptxt = fftwf_alloc_complex(tsize);
+			ptyt = fftwf_alloc_complex(tsize);
+			plan = fftwf_plan_dft_r2c_2d(yblock2, xblock2, big, bigt, FFTW_MEASURE);
+			planX = fftwf_plan_dft_c2r_2d(yblock2, xblock2, xbigt, xbig, FFTW_MEASURE);
+			planY = fftwf_plan_dft_c2r_2d(yblock2, xblock2, ybigt, ybig, FFTW_MEASURE);
+
+			float scaleFactor = -M_GRAV / (xblock2 * yblock2);
+			for (int component = 0; component < 2; component++)
+			{
+				std::fill(big, big + xblock2 * yblock2, 0.0f);
+				for (int y = 0; y < yblock2; y++)
+					for (int x = 0; x < xblock2; x++)
+					{
+						if (x == width && y == height)
+							continue;
+						float distance = std::sqrt(float((x - width) * (x - width) + (y - height) * (y - height)));
+						float d = component ? float(y - height) : float(x - width);
+						big[y * xblock2 + x] = scaleFactor * d / (distance * distance * distance);
+					}
+				fftwf_execute(plan);
+				std::copy(&bigt[0][0], &bigt[tsize][0], component ? &ptyt[0][0] : &ptxt[0][0]);
+			}
+			std::fill(big, big + xblock2 * yblock2, 0.0f);
+		}
+
+		~FFTWSolver()
+		{
+			fftwf_destroy_plan(plan);
+			fftwf_destroy_plan(planX);
+			fftwf_destroy_plan(planY);
+			fftwf_free(big);
+			fftwf_free(xbig);
+			fftwf_free(ybig);
+			fftwf_free(bigt);
+			fftwf_free(xbigt);
+			fftwf_free(ybigt);
+			fftwf_free(ptxt);
+			fftwf_free(ptyt);
+		}
+
+		void Solve(std::vector<float> const &mass, Field &field)
+		{
+			for (int y = 0; y < height; y++)
+				std::copy(&mass[y * width], &mass[(y + 1) * width], &big[(y + height) * xblock2 + width]);
+			fftwf_execute(plan);
+			for (int i = 0; i < tsize; i++)
+			{
+				float mr = bigt[i][0], mc = bigt[i][1];
+				xbigt[i][0] = mr * ptxt[i][0] - mc * ptxt[i][1];
+				xbigt[i][1] = mr * ptxt[i][1] + mc * ptxt[i][0];
+				ybigt[i][0] = mr * ptyt[i][0] - mc * ptyt[i][1];
+				ybigt[i][1] = mr * ptyt[i][1] + mc * ptyt[i][0];
+			}
+			fftwf_execute(planX);
+			fftwf_execute(planY);
+			for (int y = 0; y < height; y++)
+				for (int x = 0; x < width; x++)
+				{
+					float gx = xbig[y * xblock2 + x], gy = ybig[y * xblock2 + x];
+					field.x[y * width + x] = gx;
+					field.y[y * width + x] = gy;
+					field.p[y * width + x] = std::sqrt(gx * gx + gy * gy);
+				}
+		}
+	};
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	int percentage = argc > 1 ? atoi(argv[1]) : 10;
+	// Scattered masses of both signs, with a few dense blobs
+	std::vector<float> mass(cells, 0.0f);
+	unsigned int seed = 12345;
+	for (int i = 0; i < cells; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		if (int((seed >> 16) % 100) < percentage)
+			mass[i] = float(int((seed >> 8) % 200) - 60) * 0.01f;
+	}
+	for (int y = 40; y < 50; y++)
+		for (int x = 70; x < 80; x++)
+			mass[y * width + x] = 2.0f;
+
+	std::vector<double> fx, fy;
+	Reference(mass, fx, fy);
+
+	BenchReport("implementation", VectorFloat::Width, VECTORFLOAT_NAME);
+	const int repeats = 10;
+	Field field;
+
+	double direct = BenchTime(1, [&]() { Direct(mass, field); });
+	BenchReport("direct", direct, "ms");
+	ReportError("direct", field, fx, fy);
+
+	GravityFFT solver;
+	double builtin = BenchTime(repeats, [&]() { solver.Solve(mass.data(), field.x.data(), field.y.data(), field.p.data()); });
+	BenchReport("builtin", builtin, "ms");
+	ReportError("builtin", field, fx, fy);
+
+	// Field after changing n cells, by adding just their field onto the old one
+	GravityDelta delta;
+	for (int n : { 1, 10, 100, 1000 })
+	{
+		std::vector<float> changed(mass);
+		std::vector<int> cellsChanged;
+		for (int i = 0; i < n; i++)
+		{
+			int cell = (i * 7919) % cells;
+			cellsChanged.push_back(cell);
+			changed[cell] += 0.5f;
+		}
+		Field start, updated;
+		solver.Solve(mass.data(), start.x.data(), start.y.data(), start.p.data());
+		double time = BenchTime(repeats, [&]() {
+			updated = start;
+			for (int cell : cellsChanged)
+				delta.Add(cell, changed[cell] - mass[cell], updated.x.data(), updated.y.data());
+		});
+		BenchReport("delta." + ByteString::Build(n), time, "ms");
+		Reference(changed, fx, fy);
+		ReportError("delta." + ByteString::Build(n), updated, fx, fy);
+	}
+	Reference(mass, fx, fy);
+
+#ifdef GRAVFFT
+	FFTWSolver fftw;
+	double fftwTime = BenchTime(repeats, [&]() { fftw.Solve(mass, field); });
+	BenchReport("fftw", fftwTime, "ms");
+	ReportError("fftw", field, fx, fy);
+	Field builtinField;
+	solver.Solve(mass.data(), builtinField.x.data(), builtinField.y.data(), builtinField.p.data());
+	float diff = 0;
+	for (int i = 0; i < cells; i++)
+	{
+		diff = std::max(diff, std::abs(field.x[i] - builtinField.x[i]));
+		diff = std::max(diff, std::abs(field.y[i] - builtinField.y[i]));
+	}
+	BenchReport("builtin.fftw.maxdiff", diff, "");
+#endif
+	return 0;
+}
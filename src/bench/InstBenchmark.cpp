@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "Bench.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Times Simulation::FloodINST sparking large INST networks: a lattice of wires
+ * that cross each other without connecting, and a solid block. The lattice is
+ * sparked once from a horizontal wire and once from a vertical one. Each run
+ * prints the fastest flood, how many cells were sparked and a checksum of
+ * their positions, which should not change when the implementation does.
+ * Between floods the sparks are turned back into idle INST.
+ *
+ * Usage: bench_inst [floods]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	// Lines of INST every spacing pixels, or a solid block if spacing is 1
+	void Fill(Simulation &sim, int spacing)
+	{
+		for (int y = CELL + 2; y < YRES - CELL - 2; y++)
+			for (int x = CELL + 2; x < XRES - CELL - 2; x++)
+				if (spacing == 1 || !(y % spacing) || !(x % spacing))
+					sim.create_part(-1, x, y, PT_INST);
+	}
+
+	void Reset(Simulation &sim)
+	{
+		for (int i = 0; i <= sim.parts_lastActiveIndex; i++)
+			if (sim.parts[i].type == PT_SPRK)
+			{
+				int x = int(sim.parts[i].x + 0.5f), y = int(sim.parts[i].y + 0.5f);
+				sim.part_change_type(i, x, y, PT_INST);
+				sim.parts[i].life = 0;
+				sim.parts[i].ctype = 0;
+			}
+	}
+
+	void Run(ByteString name, int spacing, int x, int y, int floods)
+	{
+		Simulation *sim = new Simulation();
+		Fill(*sim, spacing);
+		double time = 0;
+		for (int i = 0; i < floods; i++)
+		{
+			Reset(*sim);
+			double flood = BenchTime(1, [&]() {
+				sim->FloodINST(x, y);
+			});
+			time = i ? std::min(time, flood) : flood;
+		}
+		BenchReport(name + ".flood", time, "ms");
+
+		int sparked = 0;
+		unsigned int checksum = 0;
+		for (int yy = 0; yy < YRES; yy++)
+			for (int xx = 0; xx < XRES; xx++)
+				if (TYP(sim->pmap[yy][xx]) == PT_SPRK)
+				{
+					sparked++;
+					checksum = checksum * 31u + unsigned(yy * XRES + xx);
+				}
+		BenchReport(name + ".sparked", sparked, "");
+		std::cout << name << ".checksum " << std::hex << checksum << std::dec << std::endl;
+		delete sim;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int floods = argc > 1 ? atoi(argv[1]) : 20;
+	Run("lattice.horizontal", 4, 101, 100, floods);
+	Run("lattice.vertical", 4, 100, 101, floods);
+	Run("block", 1, 100, 100, floods);
+	return 0;
+}
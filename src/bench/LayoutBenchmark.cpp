@@ -0,0 +1,183 @@
+#include <cstdlib>
+#include <vector>
+
+#include "Bench.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/ParticleSoA.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Compares sweeps over Simulation::parts with the same sweeps over a
+ * ParticleSoA copy. Nothing in Simulation keeps such a copy yet, so a pass
+ * moved over to it would have to gather the particles first. The .soa times
+ * therefore include a Gather of all particles, the .sweep times are the
+ * sweeps alone. None of the sweeps change particles, so they need no Scatter;
+ * roundtrip is what a pass that does would pay on top of its sweep.
+ * The sweeps mirror the member accesses of the hot loops:
+ *  - recalc: type, x, y (RecalcFreeParticles)
+ *  - heat: type, x, y, temp (heat conduction and ambient heat)
+ *  - render: type, x, y, dcolour (Renderer::render_parts)
+ *  - gol: type, x, y, ctype, tmp2 (SimulateGoL)
+ *
+ * Usage: bench_layout [save file] [frames to run first]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	volatile float sink;
+	std::vector<int> pixels(XRES * YRES);
+
+	float RecalcAoS(Simulation &sim, int count)
+	{
+		Particle const *parts = sim.parts;
+		int used = 0;
+		for (int i = 0; i < count; i++)
+			if (parts[i].type)
+			{
+				int x = (int)(parts[i].x + 0.5f), y = (int)(parts[i].y + 0.5f);
+				if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+					pixels[y * XRES + x] = i;
+				used++;
+			}
+		return float(used);
+	}
+
+	float RecalcSoA(ParticleSoA &soa, int count)
+	{
+		int used = 0;
+		for (int i = 0; i < count; i++)
+			if (soa.type[i])
+			{
+				int x = (int)(soa.x[i] + 0.5f), y = (int)(soa.y[i] + 0.5f);
+				if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+					pixels[y * XRES + x] = i;
+				used++;
+			}
+		return float(used);
+	}
+
+	float HeatAoS(Simulation &sim, int count)
+	{
+		Particle const *parts = sim.parts;
+		float total = 0;
+		for (int i = 0; i < count; i++)
+			if (parts[i].type && sim.elements[parts[i].type].HeatConduct)
+			{
+				int x = (int)(parts[i].x + 0.5f), y = (int)(parts[i].y + 0.5f);
+				total += parts[i].temp - sim.hv[y / CELL][x / CELL];
+			}
+		return total;
+	}
+
+	float HeatSoA(Simulation &sim, ParticleSoA &soa, int count)
+	{
+		float total = 0;
+		for (int i = 0; i < count; i++)
+			if (soa.type[i] && sim.elements[soa.type[i]].HeatConduct)
+			{
+				int x = (int)(soa.x[i] + 0.5f), y = (int)(soa.y[i] + 0.5f);
+				total += soa.temp[i] - sim.hv[y / CELL][x / CELL];
+			}
+		return total;
+	}
+
+	float RenderAoS(Simulation &sim, int count)
+	{
+		Particle const *parts = sim.parts;
+		for (int i = 0; i < count; i++)
+			if (parts[i].type)
+			{
+				int x = (int)(parts[i].x + 0.5f), y = (int)(parts[i].y + 0.5f);
+				if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+					pixels[y * XRES + x] = sim.elements[parts[i].type].Colour ^ parts[i].dcolour;
+			}
+		return float(pixels[XRES * YRES / 2]);
+	}
+
+	float RenderSoA(Simulation &sim, ParticleSoA &soa, int count)
+	{
+		for (int i = 0; i < count; i++)
+			if (soa.type[i])
+			{
+				int x = (int)(soa.x[i] + 0.5f), y = (int)(soa.y[i] + 0.5f);
+				if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+					pixels[y * XRES + x] = sim.elements[soa.type[i]].Colour ^ soa.dcolour[i];
+			}
+		return float(pixels[XRES * YRES / 2]);
+	}
+
+	float GolAoS(Simulation &sim, int count)
+	{
+		Particle const *parts = sim.parts;
+		int alive = 0;
+		for (int i = 0; i < count; i++)
+			if (parts[i].type == PT_LIFE)
+			{
+				int x = (int)(parts[i].x + 0.5f), y = (int)(parts[i].y + 0.5f);
+				if (x >= CELL && y >= CELL && x < XRES - CELL && y < YRES - CELL && parts[i].tmp2 == parts[i].ctype + 1)
+					alive++;
+			}
+		return float(alive);
+	}
+
+	float GolSoA(ParticleSoA &soa, int count)
+	{
+		int alive = 0;
+		for (int i = 0; i < count; i++)
+			if (soa.type[i] == PT_LIFE)
+			{
+				int x = (int)(soa.x[i] + 0.5f), y = (int)(soa.y[i] + 0.5f);
+				if (x >= CELL && y >= CELL && x < XRES - CELL && y < YRES - CELL && soa.tmp2[i] == soa.ctype[i] + 1)
+					alive++;
+			}
+		return float(alive);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Simulation *sim = new Simulation();
+	if (!BenchSetup(*sim, argc > 1 ? argv[1] : nullptr))
+		return 1;
+	int frames = argc > 2 ? atoi(argv[2]) : 10;
+	for (int i = 0; i < frames; i++)
+		BenchFrame(*sim);
+
+	int count = sim->parts_lastActiveIndex + 1;
+	int particles = BenchCountParticles(*sim);
+	BenchReport("particles", particles, "");
+	const int repeats = 20;
+
+	ParticleSoA soa;
+	BenchReport("gather", BenchTime(repeats, [&]() { soa.Gather(sim->parts, count); }), "ms");
+	BenchReport("scatter", BenchTime(repeats, [&]() { soa.Scatter(sim->parts); }), "ms");
+	BenchReport("roundtrip", BenchTime(repeats, [&]() { soa.Gather(sim->parts, count); soa.Scatter(sim->parts); }), "ms");
+
+	struct Sweep
+	{
+		ByteString name;
+		std::function<float()> aos, soa;
+	};
+	Sweep sweeps[] = {
+		{ "recalc", [&]() { return RecalcAoS(*sim, count); }, [&]() { return RecalcSoA(soa, count); } },
+		{ "heat", [&]() { return HeatAoS(*sim, count); }, [&]() { return HeatSoA(*sim, soa, count); } },
+		{ "render", [&]() { return RenderAoS(*sim, count); }, [&]() { return RenderSoA(*sim, soa, count); } },
+		{ "gol", [&]() { return GolAoS(*sim, count); }, [&]() { return GolSoA(soa, count); } },
+	};
+	for (auto &sweep : sweeps)
+	{
+		double aos = BenchTime(repeats, [&]() { sink = sweep.aos(); });
+		double sweepTime = BenchTime(repeats, [&]() { sink = sweep.soa(); });
+		double soaTime = BenchTime(repeats, [&]() { soa.Gather(sim->parts, count); sink = sweep.soa(); });
+		BenchReport(sweep.name + ".aos", aos, "ms");
+		BenchReport(sweep.name + ".sweep", sweepTime, "ms");
+		BenchReport(sweep.name + ".soa", soaTime, "ms");
+		BenchReport(sweep.name + ".speedup", aos / soaTime, "x");
+	}
+	delete sim;
+	return 0;
+}
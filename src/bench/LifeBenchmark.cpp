@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "Bench.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Times Simulation::SimulateGoL on a screen filled with LIFE, once with only
+ * GOL and once with a mix of rules that contest cells, including ones with
+ * extra dying states and a custom rule. Each run prints the time per
+ * generation, the live particle count and a checksum of every LIFE particle,
+ * which should not change when the implementation does. GOL is also run ten
+ * generations per SimulateGoL, which should give the same checksum.
+ *
+ * Usage: bench_life [percentage of cells alive] [generations]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	void Run(ByteString name, std::vector<int> const &ctypes, int percentage, int generations, int perCall = 1)
+	{
+		Simulation *sim = new Simulation();
+		sim->golGenerations = perCall;
+		unsigned int seed = 12345;
+		for (int y = CELL; y < YRES - CELL; y++)
+			for (int x = CELL; x < XRES - CELL; x++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				if (int((seed >> 16) % 100) < percentage)
+				{
+					// Kinds come in blobs so that their borders are contested
+					int kind = ((x / 40) * 7 + (y / 40) * 3 + int((seed >> 8) % 2)) % int(ctypes.size());
+					sim->create_part(-1, x, y, PT_LIFE, ctypes[kind]);
+				}
+			}
+
+		double time = BenchTime(1, [&]() {
+			for (int i = 0; i < generations; i += perCall)
+				sim->SimulateGoL();
+		});
+		BenchReport(name + ".generation", time / generations, "ms");
+		BenchReport(name + ".particles", BenchCountParticles(*sim), "");
+
+		unsigned int checksum = 0;
+		for (int y = 0; y < YRES; y++)
+			for (int x = 0; x < XRES; x++)
+			{
+				int r = sim->pmap[y][x];
+				if (!r)
+					continue;
+				auto &part = sim->parts[ID(r)];
+				unsigned int values[] = { unsigned(y * XRES + x), unsigned(part.ctype), unsigned(part.tmp2), unsigned(part.dcolour), unsigned(part.tmp) };
+				for (auto value : values)
+					checksum = checksum * 31u + value;
+			}
+		std::cout << name << ".checksum " << std::hex << checksum << std::dec << std::endl;
+		delete sim;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int percentage = argc > 1 ? atoi(argv[1]) : 40;
+	int generations = argc > 2 ? atoi(argv[2]) : 100;
+	Run("gol", { 0 }, percentage, generations);
+	// The same ten generations at a time, which runs on GOLTiles
+	Run("gol.tiles", { 0 }, percentage, generations, 10);
+	// GOL, HLIF, STAR, BRAN and B36/S23 as a custom rule
+	Run("mixed", { 0, 1, 21, 23, 0x0480C }, percentage, generations);
+	return 0;
+}
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "Bench.h"
+#include "common/Profiler.h"
+#include "common/tpt-rand.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/Gravity.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Runs a fixed set of stress scenes, each for the same number of frames, and
+ * prints the results as JSON so that runs can be compared by a script when
+ * bisecting a slowdown:
+ *
+ *   powder    piles of powders falling onto each other
+ *   water     the screen full of water
+ *   gol       a large field of LIFE
+ *   gravity   powder around black holes with Newtonian gravity on
+ *   furnace   lava and coal heating metal with ambient heat on
+ *   inst      a lattice of INST wires kept sparked by batteries
+ *   portals   sand falling through portals and sparks sent through WIFI
+ *   pipes     water carried through PIPE
+ *
+ * Scenes are built here rather than shipped as saves, from fixed random
+ * seeds, so every run starts from the same state. Save files given on the
+ * command line are run after them.
+ *
+ * For each scene the output has the frames per second, the nanoseconds spent
+ * per particle per frame and the milliseconds per frame spent in each phase
+ * the Profiler knows about. `ninja bench` runs this with the defaults.
+ *
+ * Usage: bench_suite [frames] [save file...]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	void Fill(Simulation &sim, int x1, int y1, int x2, int y2, int type, std::function<bool(int, int)> where = nullptr)
+	{
+		for (int y = y1; y < y2; y++)
+			for (int x = x1; x < x2; x++)
+				if (!sim.pmap[y][x] && (!where || where(x, y)))
+					sim.create_part(-1, x, y, type);
+	}
+
+	// Walls around the edges of the given cells
+	void WallBox(Simulation &sim, int cx1, int cy1, int cx2, int cy2)
+	{
+		for (int cy = cy1; cy <= cy2; cy++)
+			for (int cx = cx1; cx <= cx2; cx++)
+				if (cx == cx1 || cx == cx2 || cy == cy1 || cy == cy2)
+					sim.bmap[cy][cx] = WL_WALL;
+	}
+
+	void Powder(Simulation &sim)
+	{
+		static const int types[] = { PT_DUST, PT_SAND, PT_STNE, PT_SALT, PT_BCOL, PT_SNOW };
+		for (int pile = 0; pile < 6; pile++)
+		{
+			int x1 = CELL + 10 + pile * 100;
+			Fill(sim, x1, CELL + 10, x1 + 80, YRES / 2, types[pile], [pile](int x, int y) {
+				return (x + y + pile) % 3 != 0;
+			});
+		}
+	}
+
+	void Water(Simulation &sim)
+	{
+		Fill(sim, CELL, CELL, XRES - CELL, YRES - CELL, PT_WATR);
+	}
+
+	void Gol(Simulation &sim)
+	{
+		for (int y = CELL; y < YRES - CELL; y++)
+			for (int x = CELL; x < XRES - CELL; x++)
+				if (RNG::Ref().chance(2, 5))
+					sim.create_part(-1, x, y, PT_LIFE, ((x / 60 + y / 60) % 3) ? 0 : 1);
+	}
+
+	void NewtonianGravity(Simulation &sim)
+	{
+		sim.grav->start_grav_async();
+		for (int i = 0; i < 6; i++)
+			sim.create_part(-1, 60 + i * 100, YRES / 2, PT_NBHL);
+		Fill(sim, CELL, CELL, XRES - CELL, YRES - CELL, PT_DUST, [](int x, int y) {
+			return !(x % 3) && !(y % 3);
+		});
+	}
+
+	void Furnace(Simulation &sim)
+	{
+		sim.aheat_enable = 1;
+		WallBox(sim, 10, 10, XRES / CELL - 11, YRES / CELL - 5);
+		int x1 = 11 * CELL, x2 = (XRES / CELL - 11) * CELL, y2 = (YRES / CELL - 5) * CELL;
+		Fill(sim, x1, y2 - 40, x2, y2, PT_LAVA);
+		Fill(sim, x1, y2 - 80, x2, y2 - 40, PT_COAL, [](int x, int y) {
+			return (x / 4 + y / 4) % 2;
+		});
+		Fill(sim, x1 + 20, y2 - 140, x2 - 20, y2 - 120, PT_METL);
+		Fill(sim, x1 + 40, y2 - 200, x2 - 40, y2 - 180, PT_IRON);
+		for (int i = 0; i <= sim.parts_lastActiveIndex; i++)
+			if (sim.parts[i].type == PT_LAVA)
+				sim.parts[i].temp = 3000.0f;
+	}
+
+	void Inst(Simulation &sim)
+	{
+		Fill(sim, CELL + 2, CELL + 2, XRES - CELL - 2, YRES - CELL - 2, PT_INST, [](int x, int y) {
+			return !(x % 4) || !(y % 4);
+		});
+		for (int y = CELL + 6; y < YRES - CELL - 2; y += 40)
+			for (int x = CELL + 6; x < XRES - CELL - 2; x += 40)
+				sim.create_part(-1, x + 1, y + 1, PT_BTRY);
+	}
+
+	void Portals(Simulation &sim)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			int x = 60 + i * 150;
+			Fill(sim, x, 40, x + 60, 100, PT_SAND);
+			Fill(sim, x, 120, x + 60, 124, PT_PRTI);
+			Fill(sim, x, 300, x + 60, 304, PT_PRTO);
+		}
+		// Wires of METL with a battery at one end and WIFI along them
+		for (int y = 200; y < 280; y += 10)
+		{
+			Fill(sim, 40, y, XRES - 40, y + 1, PT_METL);
+			sim.create_part(-1, 39, y, PT_BTRY);
+			for (int x = 60; x < XRES - 40; x += 30)
+				sim.create_part(-1, x, y + 1, PT_WIFI);
+		}
+	}
+
+	void Pipes(Simulation &sim)
+	{
+		Fill(sim, CELL, CELL, 100, YRES - CELL, PT_WATR);
+		// Three pixel thick pipes from the water to the other side, which
+		// turn into a pipe with a BRCK shell once they have run a few frames
+		for (int y = 30; y < YRES - 30; y += 20)
+			Fill(sim, 100, y, XRES - 60, y + 3, PT_PIPE);
+	}
+
+	struct Scene
+	{
+		ByteString name;
+		std::function<void(Simulation &)> setup;
+		ByteString path;
+	};
+
+	ByteString Quote(ByteString s)
+	{
+		ByteString quoted = "\"";
+		for (auto c : s)
+		{
+			if (c == '"' || c == '\\')
+				quoted += '\\';
+			quoted += c;
+		}
+		return quoted + "\"";
+	}
+
+	// Returns false if the scene couldn't be set up, in which case nothing is printed
+	bool Run(Scene const &scene, int frames, bool first)
+	{
+		RNG::Ref().seed(12345);
+		Simulation *sim = new Simulation();
+		sim->rngSeed = 12345;
+		if (scene.setup)
+			scene.setup(*sim);
+		else if (!BenchSetup(*sim, scene.path.c_str()))
+		{
+			delete sim;
+			return false;
+		}
+
+		Profiler &profiler = Profiler::Ref();
+		double phases[Profiler::PhaseCount] = {};
+		double particleFrames = 0;
+		double time = 0;
+		for (int i = 0; i < frames; i++)
+		{
+			particleFrames += BenchCountParticles(*sim);
+			time += BenchTime(1, [sim]() {
+				BenchFrame(*sim);
+			});
+			profiler.EndFrame();
+			for (int phase = 0; phase < Profiler::PhaseCount; phase++)
+				phases[phase] += profiler.History(Profiler::Phase(phase), 0);
+		}
+
+		std::cout << (first ? "" : ",") << "\n\t\t{\n";
+		std::cout << "\t\t\t\"name\": " << Quote(scene.name) << ",\n";
+		std::cout << "\t\t\t\"particles\": " << BenchCountParticles(*sim) << ",\n";
+		std::cout << "\t\t\t\"fps\": " << (time > 0 ? frames * 1000.0 / time : 0) << ",\n";
+		std::cout << "\t\t\t\"nsPerParticle\": " << (particleFrames > 0 ? time * 1e6 / particleFrames : 0) << ",\n";
+		std::cout << "\t\t\t\"phases\": {";
+		bool firstPhase = true;
+		for (int phase = 0; phase < Profiler::PhaseCount; phase++)
+		{
+			// Drawing isn't part of a bench frame
+			if (phase >= Profiler::RenderParts)
+				continue;
+			std::cout << (firstPhase ? "" : ",") << "\n\t\t\t\t\"" << Profiler::PhaseName(Profiler::Phase(phase)) << "\": " << phases[phase] / frames;
+			firstPhase = false;
+		}
+		std::cout << "\n\t\t\t}\n\t\t}";
+		delete sim;
+		return true;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+	std::vector<Scene> scenes = {
+		{ "powder", Powder, "" },
+		{ "water", Water, "" },
+		{ "gol", Gol, "" },
+		{ "gravity", NewtonianGravity, "" },
+		{ "furnace", Furnace, "" },
+		{ "inst", Inst, "" },
+		{ "portals", Portals, "" },
+		{ "pipes", Pipes, "" },
+	};
+	for (int i = 2; i < argc; i++)
+		scenes.push_back({ argv[i], nullptr, argv[i] });
+
+	Profiler::Ref().SetEnabled(true);
+	std::cout << "{\n\t\"frames\": " << frames << ",\n\t\"scenes\": [";
+	bool first = true;
+	for (auto &scene : scenes)
+	{
+		if (Run(scene, frames, first))
+			first = false;
+	}
+	std::cout << "\n\t]\n}" << std::endl;
+	return 0;
+}
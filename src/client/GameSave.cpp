@@ -23,10 +23,14 @@ GameSave::GameSave(GameSave & save):
 	legacyEnable(save.legacyEnable),
 	gravityEnable(save.gravityEnable),
 	aheatEnable(save.aheatEnable),
+	pipelineAir(save.pipelineAir),
 	paused(save.paused),
 	gravityMode(save.gravityMode),
 	airMode(save.airMode),
 	edgeMode(save.edgeMode),
+	hasRngSeed(save.hasRngSeed),
+	rngSeed(save.rngSeed),
+	currentTick(save.currentTick),
 	signs(save.signs),
 	stkm(save.stkm),
 	palette(save.palette),
@@ -170,10 +174,14 @@ void GameSave::InitVars()
 	legacyEnable = false;
 	gravityEnable = false;
 	aheatEnable = false;
+	pipelineAir = false;
 	paused = false;
 	gravityMode = 0;
 	airMode = 0;
 	edgeMode = 0;
+	hasRngSeed = false;
+	rngSeed = 0;
+	currentTick = 0;
 	translated.x = translated.y = 0;
 	pmapbits = 8; // default to 8 bits for older saves
 }
@@ -571,6 +579,23 @@ void GameSave::CheckBsonFieldInt(bson_iterator iter, const char *field, int *set
 	}
 }
 
+bool GameSave::CheckBsonFieldLong(bson_iterator iter, const char *field, uint64_t *setting)
+{
+	if (!strcmp(bson_iterator_key(&iter), field))
+	{
+		if (bson_iterator_type(&iter) == BSON_LONG)
+		{
+			*setting = uint64_t(bson_iterator_long(&iter));
+			return true;
+		}
+		else
+		{
+			fprintf(stderr, "Wrong type for %s\n", bson_iterator_key(&iter));
+		}
+	}
+	return false;
+}
+
 void GameSave::readOPS(char * data, int dataLength)
 {
 	unsigned char *inputData = (unsigned char*)data, *bsonData = NULL, *partsData = NULL, *partsPosData = NULL, *fanData = NULL, *wallData = NULL, *soapLinkData = NULL;
@@ -664,12 +689,16 @@ void GameSave::readOPS(char * data, int dataLength)
 		CheckBsonFieldBool(iter, "legacyEnable", &legacyEnable);
 		CheckBsonFieldBool(iter, "gravityEnable", &gravityEnable);
 		CheckBsonFieldBool(iter, "aheat_enable", &aheatEnable);
+		CheckBsonFieldBool(iter, "pipelineAir", &pipelineAir);
 		CheckBsonFieldBool(iter, "waterEEnabled", &waterEEnabled);
 		CheckBsonFieldBool(iter, "paused", &paused);
 		CheckBsonFieldInt(iter, "gravityMode", &gravityMode);
 		CheckBsonFieldInt(iter, "airMode", &airMode);
 		CheckBsonFieldInt(iter, "edgeMode", &edgeMode);
 		CheckBsonFieldInt(iter, "pmapbits", &pmapbits);
+		if (CheckBsonFieldLong(iter, "rngSeed", &rngSeed))
+			hasRngSeed = true;
+		CheckBsonFieldInt(iter, "currentTick", &currentTick);
 		if (!strcmp(bson_iterator_key(&iter), "signs"))
 		{
 			if (bson_iterator_type(&iter)==BSON_ARRAY)
@@ -2545,6 +2574,14 @@ char * GameSave::serialiseOPS(unsigned int & dataLength)
 	bson_append_bool(&b, "legacyEnable", legacyEnable);
 	bson_append_bool(&b, "gravityEnable", gravityEnable);
 	bson_append_bool(&b, "aheat_enable", aheatEnable);
+	// left out unless set, so that other saves stay as they were
+	if (pipelineAir)
+		bson_append_bool(&b, "pipelineAir", pipelineAir);
+	if (hasRngSeed)
+	{
+		bson_append_long(&b, "rngSeed", int64_t(rngSeed));
+		bson_append_int(&b, "currentTick", currentTick);
+	}
 	bson_append_bool(&b, "paused", paused);
 	bson_append_int(&b, "gravityMode", gravityMode);
 	bson_append_int(&b, "airMode", airMode);
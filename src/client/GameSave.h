@@ -2,6 +2,7 @@
 #define The_Powder_Toy_GameSave_h
 #include "Config.h"
 
+#include <stdint.h>
 #include <vector>
 #include "common/String.h"
 #include "Misc.h"
@@ -93,10 +94,16 @@ public:
 	bool legacyEnable;
 	bool gravityEnable;
 	bool aheatEnable;
+	bool pipelineAir;
 	bool paused;
 	int gravityMode;
 	int airMode;
 	int edgeMode;
+	// Random streams are derived from rngSeed and the tick, so that a run
+	// started from this save can be replayed exactly
+	bool hasRngSeed;
+	uint64_t rngSeed;
+	int currentTick;
 
 	//Signs
 	std::vector<sign> signs;
@@ -149,6 +156,7 @@ private:
 	void CheckBsonFieldUser(bson_iterator iter, const char *field, unsigned char **data, unsigned int *fieldLen);
 	void CheckBsonFieldBool(bson_iterator iter, const char *field, bool *flag);
 	void CheckBsonFieldInt(bson_iterator iter, const char *field, int *setting);
+	bool CheckBsonFieldLong(bson_iterator iter, const char *field, uint64_t *setting);
 	template <typename T> T ** Allocate2DArray(int blockWidth, int blockHeight, T defaultVal);
 	template <typename T> void Deallocate2DArray(T ***array, int blockHeight);
 	void dealloc();
@@ -0,0 +1,194 @@
+#include "LevelPack.h"
+
+#include <cstring>
+#include <fstream>
+#ifdef WIN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GameSave.h"
+
+namespace
+{
+	const char magic[4] = { 'T', 'P', 'T', 'L' };
+	const size_t headerSize = 12;
+	const size_t entrySize = 32;
+
+	uint32_t ReadU32(char const *data)
+	{
+		auto bytes = reinterpret_cast<unsigned char const *>(data);
+		return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+	}
+
+	void WriteU32(std::vector<char> &out, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			out.push_back(char(value >> (i * 8)));
+	}
+}
+
+LevelPack::LevelPack(ByteString path):
+	path(path)
+{
+#ifdef WIN
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		throw ParseException(ParseException::Corrupt, String::Build("Can't open ", path.FromUtf8()));
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart)
+	{
+		size = size_t(fileSize.QuadPart);
+		mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+			data = (char const *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw ParseException(ParseException::Corrupt, String::Build("Can't open ", path.FromUtf8()));
+	struct stat info;
+	if (!fstat(fd, &info) && info.st_size)
+	{
+		size = size_t(info.st_size);
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED)
+			data = (char const *)mapped;
+	}
+	// The mapping stays valid without the descriptor
+	close(fd);
+#endif
+
+	try
+	{
+		if (!data)
+			throw ParseException(ParseException::Corrupt, String::Build("Can't map ", path.FromUtf8()));
+		if (size < headerSize || std::memcmp(data, magic, 4))
+			throw ParseException(ParseException::Corrupt, "Not a level pack");
+		if (ReadU32(data + 4) > Version)
+			throw ParseException(ParseException::WrongVersion, "Level pack is from a newer version");
+		uint32_t count = ReadU32(data + 8);
+		if (count > (size - headerSize) / entrySize)
+			throw ParseException(ParseException::Corrupt, "Level pack index is cut off");
+
+		entries.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			char const *entry = data + headerSize + i * entrySize;
+			Span *spans[] = { &entries[i].name, &entries[i].save, &entries[i].thumbnail, &entries[i].metadata };
+			for (int s = 0; s < 4; s++)
+			{
+				spans[s]->offset = ReadU32(entry + s * 8);
+				spans[s]->size = ReadU32(entry + s * 8 + 4);
+				if (spans[s]->offset > size || spans[s]->size > size - spans[s]->offset)
+					throw ParseException(ParseException::Corrupt, String::Build("Level ", i, " is outside of the level pack"));
+			}
+			names.insert(std::make_pair(Name(i), int(i)));
+		}
+	}
+	catch (ParseException &)
+	{
+		Unmap();
+		throw;
+	}
+}
+
+LevelPack::~LevelPack()
+{
+	Unmap();
+}
+
+void LevelPack::Unmap()
+{
+#ifdef WIN
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data)
+		munmap((void *)data, size);
+#endif
+	data = nullptr;
+}
+
+std::vector<char> LevelPack::Read(Span span) const
+{
+	return std::vector<char>(data + span.offset, data + span.offset + span.size);
+}
+
+ByteString LevelPack::Name(int index) const
+{
+	if (index < 0 || index >= Count())
+		return "";
+	Span span = entries[index].name;
+	return ByteString(data + span.offset, span.size);
+}
+
+int LevelPack::Find(ByteString name) const
+{
+	auto it = names.find(name);
+	return it == names.end() ? -1 : it->second;
+}
+
+std::vector<char> LevelPack::Save(int index) const
+{
+	if (index < 0 || index >= Count())
+		return std::vector<char>();
+	return Read(entries[index].save);
+}
+
+std::vector<char> LevelPack::Thumbnail(int index) const
+{
+	if (index < 0 || index >= Count())
+		return std::vector<char>();
+	return Read(entries[index].thumbnail);
+}
+
+ByteString LevelPack::Metadata(int index) const
+{
+	if (index < 0 || index >= Count())
+		return "";
+	Span span = entries[index].metadata;
+	return ByteString(data + span.offset, span.size);
+}
+
+bool LevelPack::Write(ByteString path, std::vector<Level> const &levels)
+{
+	std::vector<char> index, blobs;
+	index.insert(index.end(), magic, magic + 4);
+	WriteU32(index, Version);
+	WriteU32(index, uint32_t(levels.size()));
+	size_t dataStart = headerSize + levels.size() * entrySize;
+	auto add = [&](char const *begin, char const *end) {
+		WriteU32(index, uint32_t(dataStart + blobs.size()));
+		WriteU32(index, uint32_t(end - begin));
+		blobs.insert(blobs.end(), begin, end);
+	};
+	for (auto &level : levels)
+	{
+		add(level.name.data(), level.name.data() + level.name.size());
+		add(level.save.data(), level.save.data() + level.save.size());
+		add(level.thumbnail.data(), level.thumbnail.data() + level.thumbnail.size());
+		add(level.metadata.data(), level.metadata.data() + level.metadata.size());
+	}
+	if (dataStart + blobs.size() > UINT32_MAX)
+		return false;
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+	file.write(index.data(), index.size());
+	file.write(blobs.data(), blobs.size());
+	return bool(file);
+}
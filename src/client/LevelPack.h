@@ -0,0 +1,89 @@
+#ifndef LEVELPACK_H
+#define LEVELPACK_H
+#include "Config.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "common/String.h"
+
+/*
+ * A single file of levels for LoadNextSave, in place of loose saves. The
+ * index at the start says where each level's data is, and the file is mapped
+ * into memory rather than read, so opening a pack of any size only reads its
+ * index and any level can be loaded without looking at the others.
+ *
+ * All numbers are 32 bit little endian:
+ *
+ *   "TPTL", version, number of levels
+ *   per level: offset and size of its name, save, thumbnail and metadata
+ *   the data the index points at
+ *
+ * Saves are kept as GameSave::Serialise writes them, which is compressed
+ * already. Thumbnails are PTI images, see Graphics::ptif_pack, and may be
+ * left out. Metadata is a JSON object.
+ */
+class LevelPack
+{
+public:
+	struct Level
+	{
+		ByteString name;
+		std::vector<char> save;
+		std::vector<char> thumbnail;
+		ByteString metadata;
+	};
+
+private:
+	struct Span
+	{
+		uint32_t offset, size;
+	};
+	struct Entry
+	{
+		Span name, save, thumbnail, metadata;
+	};
+
+	ByteString path;
+	char const *data = nullptr;
+	size_t size = 0;
+#ifdef WIN
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+
+	std::vector<Entry> entries;
+	std::map<ByteString, int> names;
+
+	std::vector<char> Read(Span span) const;
+	void Unmap();
+
+public:
+	static const uint32_t Version = 1;
+
+	// Throws ParseException if the file can't be opened or isn't a level pack
+	LevelPack(ByteString path);
+	~LevelPack();
+	LevelPack(LevelPack const &) = delete;
+	LevelPack &operator=(LevelPack const &) = delete;
+
+	ByteString GetPath() const
+	{
+		return path;
+	}
+	int Count() const
+	{
+		return int(entries.size());
+	}
+	ByteString Name(int index) const;
+	// -1 if there's no level called name
+	int Find(ByteString name) const;
+	std::vector<char> Save(int index) const;
+	std::vector<char> Thumbnail(int index) const;
+	ByteString Metadata(int index) const;
+
+	static bool Write(ByteString path, std::vector<Level> const &levels);
+};
+
+#endif
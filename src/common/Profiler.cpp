@@ -0,0 +1,153 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static char const *phaseNames[Profiler::PhaseCount] = {
+	"BeforeSim",
+	"update_air",
+	"update_airh",
+	"Gravity handoff",
+	"RecalcFreeParticles",
+	"CheckStacking",
+	"SimulateGoL",
+	"UpdateParticles",
+	"AfterSim",
+	"render_parts",
+	"render_fire",
+	"draw_air",
+	"Engine draw",
+};
+
+char const *Profiler::PhaseName(Phase phase)
+{
+	return phaseNames[phase];
+}
+
+// Small numbers for the threads that record phases, for the trace
+static int ThreadNumber()
+{
+	static std::atomic<int> threads(0);
+	static thread_local int number = threads++;
+	return number;
+}
+
+Profiler::Profiler():
+	active(false),
+	enabled(false),
+	historyEnd(0),
+	frames(0),
+	traceSkip(0),
+	traceFrames(0)
+{
+	frameTime.fill(0);
+	for (auto &phase : history)
+		phase.fill(0);
+}
+
+void Profiler::UpdateActive()
+{
+	active = enabled || (traceFrames && !traceSkip);
+}
+
+void Profiler::SetEnabled(bool newEnabled)
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (newEnabled && !enabled)
+		frames = 0;
+	enabled = newEnabled;
+	UpdateActive();
+}
+
+void Profiler::Record(Phase phase, Clock::time_point start, Clock::time_point end)
+{
+	int thread = ThreadNumber();
+	std::lock_guard<std::mutex> g(mutex);
+	frameTime[phase] += std::chrono::duration<double, std::milli>(end - start).count();
+	if (traceFrames && !traceSkip)
+		events.push_back(Event{ phase, thread, start, end });
+}
+
+void Profiler::EndFrame()
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (enabled)
+	{
+		for (int phase = 0; phase < PhaseCount; phase++)
+			history[phase][historyEnd] = float(frameTime[phase]);
+		historyEnd = (historyEnd + 1) % HistorySize;
+		if (frames < HistorySize)
+			frames++;
+	}
+	frameTime.fill(0);
+
+	if (traceSkip)
+	{
+		if (!--traceSkip)
+			traceStart = Clock::now();
+	}
+	else if (traceFrames && !--traceFrames)
+	{
+		if (!WriteTrace())
+			std::cerr << "Can't write trace to " << traceFile << std::endl;
+		events.clear();
+	}
+	UpdateActive();
+}
+
+bool Profiler::StartTrace(ByteString filename, int frames, int skip)
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (traceFrames || frames <= 0)
+		return false;
+	traceFile = filename;
+	traceFrames = frames;
+	traceSkip = std::max(skip, 0);
+	traceStart = Clock::now();
+	events.clear();
+	UpdateActive();
+	return true;
+}
+
+bool Profiler::Tracing()
+{
+	std::lock_guard<std::mutex> g(mutex);
+	return traceFrames > 0;
+}
+
+bool Profiler::WriteTrace()
+{
+	std::ofstream file(traceFile.c_str());
+	if (!file.is_open())
+		return false;
+	auto micros = [this](Clock::time_point time) {
+		return std::chrono::duration<double, std::micro>(time - traceStart).count();
+	};
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		auto &event = events[i];
+		file << (i ? ",\n" : "\n");
+		file << "{\"name\":\"" << phaseNames[event.phase] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread;
+		file << ",\"ts\":" << micros(event.start) << ",\"dur\":" << micros(event.end) - micros(event.start) << "}";
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return bool(file);
+}
+
+float Profiler::History(Phase phase, int framesAgo)
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (framesAgo < 0 || framesAgo >= frames)
+		return 0;
+	return history[phase][(historyEnd - 1 - framesAgo + HistorySize) % HistorySize];
+}
+
+int Profiler::HistoryFrames()
+{
+	std::lock_guard<std::mutex> g(mutex);
+	return frames;
+}
@@ -0,0 +1,128 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include "Config.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "common/String.h"
+#include "Singleton.h"
+
+/*
+ * Times the phases of a frame. Phases are marked with ProfileScope, which
+ * costs one flag check while nothing is being recorded. Recording is on while
+ * the profiler overlay is shown (SetEnabled) and while a trace is taken.
+ *
+ * Each phase's total time in a frame is kept for the last HistorySize frames.
+ * Times include the phases nested in them, such as render_parts in the ui
+ * draw. Phases may be recorded from any thread; the air update for one does
+ * run on its own thread when it is pipelined.
+ *
+ * A trace records every phase as a separate event for a range of frames and
+ * writes them out as Chrome trace JSON (chrome://tracing, Perfetto) when the
+ * last frame ends.
+ */
+class Profiler : public Singleton<Profiler>
+{
+public:
+	enum Phase
+	{
+		BeforeSim,
+		UpdateAir,
+		UpdateAirHeat,
+		GravityHandoff,
+		RecalcFreeParticles,
+		CheckStacking,
+		SimulateGoL,
+		UpdateParticles,
+		AfterSim,
+		RenderParts,
+		RenderFire,
+		DrawAir,
+		EngineDraw,
+		PhaseCount
+	};
+	static char const *PhaseName(Phase phase);
+
+	static constexpr int HistorySize = 120;
+
+	typedef std::chrono::steady_clock Clock;
+
+private:
+	struct Event
+	{
+		Phase phase;
+		int thread;
+		Clock::time_point start, end;
+	};
+
+	std::atomic<bool> active;
+	bool enabled;
+
+	std::mutex mutex;
+	std::array<double, PhaseCount> frameTime;
+	std::array<std::array<float, HistorySize>, PhaseCount> history;
+	int historyEnd;
+	int frames;
+
+	ByteString traceFile;
+	int traceSkip, traceFrames;
+	std::vector<Event> events;
+	Clock::time_point traceStart;
+
+	void UpdateActive();
+	bool WriteTrace();
+
+public:
+	Profiler();
+
+	bool Active() const
+	{
+		return active;
+	}
+	void SetEnabled(bool newEnabled);
+
+	void Record(Phase phase, Clock::time_point start, Clock::time_point end);
+	// Moves the times recorded since the last call into the history
+	void EndFrame();
+
+	// Traces frames frames, starting after skip more frames have ended.
+	// Returns false if a trace is already being taken.
+	bool StartTrace(ByteString filename, int frames, int skip);
+	bool Tracing();
+
+	// Time spent in phase, in milliseconds, framesAgo frames before the last
+	// that ended. Frames from before recording started count as 0.
+	float History(Phase phase, int framesAgo);
+	// Number of frames in the history, up to HistorySize
+	int HistoryFrames();
+};
+
+// Records the time from its construction to its destruction as phase
+class ProfileScope
+{
+	Profiler::Phase phase;
+	bool active;
+	Profiler::Clock::time_point start;
+
+public:
+	ProfileScope(Profiler::Phase phase):
+		phase(phase),
+		active(Profiler::Ref().Active())
+	{
+		if (active)
+			start = Profiler::Clock::now();
+	}
+	~ProfileScope()
+	{
+		if (active)
+			Profiler::Ref().Record(phase, start, Profiler::Clock::now());
+	}
+	ProfileScope(ProfileScope const &) = delete;
+	ProfileScope &operator=(ProfileScope const &) = delete;
+};
+
+#endif
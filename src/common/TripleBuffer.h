@@ -0,0 +1,58 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Index bookkeeping for handing buffers from one thread to another without
+// locks. There are three buffers: the writer fills Back(), the reader uses
+// Front(), and the third sits in between holding the newest published one.
+// Publish and Take swap with the middle buffer atomically, so neither side
+// ever waits for the other, and the reader always gets the newest buffer.
+// Buffers published and then replaced before being taken are skipped.
+class TripleBuffer
+{
+	static const int fresh = 4;
+	std::atomic<int> middle;
+	int back, front;
+
+public:
+	TripleBuffer() :
+		middle(1),
+		back(0),
+		front(2)
+	{
+	}
+
+	// Only to be called while neither side is using the buffers
+	void Reset()
+	{
+		middle = 1;
+		back = 0;
+		front = 2;
+	}
+
+	// Writer side
+	int Back() const { return back; }
+	// Hands Back() to the reader and gets a new Back(). Returns true if that
+	// one was published earlier but never taken.
+	bool Publish()
+	{
+		int old = middle.exchange(back | fresh);
+		back = old & ~fresh;
+		return (old & fresh) != 0;
+	}
+
+	// Reader side
+	int Front() const { return front; }
+	bool Fresh() const { return (middle.load() & fresh) != 0; }
+	// Makes the newest published buffer Front(), returns false if nothing was published since the last Take
+	bool Take()
+	{
+		if (!Fresh())
+			return false;
+		front = middle.exchange(front) & ~fresh;
+		return true;
+	}
+};
+
+#endif
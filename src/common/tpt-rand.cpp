@@ -62,4 +62,55 @@ void RNG::seed(unsigned int sd)
 	s[1] = sd;
 }
 
+/* Philox4x32-10 by John Salmon, Mark Moraes, Ron Dror and David Shaw */
+
+static void philox(uint32_t ctr[4], uint32_t key[2])
+{
+	for (int round = 0; round < 10; round++)
+	{
+		uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+		uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+		uint32_t out[4] = {
+			uint32_t(p1 >> 32) ^ ctr[1] ^ key[0],
+			uint32_t(p1),
+			uint32_t(p0 >> 32) ^ ctr[3] ^ key[1],
+			uint32_t(p0)
+		};
+		ctr[0] = out[0];
+		ctr[1] = out[1];
+		ctr[2] = out[2];
+		ctr[3] = out[3];
+		key[0] += 0x9E3779B9;
+		key[1] += 0xBB67AE85;
+	}
+}
+
+void RNG::seed(uint64_t key, uint64_t counter, uint32_t stream)
+{
+	uint32_t ctr[4] = { uint32_t(counter), uint32_t(counter >> 32), stream, 0 };
+	uint32_t k[2] = { uint32_t(key), uint32_t(key >> 32) };
+	philox(ctr, k);
+	s[0] = uint64_t(ctr[0]) | uint64_t(ctr[1]) << 32;
+	s[1] = uint64_t(ctr[2]) | uint64_t(ctr[3]) << 32;
+	// xoroshiro never leaves the all zero state
+	if (!s[0] && !s[1])
+		s[1] = 614;
+}
+
+static thread_local RNG *threadRNG = nullptr;
+
+RNG &RNG::Ref()
+{
+	if (threadRNG)
+		return *threadRNG;
+	return Singleton<RNG>::Ref();
+}
+
+RNG *RNG::SetThreadLocal(RNG *rng)
+{
+	RNG *previous = threadRNG;
+	threadRNG = rng;
+	return previous;
+}
+
 RNG random_gen;
@@ -19,6 +19,33 @@ public:
 
 	RNG();
 	void seed(unsigned int sd);
+	// Seeds the generator with the output of a counter based generator (Philox)
+	// for key and counter, so that any number of independent streams can be
+	// started from one key without drawing from another generator
+	void seed(uint64_t key, uint64_t counter, uint32_t stream);
+
+	// Returns the generator installed for the calling thread with SetThreadLocal,
+	// or the shared one if there isn't any
+	static RNG &Ref();
+	// Returns the generator installed before
+	static RNG *SetThreadLocal(RNG *rng);
+};
+
+// Installs a generator for the calling thread until it goes out of scope
+class RNGScope
+{
+	RNG *previous;
+public:
+	RNGScope(RNG &rng):
+		previous(RNG::SetThreadLocal(&rng))
+	{
+	}
+	~RNGScope()
+	{
+		RNG::SetThreadLocal(previous);
+	}
+	RNGScope(RNGScope const &) = delete;
+	RNGScope &operator=(RNGScope const &) = delete;
 };
 
 extern RNG random_gen;
@@ -0,0 +1,70 @@
+#include "DebugProfiler.h"
+
+#include <algorithm>
+
+#include "gui/interface/Engine.h"
+
+#include "common/Profiler.h"
+
+#include "graphics/Graphics.h"
+
+DebugProfiler::DebugProfiler(unsigned int id):
+	DebugInfo(id)
+{
+
+}
+
+// One row per phase: its average and worst time over the history, and a bar
+// per frame, scaled to the worst one. The newest frame is on the right.
+void DebugProfiler::Draw()
+{
+	Graphics * g = ui::Engine::Ref().g;
+	Profiler &profiler = Profiler::Ref();
+
+	int frames = profiler.HistoryFrames();
+	int textWidth = 0;
+	for (int phase = 0; phase < Profiler::PhaseCount; phase++)
+		textWidth = std::max(textWidth, Graphics::textwidth(ByteString(Profiler::PhaseName(Profiler::Phase(phase))).FromUtf8()));
+	int numberWidth = Graphics::textwidth("000.00 / 000.00 ms");
+	int rowHeight = 12;
+	int width = textWidth + numberWidth + Profiler::HistorySize + 20;
+	int xStart = XRES - width - 10, yStart = 10;
+
+	g->fillrect(xStart - 5, yStart - 5, width + 10, Profiler::PhaseCount * rowHeight + 22, 0, 0, 0, 180);
+	g->drawtext(xStart, yStart, String::Build("Average / worst of the last ", frames, " frames"), 255, 255, 255, 255);
+	for (int phase = 0; phase < Profiler::PhaseCount; phase++)
+	{
+		Profiler::Phase p = Profiler::Phase(phase);
+		int y = yStart + (phase + 1) * rowHeight + 2;
+		float total = 0, worst = 0;
+		for (int i = 0; i < frames; i++)
+		{
+			float time = profiler.History(p, i);
+			total += time;
+			worst = std::max(worst, time);
+		}
+		float average = frames ? total / frames : 0;
+
+		g->drawtext(xStart, y, ByteString(Profiler::PhaseName(p)).FromUtf8(), 255, 255, 255, 255);
+		String times = String::Build(Format::Precision(average, 2), " / ", Format::Precision(worst, 2), " ms");
+		g->drawtext(xStart + textWidth + 5 + numberWidth - Graphics::textwidth(times), y, times, 255, 255, 255, 255);
+
+		int xBars = xStart + textWidth + numberWidth + 15;
+		int yBottom = y + rowHeight - 4;
+		g->fillrect(xBars, y - 1, Profiler::HistorySize, rowHeight - 2, 40, 40, 40, 255);
+		if (worst <= 0)
+			continue;
+		for (int i = 0; i < frames; i++)
+		{
+			int barSize = int(profiler.History(p, i) / worst * (rowHeight - 3) + 0.5f);
+			int x = xBars + Profiler::HistorySize - 1 - i;
+			if (barSize)
+				g->draw_line(x, yBottom - barSize + 1, x, yBottom, 255, 200, 0, 255);
+		}
+	}
+}
+
+DebugProfiler::~DebugProfiler()
+{
+
+}
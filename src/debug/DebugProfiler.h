@@ -0,0 +1,11 @@
+#pragma once
+
+#include "DebugInfo.h"
+
+class DebugProfiler : public DebugInfo
+{
+public:
+	DebugProfiler(unsigned int id);
+	void Draw() override;
+	virtual ~DebugProfiler();
+};
@@ -0,0 +1,62 @@
+#include "DebugRewind.h"
+
+#include <algorithm>
+
+#include "gui/interface/Engine.h"
+
+#include "simulation/RewindBuffer.h"
+#include "simulation/Simulation.h"
+
+#include "graphics/Graphics.h"
+
+DebugRewind::DebugRewind(unsigned int id, Simulation * sim):
+	DebugInfo(id),
+	sim(sim)
+{
+
+}
+
+// What the rewind captures cost, and a mark per capture with the keyframes
+// taller and the one rewound to, if any, in yellow
+void DebugRewind::Draw()
+{
+	Graphics * g = ui::Engine::Ref().g;
+	RewindBuffer &rewind = *sim->rewind;
+	RewindBuffer::Stats stats = rewind.GetStats();
+
+	String lines[3];
+	if (rewind.enabled)
+		lines[0] = String::Build("Rewind: ", stats.captures, " captures, ", stats.keyframes, " keyframes, every ", rewind.interval, " frames, ticks ", stats.oldestTick, " to ", stats.newestTick);
+	else
+		lines[0] = "Rewind is off, see sim.rewindSettings";
+	lines[1] = String::Build("Memory: ", Format::Precision((stats.bytes + stats.workingBytes) / 1048576.0f, 1), " of ", Format::Precision(rewind.budget / 1048576.0f, 1), " MB, ",
+		Format::Precision(stats.bytes / 1048576.0f, 1), " MB of captures (", Format::Precision(stats.rawBytes / 1048576.0f, 1), " MB uncompressed) and ",
+		Format::Precision(stats.workingBytes / 1048576.0f, 1), " MB of buffers");
+	lines[2] = String::Build("Last capture: ", Format::Precision(stats.copyTime, 2), " ms copying in the frame, ", Format::Precision(stats.compressTime, 2),
+		" ms compressing, ", stats.skipped, " skipped while busy");
+
+	int width = 0;
+	for (auto &line : lines)
+		width = std::max(width, g->textwidth(line));
+	int xStart = 10, yStart = 10;
+	g->fillrect(xStart - 3, yStart - 3, width + 6, 3 * 12 + 16, 0, 0, 0, 180);
+	for (int i = 0; i < 3; i++)
+		g->drawtext(xStart, yStart + i * 12, lines[i], 255, 255, 255, 255);
+
+	int position = rewind.Position();
+	int yBottom = yStart + 3 * 12 + 9;
+	for (int back = 0; back < stats.captures && back * 3 < width; back++)
+	{
+		int x = xStart + width - 1 - back * 3;
+		int height = rewind.Keyframe(back) ? 7 : 4;
+		if (back == position)
+			g->draw_line(x, yBottom - height, x, yBottom, 255, 255, 0, 255);
+		else
+			g->draw_line(x, yBottom - height, x, yBottom, 120, 160, 255, 255);
+	}
+}
+
+DebugRewind::~DebugRewind()
+{
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "DebugInfo.h"
+
+class Simulation;
+class DebugRewind : public DebugInfo
+{
+	Simulation * sim;
+public:
+	DebugRewind(unsigned int id, Simulation * sim);
+	void Draw() override;
+	virtual ~DebugRewind();
+};
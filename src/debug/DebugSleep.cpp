@@ -0,0 +1,41 @@
+#include "DebugSleep.h"
+
+#include "gui/interface/Engine.h"
+
+#include "simulation/Simulation.h"
+
+#include "graphics/Graphics.h"
+
+DebugSleep::DebugSleep(unsigned int id, Simulation * sim):
+	DebugInfo(id),
+	sim(sim)
+{
+
+}
+
+void DebugSleep::Draw()
+{
+	Graphics * g = ui::Engine::Ref().g;
+
+	int asleep = 0;
+	for (int y = 0; y < YRES/CELL; y++)
+		for (int x = 0; x < XRES/CELL; x++)
+			if (sim->cellAsleep[y][x])
+			{
+				g->fillrect(x*CELL, y*CELL, CELL, CELL, 0, 80, 255, 70);
+				asleep++;
+			}
+
+	String info;
+	if (sim->sleepEnabled)
+		info = String::Build("Asleep: ", asleep, "/", (XRES/CELL)*(YRES/CELL), " cells (", Format::Precision((float)asleep/((XRES/CELL)*(YRES/CELL))*100.0f, 2), "%)");
+	else
+		info = "Sleeping is off, see sim.sleep";
+	g->fillrect(7, YRES-26, g->textwidth(info)+5, 14, 0, 0, 0, 180);
+	g->drawtext(10, YRES-22, info, 255, 255, 255, 255);
+}
+
+DebugSleep::~DebugSleep()
+{
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "DebugInfo.h"
+
+class Simulation;
+class DebugSleep : public DebugInfo
+{
+	Simulation * sim;
+public:
+	DebugSleep(unsigned int id, Simulation * sim);
+	void Draw() override;
+	virtual ~DebugSleep();
+};
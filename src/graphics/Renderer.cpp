@@ -9,6 +9,7 @@
 #include "Config.h"
 #include "Misc.h"
 
+#include "common/Profiler.h"
 #include "common/tpt-rand.h"
 #include "common/tpt-compat.h"
 
@@ -1071,6 +1072,7 @@ void Renderer::render_gravlensing(pixel * source)
 
 void Renderer::render_fire()
 {
+	ProfileScope profile(Profiler::RenderFire);
 #ifndef OGLR
 	if(!(render_mode & FIREMODE))
 		return;
@@ -1199,6 +1201,7 @@ void Renderer::prepare_alpha(int size, float intensity)
 #ifndef FONTEDITOR
 void Renderer::render_parts()
 {
+	ProfileScope profile(Profiler::RenderParts);
 	int deca, decr, decg, decb, cola, colr, colg, colb, firea, firer, fireg, fireb, pixel_mode, q, i, t, nx, ny, x, y, caddress;
 	int orbd[4] = {0, 0, 0, 0}, orbl[4] = {0, 0, 0, 0};
 	float gradv, flicker;
@@ -2368,6 +2371,7 @@ void Renderer::draw_grav()
 
 void Renderer::draw_air()
 {
+	ProfileScope profile(Profiler::DrawAir);
 	if(!sim->aheat_enable && (display_mode & DISPLAY_AIRH))
 		return;
 #ifndef OGLR
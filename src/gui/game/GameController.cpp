@@ -19,6 +19,8 @@
 #include "client/GameSave.h"
 #include "client/Client.h"
 
+#include "common/Profiler.h"
+
 #include "gui/search/SearchController.h"
 #include "gui/render/RenderController.h"
 #include "gui/login/LoginController.h"
@@ -55,9 +57,12 @@
 
 #include "debug/DebugInfo.h"
 #include "debug/DebugParts.h"
+#include "debug/DebugProfiler.h"
+#include "debug/DebugRewind.h"
 #include "debug/ElementPopulation.h"
 #include "debug/DebugLines.h"
 #include "debug/ParticleDebug.h"
+#include "debug/DebugSleep.h"
 
 #ifdef LUACONSOLE
 #include "lua/LuaScriptInterface.h"
@@ -71,6 +76,7 @@
 #include "simulation/Simulation.h"
 #include "simulation/SimulationData.h"
 #include "simulation/Air.h"
+#include "simulation/RewindBuffer.h"
 #include "simulation/Snapshot.h"
 #include "simulation/ElementClasses.h"
 
@@ -112,6 +118,9 @@ GameController::GameController() : firstTick(true),
 	debugInfo.push_back(new ElementPopulationDebug(0x2, gameModel->GetSimulation()));
 	debugInfo.push_back(new DebugLines(0x4, gameView, this));
 	debugInfo.push_back(new ParticleDebug(0x8, gameModel->GetSimulation(), gameModel));
+	debugInfo.push_back(new DebugSleep(0x10, gameModel->GetSimulation()));
+	debugInfo.push_back(new DebugProfiler(0x20));
+	debugInfo.push_back(new DebugRewind(0x40, gameModel->GetSimulation()));
 }
 
 GameController::~GameController()
@@ -248,6 +257,25 @@ void GameController::HistoryForward()
 	gameModel->SetHistoryPosition(newHistoryPosition);
 }
 
+void GameController::Rewind(int steps)
+{
+	RewindBuffer &rewind = *gameModel->GetSimulation()->rewind;
+	int position = rewind.Position();
+	// Leaving the live state, which may be newer than any capture, so keep it for undo
+	if (position < 0)
+	{
+		if (steps <= 0 || !rewind.Count())
+			return;
+		HistorySnapshot();
+		position = steps - 1;
+	}
+	else
+		position += steps;
+	position = std::max(0, std::min(position, rewind.Count() - 1));
+	rewind.Restore(position);
+	gameModel->SetPaused(true);
+}
+
 GameView *GameController::GetView()
 {
 	return gameView;
@@ -1064,6 +1092,13 @@ void GameController::SetColour(ui::Colour colour)
 	gameModel->SetPresetColour(colour);
 }
 
+void GameController::SetDebugFlags(unsigned int flags)
+{
+	debugFlags = flags;
+	// Phases are only timed while DebugProfiler is shown
+	Profiler::Ref().SetEnabled(flags & 0x20);
+}
+
 void GameController::SetActiveMenu(int menuID)
 {
 	gameModel->SetActiveMenu(menuID);
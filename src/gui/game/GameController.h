@@ -79,6 +79,8 @@ public:
 	void HistoryRestore();
 	void HistorySnapshot();
 	void HistoryForward();
+	// Puts the simulation back steps more rewind captures, or forward for negative steps
+	void Rewind(int steps);
 
 	void AdjustGridSize(int direction);
 	void InvertAirSim();
@@ -106,7 +108,7 @@ public:
 	bool GetHudEnable();
 	void SetDebugHUD(bool hudState);
 	bool GetDebugHUD();
-	void SetDebugFlags(unsigned int flags) { debugFlags = flags; }
+	void SetDebugFlags(unsigned int flags);
 	void SetActiveMenu(int menuID);
 	std::vector<Menu*> GetMenuList();
 	int GetNumMenus(bool onlyEnabled);
@@ -22,6 +22,7 @@
 #include "graphics/Renderer.h"
 
 #include "simulation/Air.h"
+#include "simulation/RewindBuffer.h"
 #include "simulation/Simulation.h"
 #include "simulation/Snapshot.h"
 #include "simulation/Gravity.h"
@@ -102,6 +103,9 @@ GameModel::GameModel():
 		sim->grav->start_grav_async();
 	sim->aheat_enable =  Client::Ref().GetPrefInteger("Simulation.AmbientHeat", 0);
 	sim->pretty_powder =  Client::Ref().GetPrefInteger("Simulation.PrettyPowder", 0);
+	sim->rewind->enabled = Client::Ref().GetPrefBool("Simulation.Rewind", false);
+	sim->rewind->interval = std::max(1, Client::Ref().GetPrefInteger("Simulation.RewindInterval", 10));
+	sim->rewind->budget = size_t(std::max(1, Client::Ref().GetPrefInteger("Simulation.RewindBudget", 128))) << 20;
 
 	Favorite::Ref().LoadFavoritesFromPrefs();
 
@@ -747,11 +751,17 @@ void GameModel::SetSave(SaveInfo * newSave, bool invertIncludePressure)
 		sim->legacy_enable = saveData->legacyEnable;
 		sim->water_equal_test = saveData->waterEEnabled;
 		sim->aheat_enable = saveData->aheatEnable;
+		sim->pipelineAir = saveData->pipelineAir;
 		if(saveData->gravityEnable)
 			sim->grav->start_grav_async();
 		else
 			sim->grav->stop_grav_async();
 		sim->clear_sim();
+		if (saveData->hasRngSeed)
+		{
+			sim->rngSeed = saveData->rngSeed;
+			sim->currentTick = saveData->currentTick;
+		}
 		ren->ClearAccumulation();
 		if (!sim->Load(saveData, !invertIncludePressure))
 		{
@@ -808,6 +818,7 @@ void GameModel::SetSaveFile(SaveFile * newSave, bool invertIncludePressure)
 		sim->legacy_enable = saveData->legacyEnable;
 		sim->water_equal_test = saveData->waterEEnabled;
 		sim->aheat_enable = saveData->aheatEnable;
+		sim->pipelineAir = saveData->pipelineAir;
 		if(saveData->gravityEnable && !sim->grav->IsEnabled())
 		{
 			sim->grav->start_grav_async();
@@ -817,6 +828,11 @@ void GameModel::SetSaveFile(SaveFile * newSave, bool invertIncludePressure)
 			sim->grav->stop_grav_async();
 		}
 		sim->clear_sim();
+		if (saveData->hasRngSeed)
+		{
+			sim->rngSeed = saveData->rngSeed;
+			sim->currentTick = saveData->currentTick;
+		}
 		ren->ClearAccumulation();
 		if (!sim->Load(saveData, !invertIncludePressure))
 		{
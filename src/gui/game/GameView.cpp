@@ -1475,6 +1475,12 @@ void GameView::OnKeyPress(int key, int scan, bool repeat, bool shift, bool ctrl,
 		else
 			c->InvertAirSim();
 		break;
+	case SDL_SCANCODE_COMMA:
+		c->Rewind(1);
+		break;
+	case SDL_SCANCODE_PERIOD:
+		c->Rewind(-1);
+		break;
 	case SDL_SCANCODE_SEMICOLON:
 		if (ctrl)
 			c->SetReplaceModeFlags(c->GetReplaceModeFlags()^SPECIFIC_DELETE);
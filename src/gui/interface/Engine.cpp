@@ -8,6 +8,7 @@
 #include "gui/dialogues/ConfirmPrompt.h"
 
 #include "graphics/Graphics.h"
+#include "common/Profiler.h"
 
 #include "Config.h"
 #include "Platform.h"
@@ -215,6 +216,7 @@ void Engine::Tick()
 
 void Engine::Draw()
 {
+	ProfileScope profile(Profiler::EngineDraw);
 	if(lastBuffer && !(state_ && state_->Position.X == 0 && state_->Position.Y == 0 && state_->Size.X == width_ && state_->Size.Y == height_))
 	{
 		g->Clear();
@@ -846,6 +846,7 @@ int luatpt_set_wallmap(lua_State* l)
 			for (ny = y1; ny<y1+height; ny++)
 			{
 				luacon_sim->bmap[ny][nx] = wallType;
+				luacon_sim->WakeCell(nx*CELL, ny*CELL);
 			}
 	}
 	else	//Set point
@@ -855,6 +856,7 @@ int luatpt_set_wallmap(lua_State* l)
 		if(y1 > (YRES/CELL))
 			y1 = (YRES/CELL);
 		luacon_sim->bmap[y1][x1] = wallType;
+		luacon_sim->WakeCell(x1*CELL, y1*CELL);
 	}
 	return 0;
 }
@@ -898,6 +900,7 @@ int luatpt_set_elecmap(lua_State* l)
 			for (ny = y1; ny<y1+height; ny++)
 			{
 				luacon_sim->emap[ny][nx] = value;
+				luacon_sim->WakeCell(nx*CELL, ny*CELL);
 			}
 	}
 	else	//Set point
@@ -907,6 +910,7 @@ int luatpt_set_elecmap(lua_State* l)
 		if(y1 > (YRES/CELL))
 			y1 = (YRES/CELL);
 		luacon_sim->emap[y1][x1] = value;
+		luacon_sim->WakeCell(x1*CELL, y1*CELL);
 	}
 	return 0;
 }
@@ -112,6 +112,13 @@ public:
 	int PushToStack(lua_State *l) override { return 0; }
 };
 
+// Particles were moved by Simulation::CompactParticles, see simulation.compactedID
+class CompactEvent: public Event
+{
+public:
+	int PushToStack(lua_State *l) override { return 0; }
+};
+
 class LuaEvents
 {
 public:
@@ -125,7 +132,8 @@ public:
 		mousewheel,
 		tick,
 		blur,
-		close
+		close,
+		compact
 	};
 
 	static int RegisterEventHook(lua_State *l, ByteString eventName);
@@ -36,16 +36,22 @@
 #include "simulation/ElementGraphics.h"
 #include "simulation/ElementCommon.h"
 #include "simulation/Air.h"
+#include "simulation/Gravity.h"
+#include "simulation/RewindBuffer.h"
+#include "simulation/SaveRenderer.h"
 
 #include "simulation/ToolClasses.h"
 #include "simulation/ElementClasses.h"
 
 #include "client/GameSave.h"
+#include "client/LevelPack.h"
 #include "client/SaveFile.h"
 #include "client/SaveInfo.h"
 #include "client/Client.h"
 #include "client/http/Request.h"
 
+#include "common/Profiler.h"
+
 #include "graphics/Graphics.h"
 #include "graphics/Renderer.h"
 
@@ -114,6 +120,7 @@ LuaScriptInterface::LuaScriptInterface(GameController * c, GameModel * m):
 	luacon_selectedreplace(""),
 	luacon_mousedown(false),
 	currentCommand(false),
+	compactionsSeen(0),
 	legacy(new TPTScriptInterface(c, m))
 {
 	luacon_model = m;
@@ -805,13 +812,30 @@ void LuaScriptInterface::initSimulationAPI()
 		{"can_move", simulation_canMove},
 		{"brush", simulation_brush},
 		{"parts", simulation_parts},
+		{"elementParts", simulation_elementParts},
 		{"pmap", simulation_pmap},
 		{"photons", simulation_photons},
 		{"neighbours", simulation_neighbours},
 		{"neighbors", simulation_neighbours},
 		{"framerender", simulation_framerender},
 		{"gspeed", simulation_gspeed},
+		{"golGenerations", simulation_golGenerations},
 		{"takeSnapshot", simulation_takeSnapshot},
+		{"tiledUpdate", simulation_tiledUpdate},
+		{"sleep", simulation_sleep},
+		{"pipelineAir", simulation_pipelineAir},
+		{"gravityDeltaLimit", simulation_gravityDeltaLimit},
+		{"compactParticles", simulation_compactParticles},
+		{"compactedID", simulation_compactedID},
+		{"randomSeed", simulation_randomSeed},
+		{"profileTrace", simulation_profileTrace},
+		{"rewind", simulation_rewind},
+		{"rewindCount", simulation_rewindCount},
+		{"rewindSettings", simulation_rewindSettings},
+		{"levelPack", simulation_levelPack},
+		{"writeLevelPack", simulation_writeLevelPack},
+		{"loadLevel", simulation_loadLevel},
+		{"levelInfo", simulation_levelInfo},
 		{NULL, NULL}
 	};
 	luaL_register(l, "simulation", simulationAPIMethods);
@@ -2064,6 +2088,41 @@ int LuaScriptInterface::simulation_parts(lua_State *l)
 	return 1;
 }
 
+// Upvalues: element type, snapshot of the IDs of that type, number of IDs, next position
+int ElementPartsClosure(lua_State *l)
+{
+	int t = lua_tointeger(l, lua_upvalueindex(1));
+	int const *ids = (int const *)lua_touserdata(l, lua_upvalueindex(2));
+	int count = lua_tointeger(l, lua_upvalueindex(3));
+	for (int k = lua_tointeger(l, lua_upvalueindex(4)); k < count; ++k)
+	{
+		// Skip particles killed or retyped since the loop started
+		if (luacon_sim->parts[ids[k]].type == t)
+		{
+			lua_pushinteger(l, k + 1);
+			lua_replace(l, lua_upvalueindex(4));
+			lua_pushinteger(l, ids[k]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int LuaScriptInterface::simulation_elementParts(lua_State *l)
+{
+	int t = luaL_checkint(l, 1);
+	if (!luacon_sim->IsValidElement(t))
+		return luaL_error(l, "Invalid element ID (%d)", t);
+	auto &ids = luacon_sim->ElementParts(t);
+	lua_pushinteger(l, t);
+	int *copy = (int *)lua_newuserdata(l, std::max(ids.size(), size_t(1)) * sizeof(int));
+	std::copy(ids.begin(), ids.end(), copy);
+	lua_pushinteger(l, int(ids.size()));
+	lua_pushinteger(l, 0);
+	lua_pushcclosure(l, ElementPartsClosure, 4);
+	return 1;
+}
+
 int LuaScriptInterface::simulation_pmap(lua_State * l)
 {
 	int x = luaL_checkint(l, 1);
@@ -2171,12 +2230,289 @@ int LuaScriptInterface::simulation_gspeed(lua_State * l)
 	return 0;
 }
 
+int LuaScriptInterface::simulation_golGenerations(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->golGenerations);
+		return 1;
+	}
+	int generations = luaL_checkinteger(l, 1);
+	if (generations < 1 || generations > Simulation::MaxGolGenerations)
+		return luaL_error(l, "Generations must be between 1 and %d", Simulation::MaxGolGenerations);
+	luacon_sim->golGenerations = generations;
+	return 0;
+}
+
 int LuaScriptInterface::simulation_takeSnapshot(lua_State * l)
 {
 	luacon_controller->HistorySnapshot();
 	return 0;
 }
 
+int LuaScriptInterface::simulation_tiledUpdate(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->tiledUpdate);
+		lua_pushinteger(l, luacon_sim->updateThreads);
+		lua_pushboolean(l, luacon_sim->tiledUpdateCheck);
+		lua_pushinteger(l, luacon_sim->tiledUpdateOverreach);
+		return 4;
+	}
+	luacon_sim->tiledUpdate = lua_toboolean(l, 1);
+	if (lua_gettop(l) > 1 && !lua_isnil(l, 2))
+	{
+		int threads = luaL_checkinteger(l, 2);
+		if (threads < 1)
+			return luaL_error(l, "Need at least one update thread");
+		luacon_sim->updateThreads = threads;
+	}
+	if (lua_gettop(l) > 2)
+	{
+		luacon_sim->tiledUpdateCheck = lua_toboolean(l, 3);
+		luacon_sim->tiledUpdateOverreach = 0;
+	}
+	return 0;
+}
+
+int LuaScriptInterface::simulation_sleep(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->sleepEnabled);
+		return 1;
+	}
+	luacon_sim->sleepEnabled = lua_toboolean(l, 1);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_pipelineAir(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->pipelineAir);
+		return 1;
+	}
+	luacon_sim->pipelineAir = lua_toboolean(l, 1);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_gravityDeltaLimit(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->grav->deltaLimit);
+		return 1;
+	}
+	luacon_sim->grav->deltaLimit = std::max(luaL_checkint(l, 1), 0);
+	return 0;
+}
+
+int LuaScriptInterface::simulation_compactParticles(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, luacon_sim->compactParticles);
+		return 1;
+	}
+	luacon_sim->compactParticles = lua_toboolean(l, 1);
+	return 0;
+}
+
+// The ID a particle got from the last compaction, or nil if there was no particle there
+int LuaScriptInterface::simulation_compactedID(lua_State * l)
+{
+	int id = luaL_checkint(l, 1);
+	std::vector<int> const &compactMap = luacon_sim->compactMap;
+	if (id < 0 || id >= int(compactMap.size()) || compactMap[id] < 0)
+		return 0;
+	lua_pushinteger(l, compactMap[id]);
+	return 1;
+}
+
+// The seed doesn't fit in a Lua number, so it goes as its low and high 32 bits
+int LuaScriptInterface::simulation_randomSeed(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushnumber(l, uint32_t(luacon_sim->rngSeed));
+		lua_pushnumber(l, uint32_t(luacon_sim->rngSeed >> 32));
+		return 2;
+	}
+	uint64_t low = uint32_t(luaL_checknumber(l, 1));
+	uint64_t high = uint32_t(luaL_optnumber(l, 2, 0));
+	luacon_sim->rngSeed = high << 32 | low;
+	return 0;
+}
+
+// Writes a Chrome trace of the frame phases of the frames frames after the next skip
+int LuaScriptInterface::simulation_profileTrace(lua_State * l)
+{
+	ByteString filename = luaL_checkstring(l, 1);
+	int frames = luaL_checkint(l, 2);
+	int skip = luaL_optint(l, 3, 0);
+	lua_pushboolean(l, Profiler::Ref().StartTrace(filename, frames, skip));
+	return 1;
+}
+
+// Puts the simulation back to the capture back captures before the newest one, returning its tick
+int LuaScriptInterface::simulation_rewind(lua_State * l)
+{
+	int back = luaL_optint(l, 1, 0);
+	RewindBuffer &rewind = *luacon_sim->rewind;
+	if (!rewind.Restore(back))
+		return 0;
+	lua_pushinteger(l, luacon_sim->currentTick);
+	return 1;
+}
+
+int LuaScriptInterface::simulation_rewindCount(lua_State * l)
+{
+	lua_pushinteger(l, luacon_sim->rewind->Count());
+	return 1;
+}
+
+// Whether captures are taken, the frames between them and the memory they may take in megabytes
+int LuaScriptInterface::simulation_rewindSettings(lua_State * l)
+{
+	RewindBuffer &rewind = *luacon_sim->rewind;
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushboolean(l, rewind.enabled);
+		lua_pushinteger(l, rewind.interval);
+		lua_pushnumber(l, rewind.budget / 1048576.0);
+		return 3;
+	}
+	rewind.enabled = lua_toboolean(l, 1);
+	rewind.interval = std::max(1, luaL_optint(l, 2, rewind.interval));
+	rewind.budget = size_t(std::max(1.0, luaL_optnumber(l, 3, rewind.budget / 1048576.0)) * 1048576.0);
+	if (!rewind.enabled)
+		rewind.Clear();
+	return 0;
+}
+
+// The path of the level pack levels are taken from, if any. With a path, takes
+// levels from that pack instead and returns how many it has, or nil and why it
+// couldn't be opened; false goes back to the loose level files.
+int LuaScriptInterface::simulation_levelPack(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		std::shared_ptr<LevelPack> pack = luacon_sim->GetLevelPack();
+		if (!pack)
+			return 0;
+		lua_pushstring(l, pack->GetPath().c_str());
+		return 1;
+	}
+	if (!lua_toboolean(l, 1))
+	{
+		luacon_sim->SetLevelPack(nullptr);
+		return 0;
+	}
+	try
+	{
+		std::shared_ptr<LevelPack> pack(new LevelPack(luaL_checkstring(l, 1)));
+		luacon_sim->SetLevelPack(pack);
+		lua_pushinteger(l, pack->Count());
+		return 1;
+	}
+	catch (ParseException &e)
+	{
+		lua_pushnil(l);
+		lua_pushstring(l, e.what());
+		return 2;
+	}
+}
+
+// Makes a level pack at path out of a table of save files, in order. Each
+// level is named after its file, without the directory or extension. Returns
+// whether the pack could be written, or nil and why a save couldn't be loaded.
+int LuaScriptInterface::simulation_writeLevelPack(lua_State * l)
+{
+	ByteString path = luaL_checkstring(l, 1);
+	luaL_checktype(l, 2, LUA_TTABLE);
+	std::vector<LevelPack::Level> levels;
+	for (int i = 1, count = lua_objlen(l, 2); i <= count; i++)
+	{
+		lua_rawgeti(l, 2, i);
+		ByteString file = luaL_checkstring(l, -1);
+		lua_pop(l, 1);
+
+		LevelPack::Level level;
+		std::vector<unsigned char> fileData = Client::Ref().ReadFile(file);
+		level.save.assign(fileData.begin(), fileData.end());
+		std::unique_ptr<GameSave> save;
+		try
+		{
+			save.reset(new GameSave(level.save));
+		}
+		catch (ParseException &e)
+		{
+			lua_pushnil(l);
+			lua_pushstring(l, ByteString::Build("Can't load ", file, ": ", e.what()).c_str());
+			return 2;
+		}
+
+		level.name = file;
+		if (ByteString::Split split = level.name.SplitFromEndByAny("/\\"))
+			level.name = split.After();
+		if (ByteString::Split split = level.name.SplitFromEndBy('.'))
+			level.name = split.Before();
+
+		std::unique_ptr<VideoBuffer> thumbnail(SaveRenderer::Ref().Render(save.get(), true, true));
+		if (thumbnail)
+		{
+			thumbnail->Resize(thumbnail->Width / 4, thumbnail->Height / 4, true);
+			level.thumbnail = format::VideoBufferToPTI(*thumbnail);
+		}
+
+		Json::Value metadata;
+		metadata["title"] = level.name;
+		metadata["authors"] = save->authors;
+		metadata["particles"] = save->particlesCount;
+		level.metadata = Json::FastWriter().write(metadata);
+		levels.push_back(level);
+	}
+	lua_pushboolean(l, LevelPack::Write(path, levels));
+	return 1;
+}
+
+// Levels go by their index, counting from 0, or their name
+static int checkLevel(lua_State * l, int arg)
+{
+	int index = lua_type(l, arg) == LUA_TNUMBER ? lua_tointeger(l, arg) : luacon_sim->FindLevel(luaL_checkstring(l, arg));
+	if (index < 0 || index >= luacon_sim->LevelCount())
+		return luaL_error(l, "No such level");
+	return index;
+}
+
+// Loads the level at the end of the frame, like LOAD does with the next one
+int LuaScriptInterface::simulation_loadLevel(lua_State * l)
+{
+	luacon_sim->LoadLevel(checkLevel(l, 1));
+	return 0;
+}
+
+// With no level, the number of levels and the index of the one LOAD loads next;
+// with one, its name and metadata, which is a JSON string for levels from a pack
+int LuaScriptInterface::simulation_levelInfo(lua_State * l)
+{
+	if (lua_gettop(l) == 0)
+	{
+		lua_pushinteger(l, luacon_sim->LevelCount());
+		lua_pushinteger(l, luacon_sim->saveIndex);
+		return 2;
+	}
+	int index = checkLevel(l, 1);
+	lua_pushstring(l, luacon_sim->LevelName(index).c_str());
+	std::shared_ptr<LevelPack> pack = luacon_sim->GetLevelPack();
+	if (!pack)
+		return 1;
+	lua_pushstring(l, pack->Metadata(index).c_str());
+	return 2;
+}
+
 //// Begin Renderer API
 
 void LuaScriptInterface::initRendererAPI()
@@ -3712,6 +4048,7 @@ void LuaScriptInterface::initEventAPI()
 	lua_pushinteger(l, LuaEvents::tick); lua_setfield(l, -2, "tick");
 	lua_pushinteger(l, LuaEvents::blur); lua_setfield(l, -2, "blur");
 	lua_pushinteger(l, LuaEvents::close); lua_setfield(l, -2, "close");
+	lua_pushinteger(l, LuaEvents::compact); lua_setfield(l, -2, "compact");
 }
 
 int LuaScriptInterface::event_register(lua_State * l)
@@ -3956,6 +4293,12 @@ void LuaScriptInterface::OnTick()
 		lua_setfield(l, -2, "NUM_PARTS");
 	}
 	lua_pop(l, 1);
+	if (luacon_sim->compactions != compactionsSeen)
+	{
+		compactionsSeen = luacon_sim->compactions;
+		CompactEvent cev;
+		HandleEvent(LuaEvents::compact, &cev);
+	}
 	TickEvent ev;
 	HandleEvent(LuaEvents::tick, &ev);
 }
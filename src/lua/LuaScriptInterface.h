@@ -48,6 +48,8 @@ class LuaScriptInterface: public CommandInterface
 	ByteString luacon_selectedl, luacon_selectedr, luacon_selectedalt, luacon_selectedreplace;
 	bool luacon_mousedown;
 	bool currentCommand;
+	// Simulation::compactions as of the last compact event
+	unsigned int compactionsSeen;
 	TPTScriptInterface * legacy;
 
 	// signs
@@ -109,13 +111,30 @@ class LuaScriptInterface: public CommandInterface
 	static int simulation_elementCount(lua_State * l);
 	static int simulation_canMove(lua_State * l);
 	static int simulation_parts(lua_State * l);
+	static int simulation_elementParts(lua_State * l);
 	static int simulation_brush(lua_State * l);
 	static int simulation_pmap(lua_State * l);
 	static int simulation_photons(lua_State * l);
 	static int simulation_neighbours(lua_State * l);
 	static int simulation_framerender(lua_State * l);
 	static int simulation_gspeed(lua_State * l);
+	static int simulation_golGenerations(lua_State * l);
 	static int simulation_takeSnapshot(lua_State *l);
+	static int simulation_tiledUpdate(lua_State *l);
+	static int simulation_sleep(lua_State *l);
+	static int simulation_pipelineAir(lua_State *l);
+	static int simulation_gravityDeltaLimit(lua_State *l);
+	static int simulation_compactParticles(lua_State *l);
+	static int simulation_compactedID(lua_State *l);
+	static int simulation_randomSeed(lua_State *l);
+	static int simulation_profileTrace(lua_State *l);
+	static int simulation_rewind(lua_State *l);
+	static int simulation_rewindCount(lua_State *l);
+	static int simulation_rewindSettings(lua_State *l);
+	static int simulation_levelPack(lua_State *l);
+	static int simulation_writeLevelPack(lua_State *l);
+	static int simulation_loadLevel(lua_State *l);
+	static int simulation_levelInfo(lua_State *l);
 
 	//Renderer
 	void initRendererAPI();
@@ -4,9 +4,157 @@
 #include <algorithm>
 
 #include "Simulation.h"
+#include "WorkerPool.h"
 #include "ElementClasses.h"
+#include "VectorFloat.h"
+#include "common/Profiler.h"
 #include "common/tpt-rand.h"
 
+namespace
+{
+	const int airW = XRES/CELL, airH = YRES/CELL;
+
+	// One cell of each update_air stencil. The scalar path is made of these, the
+	// vector path uses them for whatever doesn't fill a whole VectorFloat.
+	inline void PressureCell(Air &air, int x, int y)
+	{
+		if (air.cellAsleep[y][x])
+			return;
+		float dp = 0.0f;
+		dp += air.vx[y][x-1] - air.vx[y][x];
+		dp += air.vy[y-1][x] - air.vy[y][x];
+		air.pv[y][x] *= AIR_PLOSS;
+		air.pv[y][x] += dp*AIR_TSTEPP;
+	}
+
+	inline void VelocityCell(Air &air, int x, int y)
+	{
+		if (air.cellAsleep[y][x])
+			return;
+		float dx = 0.0f, dy = 0.0f;
+		dx += air.pv[y][x] - air.pv[y][x+1];
+		dy += air.pv[y][x] - air.pv[y+1][x];
+		air.vx[y][x] *= AIR_VLOSS;
+		air.vy[y][x] *= AIR_VLOSS;
+		air.vx[y][x] += dx*AIR_TSTEPV;
+		air.vy[y][x] += dy*AIR_TSTEPV;
+		if (air.bmap_blockair[y][x] || air.bmap_blockair[y][x+1])
+			air.vx[y][x] = 0;
+		if (air.bmap_blockair[y][x] || air.bmap_blockair[y+1][x])
+			air.vy[y][x] = 0;
+	}
+
+	// 3x3 blur of velocity and pressure, taking the centre value in place of neighbours that are walls or off the edge
+	inline void BlurCell(Air &air, int x, int y, float &dx, float &dy, float &dp)
+	{
+		dx = 0.0f;
+		dy = 0.0f;
+		dp = 0.0f;
+		for (int j=-1; j<2; j++)
+			for (int i=-1; i<2; i++)
+			{
+				float f = air.kernel[i+1+(j+1)*3];
+				if (y+j>0 && y+j<airH-1 &&
+				        x+i>0 && x+i<airW-1 &&
+				        !air.bmap_blockair[y+j][x+i])
+				{
+					dx += air.vx[y+j][x+i]*f;
+					dy += air.vy[y+j][x+i]*f;
+					dp += air.pv[y+j][x+i]*f;
+				}
+				else
+				{
+					dx += air.vx[y][x]*f;
+					dy += air.vy[y][x]*f;
+					dp += air.pv[y][x]*f;
+				}
+			}
+	}
+
+	// The vector versions do the same arithmetic in the same order, so they only differ
+	// from the scalar path where the compiler contracts or reorders float operations
+	void PressureVector(Air &air)
+	{
+		const int w = VectorFloat::Width;
+		for (int y=1; y<airH; y++)
+		{
+			int x = 1, end = x + (airW-x)/w*w;
+			for (; x<end; x+=w)
+			{
+				VectorFloat dp = VectorFloat::Load(&air.vx[y][x-1]) - VectorFloat::Load(&air.vx[y][x]);
+				dp = dp + (VectorFloat::Load(&air.vy[y-1][x]) - VectorFloat::Load(&air.vy[y][x]));
+				VectorFloat pv = VectorFloat::Load(&air.pv[y][x]);
+				VectorFloat next = pv*AIR_PLOSS + dp*AIR_TSTEPP;
+				Select(VectorMask::Zero(&air.cellAsleep[y][x]), next, pv).Store(&air.pv[y][x]);
+			}
+			for (; x<airW; x++)
+				PressureCell(air, x, y);
+		}
+	}
+
+	void VelocityVector(Air &air)
+	{
+		const int w = VectorFloat::Width;
+		for (int y=0; y<airH-1; y++)
+		{
+			int x = 0, end = (airW-1)/w*w;
+			for (; x<end; x+=w)
+			{
+				VectorFloat pv = VectorFloat::Load(&air.pv[y][x]);
+				VectorFloat dx = pv - VectorFloat::Load(&air.pv[y][x+1]);
+				VectorFloat dy = pv - VectorFloat::Load(&air.pv[y+1][x]);
+				VectorFloat vx = VectorFloat::Load(&air.vx[y][x]);
+				VectorFloat vy = VectorFloat::Load(&air.vy[y][x]);
+				VectorMask open = VectorMask::Zero(&air.bmap_blockair[y][x]);
+				VectorFloat nextX = Select(open & VectorMask::Zero(&air.bmap_blockair[y][x+1]), vx*AIR_VLOSS + dx*AIR_TSTEPV, 0.0f);
+				VectorFloat nextY = Select(open & VectorMask::Zero(&air.bmap_blockair[y+1][x]), vy*AIR_VLOSS + dy*AIR_TSTEPV, 0.0f);
+				VectorMask awake = VectorMask::Zero(&air.cellAsleep[y][x]);
+				Select(awake, nextX, vx).Store(&air.vx[y][x]);
+				Select(awake, nextY, vy).Store(&air.vy[y][x]);
+			}
+			for (; x<airW-1; x++)
+				VelocityCell(air, x, y);
+		}
+	}
+
+	// Fills bvx, bvy and bpv with BlurCell for every cell. Away from the edges every
+	// neighbour is in bounds, so only the wall check is left to mask.
+	void BlurVector(Air &air)
+	{
+		const int w = VectorFloat::Width;
+		for (int y=0; y<airH; y++)
+		{
+			int x = 0;
+			if (y>=2 && y<airH-2)
+			{
+				for (; x<2; x++)
+					BlurCell(air, x, y, air.bvx[y][x], air.bvy[y][x], air.bpv[y][x]);
+				for (int end = x + (airW-2-x)/w*w; x<end; x+=w)
+				{
+					VectorFloat cx = VectorFloat::Load(&air.vx[y][x]);
+					VectorFloat cy = VectorFloat::Load(&air.vy[y][x]);
+					VectorFloat cp = VectorFloat::Load(&air.pv[y][x]);
+					VectorFloat dx = 0.0f, dy = 0.0f, dp = 0.0f;
+					for (int j=-1; j<2; j++)
+						for (int i=-1; i<2; i++)
+						{
+							VectorFloat f = air.kernel[i+1+(j+1)*3];
+							VectorMask open = VectorMask::Zero(&air.bmap_blockair[y+j][x+i]);
+							dx = dx + Select(open, VectorFloat::Load(&air.vx[y+j][x+i]), cx)*f;
+							dy = dy + Select(open, VectorFloat::Load(&air.vy[y+j][x+i]), cy)*f;
+							dp = dp + Select(open, VectorFloat::Load(&air.pv[y+j][x+i]), cp)*f;
+						}
+					dx.Store(&air.bvx[y][x]);
+					dy.Store(&air.bvy[y][x]);
+					dp.Store(&air.bpv[y][x]);
+				}
+			}
+			for (; x<airW; x++)
+				BlurCell(air, x, y, air.bvx[y][x], air.bvy[y][x], air.bpv[y][x]);
+		}
+	}
+}
+
 /*float kernel[9];
 
 float vx[YRES/CELL][XRES/CELL], ovx[YRES/CELL][XRES/CELL];
@@ -41,6 +189,7 @@ void Air::make_kernel(void) //used for velocity
 
 void Air::Clear()
 {
+	resets++;
 	std::fill(&pv[0][0], &pv[0][0]+((XRES/CELL)*(YRES/CELL)), 0.0f);
 	std::fill(&vy[0][0], &vy[0][0]+((XRES/CELL)*(YRES/CELL)), 0.0f);
 	std::fill(&vx[0][0], &vx[0][0]+((XRES/CELL)*(YRES/CELL)), 0.0f);
@@ -48,13 +197,14 @@ void Air::Clear()
 
 void Air::ClearAirH()
 {
+	resets++;
 	std::fill(&hv[0][0], &hv[0][0]+((XRES/CELL)*(YRES/CELL)), ambientAirTemp);
 }
 
 void Air::update_airh(void)
 {
-	int x, y, i, j;
-	float odh, dh, dx, dy, f, tx, ty;
+	ProfileScope profile(Profiler::UpdateAirHeat);
+	int i;
 	for (i=0; i<YRES/CELL; i++) //reduces pressure/velocity on the edges every frame
 	{
 		hv[i][0] = ambientAirTemp;
@@ -71,66 +221,115 @@ void Air::update_airh(void)
 		hv[YRES/CELL-2][i] = ambientAirTemp;
 		hv[YRES/CELL-1][i] = ambientAirTemp;
 	}
-	for (y=0; y<YRES/CELL; y++) //update velocity and pressure
+	// Rows are updated in bands, possibly on several threads. Each band only
+	// reads hv and writes its own rows of ohv, and the hot air rising into vy is
+	// worked out up front, so the bands don't depend on each other.
+	ForEachBand([this](int y0, int y1) {
+		for (int y=y0; y<y1; y++)
+			for (int x=0; x<XRES/CELL; x++)
+			{
+				hvy[y][x] = 0.0f;
+				if (!gravityMode && !cellAsleep[y][x])
+				{ //Vertical gravity only for the time being
+					float airdiff = hv[y-1][x]-hv[y][x];
+					if(airdiff>0 && !(bmap_blockairh[y-1][x]&0x8))
+						hvy[y][x] = airdiff/5000.0f;
+				}
+			}
+	});
+	ForEachBand([this](int y0, int y1) {
+		for (int y=y0; y<y1; y++)
+			update_airh_row(y);
+	});
+	ForEachBand([this](int y0, int y1) {
+		for (int y=y0; y<y1; y++)
+		{
+			std::copy(ohv[y], ohv[y]+XRES/CELL, hv[y]);
+			for (int x=0; x<XRES/CELL; x++)
+				vy[y][x] -= hvy[y][x];
+		}
+	});
+}
+
+void Air::update_airh_row(int y)
+{
+	int x, i, j;
+	float odh, dh, dx, dy, f, tx, ty;
+	for (x=0; x<XRES/CELL; x++)
 	{
-		for (x=0; x<XRES/CELL; x++)
+		if (cellAsleep[y][x])
+		{
+			// only woken up by something else changing the temperature
+			if (hv[y][x] != ohv[y][x])
+				cellIdle[y][x] = 0;
+			ohv[y][x] = hv[y][x];
+			continue;
+		}
+		dh = 0.0f;
+		dx = 0.0f;
+		dy = 0.0f;
+		for (j=-1; j<2; j++)
 		{
-			dh = 0.0f;
-			dx = 0.0f;
-			dy = 0.0f;
-			for (j=-1; j<2; j++)
+			for (i=-1; i<2; i++)
 			{
-				for (i=-1; i<2; i++)
-				{
-					if (y+j>0 && y+j<YRES/CELL-2 &&
-					        x+i>0 && x+i<XRES/CELL-2 &&
-					        !(bmap_blockairh[y+j][x+i]&0x8))
-						{
-						f = kernel[i+1+(j+1)*3];
-						dh += hv[y+j][x+i]*f;
-						dx += vx[y+j][x+i]*f;
-						dy += vy[y+j][x+i]*f;
-					}
-					else
+				if (y+j>0 && y+j<YRES/CELL-2 &&
+				        x+i>0 && x+i<XRES/CELL-2 &&
+				        !(bmap_blockairh[y+j][x+i]&0x8))
 					{
-						f = kernel[i+1+(j+1)*3];
-						dh += hv[y][x]*f;
-						dx += vx[y][x]*f;
-						dy += vy[y][x]*f;
-					}
+					f = kernel[i+1+(j+1)*3];
+					dh += hv[y+j][x+i]*f;
+					dx += vx[y+j][x+i]*f;
+					// cells before this one have already had hvy taken off vy
+					dy += ((j<0 || (j==0 && i<0)) ? vy[y+j][x+i]-hvy[y+j][x+i] : vy[y+j][x+i])*f;
+				}
+				else
+				{
+					f = kernel[i+1+(j+1)*3];
+					dh += hv[y][x]*f;
+					dx += vx[y][x]*f;
+					dy += vy[y][x]*f;
 				}
 			}
-			tx = x - dx*0.7f;
-			ty = y - dy*0.7f;
-			i = (int)tx;
-			j = (int)ty;
-			tx -= i;
-			ty -= j;
-			if (i>=2 && i<XRES/CELL-3 && j>=2 && j<YRES/CELL-3)
-			{
-				odh = dh;
-				dh *= 1.0f - AIR_VADV;
-				dh += AIR_VADV*(1.0f-tx)*(1.0f-ty)*((bmap_blockairh[j][i]&0x8) ? odh : hv[j][i]);
-				dh += AIR_VADV*tx*(1.0f-ty)*((bmap_blockairh[j][i+1]&0x8) ? odh : hv[j][i+1]);
-				dh += AIR_VADV*(1.0f-tx)*ty*((bmap_blockairh[j+1][i]&0x8) ? odh : hv[j+1][i]);
-				dh += AIR_VADV*tx*ty*((bmap_blockairh[j+1][i+1]&0x8) ? odh : hv[j+1][i+1]);
-			}
-			if(!sim.gravityMode)
-			{ //Vertical gravity only for the time being
-				float airdiff = hv[y-1][x]-hv[y][x];
-				if(airdiff>0 && !(bmap_blockairh[y-1][x]&0x8))
-					vy[y][x] -= airdiff/5000.0f;
-			}
-			ohv[y][x] = dh;
 		}
+		tx = x - dx*0.7f;
+		ty = y - dy*0.7f;
+		i = (int)tx;
+		j = (int)ty;
+		tx -= i;
+		ty -= j;
+		if (i>=2 && i<XRES/CELL-3 && j>=2 && j<YRES/CELL-3)
+		{
+			odh = dh;
+			dh *= 1.0f - AIR_VADV;
+			dh += AIR_VADV*(1.0f-tx)*(1.0f-ty)*((bmap_blockairh[j][i]&0x8) ? odh : hv[j][i]);
+			dh += AIR_VADV*tx*(1.0f-ty)*((bmap_blockairh[j][i+1]&0x8) ? odh : hv[j][i+1]);
+			dh += AIR_VADV*(1.0f-tx)*ty*((bmap_blockairh[j+1][i]&0x8) ? odh : hv[j+1][i]);
+			dh += AIR_VADV*tx*ty*((bmap_blockairh[j+1][i+1]&0x8) ? odh : hv[j+1][i+1]);
+		}
+		if (std::abs(dh - ohv[y][x]) > SLEEP_AIR_DELTA)
+			cellIdle[y][x] = 0;
+		ohv[y][x] = dh;
 	}
-	memcpy(hv, ohv, sizeof(hv));
+}
+
+void Air::ForEachBand(std::function<void(int, int)> fn)
+{
+	const int bandRows = 8, bands = (YRES/CELL + bandRows - 1) / bandRows;
+	auto band = [&fn](int n) {
+		fn(n * bandRows, std::min((n + 1) * bandRows, YRES/CELL));
+	};
+	if (pool)
+		pool->Run(bands, band);
+	else
+		for (int n = 0; n < bands; n++)
+			band(n);
 }
 
 void Air::update_air(void)
 {
+	ProfileScope profile(Profiler::UpdateAir);
 	int x = 0, y = 0, i = 0, j = 0;
-	float dp = 0.0f, dx = 0.0f, dy = 0.0f, f = 0.0f, tx = 0.0f, ty = 0.0f;
+	float dp = 0.0f, dx = 0.0f, dy = 0.0f, tx = 0.0f, ty = 0.0f;
 	const float advDistanceMult = 0.7f;
 	float stepX, stepY;
 	int stepLimit, step;
@@ -184,56 +383,44 @@ void Air::update_air(void)
 			}
 		}
 
-		for (y=1; y<YRES/CELL; y++) //pressure adjustments from velocity
-			for (x=1; x<XRES/CELL; x++)
-			{
-				dp = 0.0f;
-				dp += vx[y][x-1] - vx[y][x];
-				dp += vy[y-1][x] - vy[y][x];
-				pv[y][x] *= AIR_PLOSS;
-				pv[y][x] += dp*AIR_TSTEPP;
-			}
+		if (vectorise)
+		{
+			PressureVector(*this);
+			VelocityVector(*this);
+			BlurVector(*this);
+		}
+		else
+		{
+			for (y=1; y<YRES/CELL; y++) //pressure adjustments from velocity
+				for (x=1; x<XRES/CELL; x++)
+					PressureCell(*this, x, y);
 
-		for (y=0; y<YRES/CELL-1; y++) //velocity adjustments from pressure
-			for (x=0; x<XRES/CELL-1; x++)
-			{
-				dx = dy = 0.0f;
-				dx += pv[y][x] - pv[y][x+1];
-				dy += pv[y][x] - pv[y+1][x];
-				vx[y][x] *= AIR_VLOSS;
-				vy[y][x] *= AIR_VLOSS;
-				vx[y][x] += dx*AIR_TSTEPV;
-				vy[y][x] += dy*AIR_TSTEPV;
-				if (bmap_blockair[y][x] || bmap_blockair[y][x+1])
-					vx[y][x] = 0;
-				if (bmap_blockair[y][x] || bmap_blockair[y+1][x])
-					vy[y][x] = 0;
-			}
+			for (y=0; y<YRES/CELL-1; y++) //velocity adjustments from pressure
+				for (x=0; x<XRES/CELL-1; x++)
+					VelocityCell(*this, x, y);
+		}
 
 		for (y=0; y<YRES/CELL; y++) //update velocity and pressure
 			for (x=0; x<XRES/CELL; x++)
 			{
-				dx = 0.0f;
-				dy = 0.0f;
-				dp = 0.0f;
-				for (j=-1; j<2; j++)
-					for (i=-1; i<2; i++)
-						if (y+j>0 && y+j<YRES/CELL-1 &&
-						        x+i>0 && x+i<XRES/CELL-1 &&
-						        !bmap_blockair[y+j][x+i])
-						{
-							f = kernel[i+1+(j+1)*3];
-							dx += vx[y+j][x+i]*f;
-							dy += vy[y+j][x+i]*f;
-							dp += pv[y+j][x+i]*f;
-						}
-						else
-						{
-							f = kernel[i+1+(j+1)*3];
-							dx += vx[y][x]*f;
-							dy += vy[y][x]*f;
-							dp += pv[y][x]*f;
-						}
+				if (cellAsleep[y][x])
+				{
+					// only woken up by something else changing the air here
+					if (vx[y][x] != ovx[y][x] || vy[y][x] != ovy[y][x] || pv[y][x] != opv[y][x])
+						cellIdle[y][x] = 0;
+					ovx[y][x] = vx[y][x];
+					ovy[y][x] = vy[y][x];
+					opv[y][x] = pv[y][x];
+					continue;
+				}
+				if (vectorise)
+				{
+					dx = bvx[y][x];
+					dy = bvy[y][x];
+					dp = bpv[y][x];
+				}
+				else
+					BlurCell(*this, x, y, dx, dy, dp);
 
 				tx = x - dx*advDistanceMult;
 				ty = y - dy*advDistanceMult;
@@ -330,6 +517,8 @@ void Air::update_air(void)
 					break;
 				}
 
+				if (std::abs(dx - ovx[y][x]) > SLEEP_AIR_DELTA || std::abs(dy - ovy[y][x]) > SLEEP_AIR_DELTA || std::abs(dp - opv[y][x]) > SLEEP_AIR_DELTA)
+					cellIdle[y][x] = 0;
 				ovx[y][x] = dx;
 				ovy[y][x] = dy;
 				opv[y][x] = dp;
@@ -343,6 +532,7 @@ void Air::update_air(void)
 void Air::Invert()
 {
 	int nx, ny;
+	resets++;
 	for (nx = 0; nx<XRES/CELL; nx++)
 		for (ny = 0; ny<YRES/CELL; ny++)
 		{
@@ -355,6 +545,9 @@ void Air::Invert()
 // called when loading saves / stamps to ensure nothing "leaks" the first frame
 void Air::RecalculateBlockAirMaps()
 {
+	// From its own stream, so that loading a save doesn't depend on what was drawn before
+	RNG rng;
+	rng.seed(sim.rngSeed, sim.currentTick, ~0U);
 	for (int i = 0; i <= sim.parts_lastActiveIndex; i++)
 	{
 		int type = sim.parts[i].type;
@@ -373,7 +566,7 @@ void Air::RecalculateBlockAirMaps()
 			}
 		}
 		// mostly accurate insulator blocking, besides checking GEL
-		else if ((type == PT_HSWC && sim.parts[i].life != 10) || sim.elements[type].HeatConduct <= (random_gen()%250))
+		else if ((type == PT_HSWC && sim.parts[i].life != 10) || sim.elements[type].HeatConduct <= (rng()%250))
 		{
 			int x = ((int)(sim.parts[i].x+0.5f))/CELL, y = ((int)(sim.parts[i].y+0.5f))/CELL;
 			if (sim.InBounds(x, y) && !(bmap_blockairh[y][x]&0x8))
@@ -385,7 +578,11 @@ void Air::RecalculateBlockAirMaps()
 Air::Air(Simulation & simulation):
 	sim(simulation),
 	airMode(0),
-	ambientAirTemp(295.15f)
+	ambientAirTemp(295.15f),
+	gravityMode(0),
+	pool(nullptr),
+	resets(0),
+	vectorise(VectorFloat::Width > 1)
 {
 	//Simulation should do this.
 	make_kernel();
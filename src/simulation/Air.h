@@ -2,7 +2,10 @@
 #define AIR_H
 #include "Config.h"
 
+#include <functional>
+
 class Simulation;
+class WorkerPool;
 
 class Air
 {
@@ -10,11 +13,19 @@ public:
 	Simulation & sim;
 	int airMode;
 	float ambientAirTemp;
+	// Copied from the simulation before each update, so that a copy of Air can be updated on another thread
+	int gravityMode;
+	// Where update_airh runs its bands, serially if null
+	WorkerPool *pool;
+	// Bumped whenever the air is replaced wholesale, by Clear, ClearAirH and Invert
+	unsigned int resets;
 	//Arrays from the simulation
 	unsigned char (*bmap)[XRES/CELL];
 	unsigned char (*emap)[XRES/CELL];
 	float (*fvx)[XRES/CELL];
 	float (*fvy)[XRES/CELL];
+	unsigned char (*cellIdle)[XRES/CELL];
+	unsigned char (*cellAsleep)[XRES/CELL];
 	//
 	float vx[YRES/CELL][XRES/CELL];
 	float ovx[YRES/CELL][XRES/CELL];
@@ -24,11 +35,21 @@ public:
 	float opv[YRES/CELL][XRES/CELL];
 	float hv[YRES/CELL][XRES/CELL];
 	float ohv[YRES/CELL][XRES/CELL]; // Ambient Heat
+	float hvy[YRES/CELL][XRES/CELL]; // What update_airh takes off vy for hot air rising
+	float bvx[YRES/CELL][XRES/CELL];
+	float bvy[YRES/CELL][XRES/CELL];
+	float bpv[YRES/CELL][XRES/CELL]; // Blurred velocity and pressure, only used by the vector stencils
 	unsigned char bmap_blockair[YRES/CELL][XRES/CELL];
 	unsigned char bmap_blockairh[YRES/CELL][XRES/CELL];
 	float kernel[9];
+	// Run the update_air stencils with VectorFloat (see VectorFloat.h); on by default
+	// when the build has a vector instruction set, off runs the plain loops
+	bool vectorise;
 	void make_kernel(void);
 	void update_airh(void);
+	void update_airh_row(int y);
+	// Calls fn(y0, y1) for bands of rows covering the whole grid, on pool if there is one
+	void ForEachBand(std::function<void(int, int)> fn);
 	void update_air(void);
 	void Clear();
 	void ClearAirH();
@@ -0,0 +1,136 @@
+#include "AirPipeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Air.h"
+
+AirPipeline::AirPipeline(Air &air):
+	air(air),
+	work(new Air(air.sim))
+{
+	work->bmap = bmap;
+	work->emap = air.emap;
+	work->fvx = fvx;
+	work->fvy = fvy;
+	work->cellIdle = cellIdle;
+	work->cellAsleep = cellAsleep;
+	work->pool = nullptr;
+}
+
+AirPipeline::~AirPipeline()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+}
+
+void AirPipeline::Work()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	while (true)
+	{
+		cv.wait(l, [this]() { return queued || stopping; });
+		if (stopping)
+			return;
+		queued = false;
+		l.unlock();
+		work->update_air();
+		if (heat)
+			work->update_airh();
+		l.lock();
+		done = true;
+		cv.notify_all();
+	}
+}
+
+void AirPipeline::Wait()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	cv.wait(l, [this]() { return done; });
+	done = false;
+	pending = false;
+}
+
+void AirPipeline::Start(bool heat)
+{
+	std::copy(&air.vx[0][0], &air.vx[0][0] + (XRES/CELL)*(YRES/CELL), &startVx[0][0]);
+	std::copy(&air.vy[0][0], &air.vy[0][0] + (XRES/CELL)*(YRES/CELL), &startVy[0][0]);
+	std::copy(&air.pv[0][0], &air.pv[0][0] + (XRES/CELL)*(YRES/CELL), &startPv[0][0]);
+	std::copy(&air.hv[0][0], &air.hv[0][0] + (XRES/CELL)*(YRES/CELL), &startHv[0][0]);
+	std::memcpy(work->vx, startVx, sizeof(startVx));
+	std::memcpy(work->vy, startVy, sizeof(startVy));
+	std::memcpy(work->pv, startPv, sizeof(startPv));
+	std::memcpy(work->hv, startHv, sizeof(startHv));
+	if (!continuous)
+	{
+		// The previous results are only used to notice sleeping cells changing, see Air::update_air
+		std::memcpy(work->ovx, air.ovx, sizeof(air.ovx));
+		std::memcpy(work->ovy, air.ovy, sizeof(air.ovy));
+		std::memcpy(work->opv, air.opv, sizeof(air.opv));
+		std::memcpy(work->ohv, air.ohv, sizeof(air.ohv));
+	}
+	std::memcpy(work->bmap_blockair, air.bmap_blockair, sizeof(air.bmap_blockair));
+	std::memcpy(work->bmap_blockairh, air.bmap_blockairh, sizeof(air.bmap_blockairh));
+	std::copy(&air.bmap[0][0], &air.bmap[0][0] + (XRES/CELL)*(YRES/CELL), &bmap[0][0]);
+	std::copy(&air.fvx[0][0], &air.fvx[0][0] + (XRES/CELL)*(YRES/CELL), &fvx[0][0]);
+	std::copy(&air.fvy[0][0], &air.fvy[0][0] + (XRES/CELL)*(YRES/CELL), &fvy[0][0]);
+	std::copy(&air.cellAsleep[0][0], &air.cellAsleep[0][0] + (XRES/CELL)*(YRES/CELL), &cellAsleep[0][0]);
+	std::fill(&cellIdle[0][0], &cellIdle[0][0] + (XRES/CELL)*(YRES/CELL), 1);
+	work->airMode = air.airMode;
+	work->ambientAirTemp = air.ambientAirTemp;
+	work->gravityMode = air.gravityMode;
+	this->heat = heat;
+	resets = air.resets;
+
+	if (!thread.joinable())
+		thread = std::thread([this]() { Work(); });
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		queued = true;
+		pending = true;
+	}
+	cv.notify_all();
+}
+
+void AirPipeline::Finish()
+{
+	if (!pending)
+		return;
+	Wait();
+	// Air::Clear, ClearAirH or Invert replaced the air the job started from
+	if (air.resets != resets)
+	{
+		continuous = false;
+		return;
+	}
+	// Cells nothing else touched take the result as is, the rest get the change added on
+	auto merge = [](float &live, float result, float start) {
+		live = (live == start) ? result : live + (result - start);
+	};
+	for (int y = 0; y < YRES/CELL; y++)
+		for (int x = 0; x < XRES/CELL; x++)
+		{
+			merge(air.vx[y][x], work->vx[y][x], startVx[y][x]);
+			merge(air.vy[y][x], work->vy[y][x], startVy[y][x]);
+			merge(air.pv[y][x], work->pv[y][x], startPv[y][x]);
+			if (heat)
+				merge(air.hv[y][x], work->hv[y][x], startHv[y][x]);
+			if (!cellIdle[y][x])
+				air.cellIdle[y][x] = 0;
+		}
+	continuous = true;
+}
+
+void AirPipeline::Discard()
+{
+	if (pending)
+		Wait();
+	continuous = false;
+}
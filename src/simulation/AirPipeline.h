@@ -0,0 +1,66 @@
+#ifndef AIRPIPELINE_H
+#define AIRPIPELINE_H
+#include "Config.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Air;
+
+/*
+ * Runs the air update one frame behind, on its own thread, while particles
+ * update. Start copies the live air into a second Air and sets the thread
+ * updating that; Finish waits for it and adds what the update changed onto the
+ * live air, keeping whatever particles, tools and scripts did to the live air
+ * in the meantime. See Simulation::pipelineAir.
+ */
+class AirPipeline
+{
+private:
+	Air &air;
+	std::unique_ptr<Air> work;
+
+	// What the job started from, to tell what the update changed
+	float startVx[YRES/CELL][XRES/CELL];
+	float startVy[YRES/CELL][XRES/CELL];
+	float startPv[YRES/CELL][XRES/CELL];
+	float startHv[YRES/CELL][XRES/CELL];
+	// Copies of the simulation maps the update reads, so they can change while it runs
+	unsigned char bmap[YRES/CELL][XRES/CELL];
+	float fvx[YRES/CELL][XRES/CELL];
+	float fvy[YRES/CELL][XRES/CELL];
+	unsigned char cellIdle[YRES/CELL][XRES/CELL];
+	unsigned char cellAsleep[YRES/CELL][XRES/CELL];
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+	bool queued = false;
+	bool done = false;
+
+	// A job was started and its result hasn't been collected or discarded yet
+	bool pending = false;
+	// work holds the result of the previous job, rather than something stale
+	bool continuous = false;
+	bool heat = false;
+	unsigned int resets = 0;
+
+	void Work();
+	void Wait();
+
+public:
+	AirPipeline(Air &air);
+	~AirPipeline();
+
+	// Starts updating a copy of the live air. Must not be called with a job pending.
+	void Start(bool heat);
+	// Waits for the job started last, if any, and applies its result to the live air
+	void Finish();
+	// Waits for the job started last, if any, and throws its result away
+	void Discard();
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "FFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "VectorFloat.h"
+
+namespace
+{
+	const double pi = 3.14159265358979323846;
+
+	inline void Twiddle(VectorFloat &re, VectorFloat &im, float wr, float wi)
+	{
+		VectorFloat r = re * wr - im * wi;
+		im = re * wi + im * wr;
+		re = r;
+	}
+
+	// In place DFT of radix values. sign is -1 for forward transforms, 1 for inverse.
+	inline void Butterfly(int radix, VectorFloat *re, VectorFloat *im, float sign)
+	{
+		switch (radix)
+		{
+		case 2:
+		{
+			VectorFloat r = re[0] - re[1], i = im[0] - im[1];
+			re[0] = re[0] + re[1];
+			im[0] = im[0] + im[1];
+			re[1] = r;
+			im[1] = i;
+			break;
+		}
+		case 4:
+		{
+			VectorFloat r0 = re[0] + re[2], i0 = im[0] + im[2];
+			VectorFloat r1 = re[0] - re[2], i1 = im[0] - im[2];
+			VectorFloat r2 = re[1] + re[3], i2 = im[1] + im[3];
+			// times -i going forward, i going back
+			VectorFloat r3 = (im[1] - im[3]) * -sign, i3 = (re[1] - re[3]) * sign;
+			re[0] = r0 + r2;
+			im[0] = i0 + i2;
+			re[2] = r0 - r2;
+			im[2] = i0 - i2;
+			re[1] = r1 + r3;
+			im[1] = i1 + i3;
+			re[3] = r1 - r3;
+			im[3] = i1 - i3;
+			break;
+		}
+		case 3:
+		{
+			const float c = -0.5f, s = 0.86602540378443864676f * sign;
+			VectorFloat sr = re[1] + re[2], si = im[1] + im[2];
+			VectorFloat dr = (re[1] - re[2]) * s, di = (im[1] - im[2]) * s;
+			VectorFloat mr = re[0] + sr * c, mi = im[0] + si * c;
+			re[0] = re[0] + sr;
+			im[0] = im[0] + si;
+			re[1] = mr - di;
+			im[1] = mi + dr;
+			re[2] = mr + di;
+			im[2] = mi - dr;
+			break;
+		}
+		case 5:
+		{
+			const float c1 = 0.30901699437494742410f, c2 = -0.80901699437494742410f;
+			const float s1 = 0.95105651629515357212f * sign, s2 = 0.58778525229247312917f * sign;
+			VectorFloat ar = re[1] + re[4], ai = im[1] + im[4];
+			VectorFloat br = re[1] - re[4], bi = im[1] - im[4];
+			VectorFloat cr = re[2] + re[3], ci = im[2] + im[3];
+			VectorFloat dr = re[2] - re[3], di = im[2] - im[3];
+			VectorFloat m1r = re[0] + ar * c1 + cr * c2, m1i = im[0] + ai * c1 + ci * c2;
+			VectorFloat m2r = re[0] + ar * c2 + cr * c1, m2i = im[0] + ai * c2 + ci * c1;
+			VectorFloat n1r = br * s1 + dr * s2, n1i = bi * s1 + di * s2;
+			VectorFloat n2r = br * s2 - dr * s1, n2i = bi * s2 - di * s1;
+			re[0] = re[0] + ar + cr;
+			im[0] = im[0] + ai + ci;
+			re[1] = m1r - n1i;
+			im[1] = m1i + n1r;
+			re[4] = m1r + n1i;
+			im[4] = m1i - n1r;
+			re[2] = m2r - n2i;
+			im[2] = m2i + n2r;
+			re[3] = m2r + n2i;
+			im[3] = m2i - n2r;
+			break;
+		}
+		}
+	}
+}
+
+FFT::FFT(int size):
+	size(size)
+{
+	int left = size;
+	for (int radix : { 4, 2, 3, 5 })
+		while (left % radix == 0)
+		{
+			radices.push_back(radix);
+			left /= radix;
+		}
+	// GoodSize gives sizes that always end up here
+	if (left != 1)
+		radices.clear();
+
+	int span = 1;
+	for (int radix : radices)
+	{
+		passStart.push_back(twiddleRe.size());
+		for (int k = 0; k < span; k++)
+			for (int r = 0; r < radix; r++)
+			{
+				double angle = -2.0 * pi * r * k / (span * radix);
+				twiddleRe.push_back(float(std::cos(angle)));
+				twiddleIm.push_back(float(std::sin(angle)));
+			}
+		span *= radix;
+	}
+}
+
+int FFT::GoodSize(int minimum)
+{
+	for (int size = std::max(minimum, 1); ; size++)
+	{
+		int left = size;
+		for (int radix : { 2, 3, 5 })
+			while (left % radix == 0)
+				left /= radix;
+		if (left == 1)
+			return size;
+	}
+}
+
+void FFT::Transform(float *re, float *im, int stride, int width, bool inverse)
+{
+	const int w = VectorFloat::Width;
+	scratchRe.resize(size * stride);
+	scratchIm.resize(size * stride);
+	float sign = inverse ? 1.0f : -1.0f;
+	float *inRe = re, *inIm = im, *outRe = scratchRe.data(), *outIm = scratchIm.data();
+	int span = 1;
+	for (size_t pass = 0; pass < radices.size(); pass++)
+	{
+		int radix = radices[pass], count = size / radix;
+		float const *passRe = &twiddleRe[passStart[pass]], *passIm = &twiddleIm[passStart[pass]];
+		for (int j = 0; j < count; j++)
+		{
+			int k = j % span;
+			int out = (j / span) * span * radix + k;
+			float const *wr = passRe + k * radix, *wi = passIm + k * radix;
+			for (int c = 0; c < width; c += w)
+			{
+				VectorFloat vr[5], vi[5];
+				for (int r = 0; r < radix; r++)
+				{
+					vr[r] = VectorFloat::Load(inRe + (j + r * count) * stride + c);
+					vi[r] = VectorFloat::Load(inIm + (j + r * count) * stride + c);
+					if (r && k)
+						Twiddle(vr[r], vi[r], wr[r], -sign * wi[r]);
+				}
+				Butterfly(radix, vr, vi, sign);
+				for (int r = 0; r < radix; r++)
+				{
+					vr[r].Store(outRe + (out + r * span) * stride + c);
+					vi[r].Store(outIm + (out + r * span) * stride + c);
+				}
+			}
+		}
+		std::swap(inRe, outRe);
+		std::swap(inIm, outIm);
+		span *= radix;
+	}
+	if (inRe != re)
+		for (int row = 0; row < size; row++)
+		{
+			std::copy(inRe + row * stride, inRe + row * stride + width, re + row * stride);
+			std::copy(inIm + row * stride, inIm + row * stride + width, im + row * stride);
+		}
+}
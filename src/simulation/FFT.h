@@ -0,0 +1,37 @@
+#ifndef FFT_H
+#define FFT_H
+#include "Config.h"
+
+#include <vector>
+
+/*
+ * Mixed radix (2, 3, 4, 5) complex FFT, done the Stockham way so no bit
+ * reversal pass is needed. It transforms many columns of a grid at once: the
+ * data is size rows of floats, with the real and imaginary parts in separate
+ * arrays, and every butterfly is applied across a whole row with VectorFloat.
+ * Transforming along the other axis is left to the caller, by transposing.
+ */
+class FFT
+{
+	int size;
+	std::vector<int> radices;
+	// Twiddle factors of each pass, starting at passStart
+	std::vector<int> passStart;
+	std::vector<float> twiddleRe, twiddleIm;
+	std::vector<float> scratchRe, scratchIm;
+
+public:
+	FFT(int size);
+
+	int Size() const { return size; }
+
+	// Transforms columns [0, width) of the size x stride arrays re and im, in
+	// place. width must be a multiple of VectorFloat::Width and no larger than
+	// stride. The inverse is not scaled by 1 / size.
+	void Transform(float *re, float *im, int stride, int width, bool inverse);
+
+	// Smallest size at least minimum that only has the supported radices as factors
+	static int GoodSize(int minimum);
+};
+
+#endif
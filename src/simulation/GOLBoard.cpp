@@ -0,0 +1,168 @@
+#include "GOLBoard.h"
+
+#include <algorithm>
+
+#include "BuiltinGOL.h"
+#include "SimulationData.h"
+
+namespace
+{
+	const int words = GOLBoard::words, width = GOLBoard::width, height = GOLBoard::height;
+	const uint64_t lastMask = width % 64 ? (uint64_t(1) << (width % 64)) - 1 : ~uint64_t(0);
+
+	// Row with bit x holding cell x - 1 of row, wrapping around
+	void FromLeft(uint64_t const *row, uint64_t *to)
+	{
+		for (int k = words - 1; k > 0; k--)
+			to[k] = (row[k] << 1) | (row[k - 1] >> 63);
+		to[0] = (row[0] << 1) | ((row[words - 1] >> ((width - 1) % 64)) & 1);
+		to[words - 1] &= lastMask;
+	}
+
+	// Row with bit x holding cell x + 1 of row, wrapping around
+	void FromRight(uint64_t const *row, uint64_t *to)
+	{
+		for (int k = 0; k < words - 1; k++)
+			to[k] = (row[k] >> 1) | (row[k + 1] << 63);
+		to[words - 1] = (row[words - 1] >> 1) | ((row[0] & 1) << ((width - 1) % 64));
+	}
+
+	// Adds x to the 4 bit counters held in s0..s3, one counter per bit
+	inline void Count(uint64_t x, uint64_t &s0, uint64_t &s1, uint64_t &s2, uint64_t &s3)
+	{
+		uint64_t c0 = s0 & x;
+		s0 ^= x;
+		uint64_t c1 = s1 & c0;
+		s1 ^= c0;
+		uint64_t c2 = s2 & c1;
+		s2 ^= c1;
+		s3 |= c2;
+	}
+
+	inline int Wrap(int i, int size)
+	{
+		return i < 0 ? i + size : (i >= size ? i - size : i);
+	}
+}
+
+GOLBoard::GOLBoard():
+	kindCount(0),
+	alive(words * height),
+	aliveLeft(words * height),
+	aliveRight(words * height),
+	candidates(words * height)
+{
+}
+
+void GOLBoard::Clear()
+{
+	for (int i = 0; i < kindCount; i++)
+		std::fill(kinds[i].bits.begin(), kinds[i].bits.end(), 0);
+	kindCount = 0;
+	std::fill(alive.begin(), alive.end(), 0);
+}
+
+int GOLBoard::Kind(int ctype)
+{
+	for (int i = 0; i < kindCount; i++)
+		if (kinds[i].ctype == ctype)
+			return i;
+	if (kindCount == int(kinds.size()))
+	{
+		kinds.emplace_back();
+		kinds.back().bits.resize(words * height);
+	}
+	auto &kind = kinds[kindCount];
+	kind.ctype = ctype;
+	unsigned int ruleset = ctype;
+	if (ruleset < NGOL)
+		ruleset = builtinGol[ruleset].ruleset;
+	for (int n = 0; n <= 8; n++)
+	{
+		kind.survive[n] = (ruleset >> n) & 1 ? ~uint64_t(0) : 0;
+		kind.birth[n] = (ruleset >> (n + 8)) & 1 ? ~uint64_t(0) : 0;
+	}
+	return kindCount++;
+}
+
+void GOLBoard::Step()
+{
+	order.resize(kindCount);
+	for (int i = 0; i < kindCount; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		return unsigned(kinds[a].ctype) < unsigned(kinds[b].ctype);
+	});
+
+	for (int y = 0; y < height; y++)
+	{
+		FromLeft(&alive[y * words], &aliveLeft[y * words]);
+		FromRight(&alive[y * words], &aliveRight[y * words]);
+	}
+	std::array<uint64_t, 9 * words> equal;
+	std::array<uint64_t, words> around, aroundLeft, aroundRight;
+	for (int y = 0; y < height; y++)
+	{
+		int up = Wrap(y - 1, height) * words, row = y * words, down = Wrap(y + 1, height) * words;
+		for (int k = 0; k < words; k++)
+		{
+			uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+			Count(aliveLeft[up + k], s0, s1, s2, s3);
+			Count(alive[up + k], s0, s1, s2, s3);
+			Count(aliveRight[up + k], s0, s1, s2, s3);
+			Count(aliveLeft[row + k], s0, s1, s2, s3);
+			Count(aliveRight[row + k], s0, s1, s2, s3);
+			Count(aliveLeft[down + k], s0, s1, s2, s3);
+			Count(alive[down + k], s0, s1, s2, s3);
+			Count(aliveRight[down + k], s0, s1, s2, s3);
+			// There are at most 8 neighbours, so s3 is only set for 8
+			for (int n = 0; n < 8; n++)
+				equal[n * words + k] = ~s3 & (n & 4 ? s2 : ~s2) & (n & 2 ? s1 : ~s1) & (n & 1 ? s0 : ~s0);
+			equal[8 * words + k] = s3;
+			candidates[row + k] = 0;
+		}
+		for (int i = 0; i < kindCount; i++)
+		{
+			auto &kind = kinds[i];
+			for (int k = 0; k < words; k++)
+				around[k] = kind.bits[up + k] | kind.bits[row + k] | kind.bits[down + k];
+			FromLeft(around.data(), aroundLeft.data());
+			FromRight(around.data(), aroundRight.data());
+			for (int k = 0; k < words; k++)
+			{
+				uint64_t survive = 0, birth = 0;
+				for (int n = 0; n <= 8; n++)
+				{
+					survive |= equal[n * words + k] & kind.survive[n];
+					birth |= equal[n * words + k] & kind.birth[n];
+				}
+				// Cells this kind may be born into: empty, with a neighbour of this
+				// kind and a count the rule gives birth on. Whether the kind wins
+				// the contest for the cell is settled later.
+				uint64_t near = aroundLeft[k] | aroundRight[k] | kind.bits[up + k] | kind.bits[down + k];
+				candidates[row + k] |= (kind.bits[row + k] & ~survive) | (~alive[row + k] & near & birth);
+			}
+		}
+		candidates[row + words - 1] &= lastMask;
+	}
+}
+
+int GOLBoard::Neighbours(int x, int y) const
+{
+	int count = 0;
+	for (int yy = -1; yy <= 1; yy++)
+		for (int xx = -1; xx <= 1; xx++)
+			if ((xx || yy) && Get(alive, Wrap(x + xx, width), Wrap(y + yy, height)))
+				count++;
+	return count;
+}
+
+int GOLBoard::Neighbours(int kind, int x, int y) const
+{
+	int count = 0;
+	for (int yy = -1; yy <= 1; yy++)
+		for (int xx = -1; xx <= 1; xx++)
+			if ((xx || yy) && Get(kinds[kind].bits, Wrap(x + xx, width), Wrap(y + yy, height)))
+				count++;
+	return count;
+}
@@ -0,0 +1,114 @@
+#ifndef GOLBOARD_H
+#define GOLBOARD_H
+#include "Config.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+/*
+ * Live LIFE cells packed one bit per cell, 64 cells to a word, with one board
+ * per rule (ctype) present. Step() counts the live neighbours of every cell at
+ * once with bitwise adders, wrapping around the edges of the GOL space, and
+ * looks the counts up in each rule to mark cells that may be born or die this
+ * generation. Simulation::SimulateGoL then settles just those cells, so the
+ * contest between rules and the choice of colours for new cells stay exactly
+ * as they were.
+ *
+ * Coordinates are relative to the GOL space, which leaves out a CELL wide
+ * border around the simulation area.
+ */
+class GOLBoard
+{
+public:
+	static const int width = XRES - 2 * CELL, height = YRES - 2 * CELL;
+	static const int words = (width + 63) / 64;
+
+private:
+	struct Board
+	{
+		int ctype;
+		// Lookup from neighbour count to all ones if the rule has a cell
+		// survive or be born with that many neighbours
+		std::array<uint64_t, 9> survive, birth;
+		std::vector<uint64_t> bits;
+	};
+	std::vector<Board> kinds;
+	int kindCount;
+	// Kinds sorted by ctype, which is the order they win contests in
+	std::vector<int> order;
+	// Every live cell, and the same shifted so that bit x holds cell x - 1 and x + 1
+	std::vector<uint64_t> alive, aliveLeft, aliveRight;
+	std::vector<uint64_t> candidates;
+
+	bool Get(std::vector<uint64_t> const &bits, int x, int y) const
+	{
+		return (bits[y * words + x / 64] >> (x % 64)) & 1;
+	}
+
+public:
+	GOLBoard();
+
+	// Forgets every cell and kind
+	void Clear();
+	// Index of the board for ctype, adding an empty one if needed
+	int Kind(int ctype);
+	void Set(int kind, int x, int y)
+	{
+		kinds[kind].bits[y * words + x / 64] |= uint64_t(1) << (x % 64);
+		alive[y * words + x / 64] |= uint64_t(1) << (x % 64);
+	}
+	// Marks cells that may change this generation
+	void Step();
+
+	// Calls f(x, y) for every marked cell, row by row
+	template<class F>
+	void ForCandidates(F f) const;
+
+	int KindCount() const
+	{
+		return kindCount;
+	}
+	// Kind that wins contests i-th
+	int Contender(int i) const
+	{
+		return order[i];
+	}
+	int CType(int kind) const
+	{
+		return kinds[kind].ctype;
+	}
+	bool Alive(int kind, int x, int y) const
+	{
+		return Get(kinds[kind].bits, x, y);
+	}
+	// Live neighbours of a cell, of any kind or of one kind only
+	int Neighbours(int x, int y) const;
+	int Neighbours(int kind, int x, int y) const;
+};
+
+template<class F>
+void GOLBoard::ForCandidates(F f) const
+{
+	for (int y = 0; y < height; y++)
+		for (int k = 0; k < words; k++)
+		{
+			uint64_t word = candidates[y * words + k];
+			while (word)
+			{
+#ifdef _MSC_VER
+				unsigned long bit;
+				_BitScanForward64(&bit, word);
+#else
+				int bit = __builtin_ctzll(word);
+#endif
+				f(k * 64 + int(bit), y);
+				word &= word - 1;
+			}
+		}
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "GOLTiles.h"
+
+namespace
+{
+	const int tilesX = GOLTiles::tilesX, tilesY = GOLTiles::tilesY;
+	const int tileWidth = GOLTiles::tileWidth, tileHeight = GOLTiles::tileHeight;
+	// Columns of a tile plus one on either side
+	const int rowBits = tileWidth + 2;
+
+	int Popcount(uint32_t x)
+	{
+		x = x - ((x >> 1) & 0x55555555U);
+		x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+		x = (x + (x >> 4)) & 0x0F0F0F0FU;
+		return int((x * 0x01010101U) >> 24);
+	}
+
+	// Row k of tile with the cells next to it from the tiles to its left and right
+	inline uint64_t Row(uint32_t left, uint32_t middle, uint32_t right, int k)
+	{
+		return ((left >> (k * tileWidth + tileWidth - 1)) & 1) |
+		       (((middle >> (k * tileWidth)) & ((1 << tileWidth) - 1)) << 1) |
+		       (((right >> (k * tileWidth)) & 1) << (tileWidth + 1));
+	}
+}
+
+GOLTiles::GOLTiles():
+	ruleset(0),
+	tiles(tilesX * tilesY),
+	next(tilesX * tilesY)
+{
+}
+
+void GOLTiles::Clear(unsigned int newRuleset)
+{
+	if (newRuleset != ruleset)
+	{
+		memo.clear();
+		ruleset = newRuleset;
+	}
+	std::fill(tiles.begin(), tiles.end(), 0);
+}
+
+uint32_t GOLTiles::Compute(uint64_t neighbourhood) const
+{
+	auto cell = [neighbourhood](int r, int c) {
+		return int((neighbourhood >> (r * rowBits + c)) & 1);
+	};
+	uint32_t result = 0;
+	for (int k = 0; k < tileHeight; k++)
+		for (int c = 0; c < tileWidth; c++)
+		{
+			int r = k + 1, col = c + 1;
+			int neighbours = cell(r - 1, col - 1) + cell(r - 1, col) + cell(r - 1, col + 1) +
+			                 cell(r, col - 1) + cell(r, col + 1) +
+			                 cell(r + 1, col - 1) + cell(r + 1, col) + cell(r + 1, col + 1);
+			bool alive = cell(r, col) ? (ruleset >> neighbours) & 1 : (ruleset >> (neighbours + 8)) & 1;
+			if (alive)
+				result |= uint32_t(1) << (k * tileWidth + c);
+		}
+	return result;
+}
+
+int GOLTiles::Step()
+{
+	int births = 0;
+	for (int ty = 0; ty < tilesY; ty++)
+	{
+		int up = ((ty + tilesY - 1) % tilesY) * tilesX, row = ty * tilesX, down = ((ty + 1) % tilesY) * tilesX;
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			int left = (tx + tilesX - 1) % tilesX, right = (tx + 1) % tilesX;
+			uint32_t ul = tiles[up + left], um = tiles[up + tx], ur = tiles[up + right];
+			uint32_t ml = tiles[row + left], mm = tiles[row + tx], mr = tiles[row + right];
+			uint32_t dl = tiles[down + left], dm = tiles[down + tx], dr = tiles[down + right];
+			if (!(ul | um | ur | ml | mm | mr | dl | dm | dr))
+			{
+				next[row + tx] = 0;
+				continue;
+			}
+			uint64_t neighbourhood = Row(ul, um, ur, tileHeight - 1);
+			for (int k = 0; k < tileHeight; k++)
+				neighbourhood |= Row(ml, mm, mr, k) << ((k + 1) * rowBits);
+			neighbourhood |= Row(dl, dm, dr, 0) << ((tileHeight + 1) * rowBits);
+			uint32_t result;
+			auto it = memo.find(neighbourhood);
+			if (it != memo.end())
+				result = it->second;
+			else
+				memo[neighbourhood] = result = Compute(neighbourhood);
+			next[row + tx] = result;
+			births += Popcount(result & ~mm);
+		}
+	}
+	if (memo.size() > memoLimit)
+		memo.clear();
+	tiles.swap(next);
+	return births;
+}
+
+int GOLTiles::Population() const
+{
+	int population = 0;
+	for (auto tile : tiles)
+		population += Popcount(tile);
+	return population;
+}
@@ -0,0 +1,61 @@
+#ifndef GOLTILES_H
+#define GOLTILES_H
+#include "Config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * The GOL space as tiles of 4x8 cells, one bit per cell, for running a single
+ * two state rule many generations at a time. The next state of a tile only
+ * depends on the 6x10 cells around it, which fit in 60 bits, so results are
+ * memoised by that neighbourhood: tiles that look the same, such as the parts
+ * of a repeating pattern or a still life, are only ever worked out once.
+ * Without B0 an empty neighbourhood stays empty, so only tiles near live cells
+ * are looked at. Simulation::SimulateGoLTiles decides when this may stand in
+ * for SimulateGoL.
+ *
+ * Coordinates are relative to the GOL space, as in GOLBoard.
+ */
+class GOLTiles
+{
+public:
+	static const int width = XRES - 2 * CELL, height = YRES - 2 * CELL;
+	static const int tileWidth = 4, tileHeight = 8;
+	static const int tilesX = width / tileWidth, tilesY = height / tileHeight;
+	static_assert(width % tileWidth == 0 && height % tileHeight == 0, "GOL space must be made of whole tiles");
+	// Results remembered before the memo is thrown away
+	static const size_t memoLimit = 1 << 20;
+
+private:
+	unsigned int ruleset;
+	std::vector<uint32_t> tiles, next;
+	std::unordered_map<uint64_t, uint32_t> memo;
+
+	uint32_t Compute(uint64_t neighbourhood) const;
+
+public:
+	GOLTiles();
+
+	// Empties every tile, forgetting the memo if the rule changed
+	void Clear(unsigned int newRuleset);
+	void Set(int x, int y)
+	{
+		tiles[(y / tileHeight) * tilesX + x / tileWidth] |= uint32_t(1) << ((y % tileHeight) * tileWidth + x % tileWidth);
+	}
+	bool Get(int x, int y) const
+	{
+		return (tiles[(y / tileHeight) * tilesX + x / tileWidth] >> ((y % tileHeight) * tileWidth + x % tileWidth)) & 1;
+	}
+	// Advances one generation, returning how many cells were born
+	int Step();
+	int Population() const;
+	size_t MemoSize() const
+	{
+		return memo.size();
+	}
+};
+
+#endif
@@ -5,12 +5,17 @@
 #include <sys/types.h>
 
 #include "CoordStack.h"
+#include "GravityDelta.h"
+#ifndef GRAVFFT
+# include "GravityFFT.h"
+#endif
 #include "Misc.h"
 #include "Simulation.h"
 #include "SimulationData.h"
 
 
-Gravity::Gravity()
+Gravity::Gravity():
+	deltaLimit(100)
 {
 	// Allocate full size Gravmaps
 	unsigned int size = (XRES / CELL) * (YRES / CELL);
@@ -19,10 +24,22 @@ Gravity::Gravity()
 	th_gravy = new float[size];
 	th_gravx = new float[size];
 	th_gravp = new float[size];
-	gravmap = new float[size];
-	gravy = new float[size];
-	gravx = new float[size];
-	gravp = new float[size];
+	for (int i = 0; i < 3; i++)
+	{
+		inputMaps[i] = new float[size];
+		inputMasks[i] = new unsigned[size];
+		outputX[i] = new float[size];
+		outputY[i] = new float[size];
+		outputP[i] = new float[size];
+		std::fill(&inputMaps[i][0], &inputMaps[i][size], 0.0f);
+		std::fill(&outputX[i][0], &outputX[i][size], 0.0f);
+		std::fill(&outputY[i][0], &outputY[i][size], 0.0f);
+		std::fill(&outputP[i][0], &outputP[i][size], 0.0f);
+	}
+	gravmap = inputMaps[inputs.Back()];
+	gravx = outputX[outputs.Front()];
+	gravy = outputY[outputs.Front()];
+	gravp = outputP[outputs.Front()];
 	gravmask = new unsigned[size];
 }
 
@@ -38,10 +55,14 @@ Gravity::~Gravity()
 	delete[] th_gravy;
 	delete[] th_gravx;
 	delete[] th_gravp;
-	delete[] gravmap;
-	delete[] gravy;
-	delete[] gravx;
-	delete[] gravp;
+	for (int i = 0; i < 3; i++)
+	{
+		delete[] inputMaps[i];
+		delete[] inputMasks[i];
+		delete[] outputX[i];
+		delete[] outputY[i];
+		delete[] outputP[i];
+	}
 	delete[] gravmask;
 }
 
@@ -53,6 +74,7 @@ void Gravity::Clear()
 	std::fill(gravp, gravp + size, 0.0f);
 	std::fill(gravmap, gravmap + size, 0.0f);
 	std::fill(gravmask, gravmask + size, 0xFFFFFFFF);
+	publish_mask();
 
 	ignoreNextResult = true;
 }
@@ -137,85 +159,82 @@ void Gravity::grav_fft_cleanup()
 
 void Gravity::gravity_update_async()
 {
-	int result;
 	if (!enabled)
 		return;
+	unsigned int size = (XRES / CELL) * (YRES / CELL);
 
-	bool signal_grav = false;
-
+	// Hand the masses particles added last frame to the gravity thread. The
+	// thread clears the maps it takes, so the one coming back is only dirty if
+	// the thread skipped it.
+	if (inputs.Publish())
+		std::fill(&inputMaps[inputs.Back()][0], &inputMaps[inputs.Back()][size], 0.0f);
+	gravmap = inputMaps[inputs.Back()];
 	{
-		std::unique_lock<std::mutex> l(gravmutex, std::defer_lock);
-		if (l.try_lock())
-		{
-			result = grav_ready;
-			if (result) //Did the gravity thread finish?
-			{
-				if (th_gravchanged && !ignoreNextResult)
-				{
-#if !defined(GRAVFFT) && defined(GRAV_DIFF)
-					memcpy(gravy, th_gravy, (XRES/CELL)*(YRES/CELL)*sizeof(float));
-					memcpy(gravx, th_gravx, (XRES/CELL)*(YRES/CELL)*sizeof(float));
-					memcpy(gravp, th_gravp, (XRES/CELL)*(YRES/CELL)*sizeof(float));
-#else
-					// Copy thread gravity maps into this one
-					std::swap(gravy, th_gravy);
-					std::swap(gravx, th_gravx);
-					std::swap(gravp, th_gravp);
-#endif
-				}
-				ignoreNextResult = false;
-
-				std::swap(gravmap, th_gravmap);
-
-				grav_ready = 0; //Tell the other thread that we're ready for it to continue
-				signal_grav = true;
-			}
-		}
+		// Only held by the gravity thread while it checks for work, this is here so the notification can't be missed
+		std::lock_guard<std::mutex> g(gravmutex);
 	}
+	gravcv.notify_one();
 
-	if (signal_grav)
+	if (outputs.Take()) //Did the gravity thread finish?
 	{
-		gravcv.notify_one();
+		gravx = outputX[outputs.Front()];
+		gravy = outputY[outputs.Front()];
+		gravp = outputP[outputs.Front()];
+		if (ignoreNextResult)
+		{
+			std::fill(&gravx[0], &gravx[size], 0.0f);
+			std::fill(&gravy[0], &gravy[size], 0.0f);
+			std::fill(&gravp[0], &gravp[size], 0.0f);
+			ignoreNextResult = false;
+		}
 	}
-	unsigned int size = (XRES / CELL) * (YRES / CELL);
-	membwand(gravy, gravmask, size * sizeof(float), size * sizeof(unsigned));
-	membwand(gravx, gravmask, size * sizeof(float), size * sizeof(unsigned));
-	std::fill(&gravmap[0], &gravmap[size], 0.0f);
 }
 
 void Gravity::update_grav_async()
 {
-	int done = 0;
-	int thread_done = 0;
 	unsigned int size = (XRES / CELL) * (YRES / CELL);
 	std::fill(&th_ogravmap[0], &th_ogravmap[size], 0.0f);
 	std::fill(&th_gravmap[0], &th_gravmap[size], 0.0f);
 	std::fill(&th_gravy[0], &th_gravy[size], 0.0f);
 	std::fill(&th_gravx[0], &th_gravx[size], 0.0f);
 	std::fill(&th_gravp[0], &th_gravp[size], 0.0f);
+	th_deltaCells = 0;
 
 #ifdef GRAVFFT
 	if (!grav_fft_status)
 		grav_fft_init();
 #endif
 
-	std::unique_lock<std::mutex> l(gravmutex);
-	while (!thread_done)
+	while (true)
 	{
-		if (!done)
 		{
-			// run gravity update
-			update_grav();
-			done = 1;
-			grav_ready = 1;
-			thread_done = gravthread_done;
+			// wait for main thread
+			std::unique_lock<std::mutex> l(gravmutex);
+			gravcv.wait(l, [this]() { return gravthread_done || inputs.Fresh(); });
+			if (gravthread_done)
+				break;
 		}
-		else
+		inputs.Take();
+		float *input = inputMaps[inputs.Front()];
+		std::copy(&input[0], &input[size], th_gravmap);
+		std::fill(&input[0], &input[size], 0.0f);
+		bool maskChanged = masks.Take();
+		th_gravmask = inputMasks[masks.Front()];
+
+		// run gravity update
+		update_grav();
+
+		if (th_gravchanged || maskChanged)
 		{
-			// wait for main thread
-			gravcv.wait(l);
-			done = grav_ready;
-			thread_done = gravthread_done;
+			// Walls of gravity wall cut off the gravity inside them from the outside
+			int out = outputs.Back();
+			for (unsigned int i = 0; i < size; i++)
+			{
+				outputX[out][i] = th_gravmask[i] ? th_gravx[i] : 0.0f;
+				outputY[out][i] = th_gravmask[i] ? th_gravy[i] : 0.0f;
+				outputP[out][i] = th_gravp[i];
+			}
+			outputs.Publish();
 		}
 	}
 }
@@ -225,16 +244,25 @@ void Gravity::start_grav_async()
 	if (enabled)	//If it's already enabled, restart it
 		stop_grav_async();
 
-	gravthread_done = 0;
-	grav_ready = 0;
-	gravthread = std::thread([this]() { update_grav_async(); }); //Start asynchronous gravity simulation
-	enabled = true;
-
 	unsigned int size = (XRES / CELL) * (YRES / CELL);
+	inputs.Reset();
+	outputs.Reset();
+	masks.Reset();
+	for (int i = 0; i < 3; i++)
+		std::fill(&inputMaps[i][0], &inputMaps[i][size], 0.0f);
+	publish_mask();
+	gravmap = inputMaps[inputs.Back()];
+	gravx = outputX[outputs.Front()];
+	gravy = outputY[outputs.Front()];
+	gravp = outputP[outputs.Front()];
 	std::fill(&gravy[0], &gravy[size], 0.0f);
 	std::fill(&gravx[0], &gravx[size], 0.0f);
 	std::fill(&gravp[0], &gravp[size], 0.0f);
-	std::fill(&gravmap[0], &gravmap[size], 0.0f);
+
+	gravthread_done = false;
+	ignoreNextResult = false;
+	gravthread = std::thread([this]() { update_grav_async(); }); //Start asynchronous gravity simulation
+	enabled = true;
 }
 
 void Gravity::stop_grav_async()
@@ -243,7 +271,7 @@ void Gravity::stop_grav_async()
 	{
 		{
 			std::lock_guard<std::mutex> g(gravmutex);
-			gravthread_done = 1;
+			gravthread_done = true;
 		}
 		gravcv.notify_one();
 		gravthread.join();
@@ -257,58 +285,55 @@ void Gravity::stop_grav_async()
 	std::fill(&gravmap[0], &gravmap[size], 0.0f);
 }
 
-#ifdef GRAVFFT
+// Passes gravmask on to the gravity thread, it picks it up the next time it runs
+void Gravity::publish_mask()
+{
+	unsigned int size = (XRES / CELL) * (YRES / CELL);
+	std::copy(&gravmask[0], &gravmask[size], inputMasks[masks.Back()]);
+	masks.Publish();
+}
+
 void Gravity::update_grav()
 {
-	int xblock2 = XRES/CELL*2, yblock2 = YRES/CELL*2;
-	int fft_tsize = (xblock2/2+1)*yblock2;
-	float mr, mc, pr, pc, gr, gc;
-	if (memcmp(th_ogravmap, th_gravmap, sizeof(float)*(XRES/CELL)*(YRES/CELL)) != 0)
+	int size = (XRES/CELL)*(YRES/CELL);
+	membwand(th_gravmap, th_gravmask, size*sizeof(float), size*sizeof(unsigned));
+
+	// Collect the changed cells, stopping once there are too many to apply one by one.
+	// Rounding errors pile up with every change applied, so after a map's worth
+	// of changes the whole field is redone anyway.
+	int limit = std::min(int(deltaLimit), size - th_deltaCells);
+	bool full = false;
+	th_changed.clear();
+	for (int i = 0; i < size; i++)
 	{
-		th_gravchanged = 1;
-
-		membwand(th_gravmap, gravmask, (XRES/CELL)*(YRES/CELL)*sizeof(float), (XRES/CELL)*(YRES/CELL)*sizeof(unsigned));
-		//copy gravmap into padded gravmap array
-		for (int y = 0; y < YRES / CELL; y++)
+		if (th_gravmap[i] != th_ogravmap[i])
 		{
-			for (int x = 0; x < XRES / CELL; x++)
+			if (int(th_changed.size()) >= limit)
 			{
-				th_gravmapbig[(y+YRES/CELL)*xblock2+XRES/CELL+x] = th_gravmap[y*(XRES/CELL)+x];
-			}
-		}
-		//transform gravmap
-		fftwf_execute(plan_gravmap);
-		//do convolution (multiply the complex numbers)
-		for (int i = 0; i < fft_tsize; i++)
-		{
-			mr = th_gravmapbigt[i][0];
-			mc = th_gravmapbigt[i][1];
-			pr = th_ptgravxt[i][0];
-			pc = th_ptgravxt[i][1];
-			gr = mr*pr-mc*pc;
-			gc = mr*pc+mc*pr;
-			th_gravxbigt[i][0] = gr;
-			th_gravxbigt[i][1] = gc;
-			pr = th_ptgravyt[i][0];
-			pc = th_ptgravyt[i][1];
-			gr = mr*pr-mc*pc;
-			gc = mr*pc+mc*pr;
-			th_gravybigt[i][0] = gr;
-			th_gravybigt[i][1] = gc;
-		}
-		//inverse transform, and copy from padded arrays into normal velocity maps
-		fftwf_execute(plan_gravx_inverse);
-		fftwf_execute(plan_gravy_inverse);
-		for (int y = 0; y < YRES / CELL; y++)
-		{
-			for (int x = 0; x < XRES / CELL; x++)
-			{
-				th_gravx[y*(XRES/CELL)+x] = th_gravxbig[y*xblock2+x];
-				th_gravy[y*(XRES/CELL)+x] = th_gravybig[y*xblock2+x];
-				th_gravp[y*(XRES/CELL)+x] = sqrtf(pow(th_gravxbig[y*xblock2+x],2)+pow(th_gravybig[y*xblock2+x],2));
+				full = true;
+				break;
 			}
+			th_changed.push_back(i);
 		}
 	}
+
+	if (full)
+	{
+		th_gravchanged = 1;
+		solve_grav();
+		th_deltaCells = 0;
+	}
+	else if (th_changed.size())
+	{
+		th_gravchanged = 1;
+		if (!th_delta)
+			th_delta.reset(new GravityDelta());
+		for (int i : th_changed)
+			th_delta->Add(i, th_gravmap[i] - th_ogravmap[i], th_gravx, th_gravy);
+		for (int i = 0; i < size; i++)
+			th_gravp[i] = sqrtf(th_gravx[i]*th_gravx[i] + th_gravy[i]*th_gravy[i]);
+		th_deltaCells += th_changed.size();
+	}
 	else
 	{
 		th_gravchanged = 0;
@@ -318,63 +343,62 @@ void Gravity::update_grav()
 	std::swap(th_gravmap, th_ogravmap);
 }
 
-#else
-// gravity without fast Fourier transforms
-
-void Gravity::update_grav(void)
+#ifdef GRAVFFT
+void Gravity::solve_grav()
 {
-	int x, y, i, j;
-	float val, distance;
-	th_gravchanged = 0;
-#ifndef GRAV_DIFF
-	//Find any changed cells
-	for (i=0; i<YRES/CELL; i++)
+	int xblock2 = XRES/CELL*2, yblock2 = YRES/CELL*2;
+	int fft_tsize = (xblock2/2+1)*yblock2;
+	float mr, mc, pr, pc, gr, gc;
+	//copy gravmap into padded gravmap array
+	for (int y = 0; y < YRES / CELL; y++)
 	{
-		if(changed)
-			break;
-		for (j=0; j<XRES/CELL; j++)
+		for (int x = 0; x < XRES / CELL; x++)
 		{
-			if(th_ogravmap[i*(XRES/CELL)+j]!=th_gravmap[i*(XRES/CELL)+j]){
-				changed = 1;
-				break;
-			}
+			th_gravmapbig[(y+YRES/CELL)*xblock2+XRES/CELL+x] = th_gravmap[y*(XRES/CELL)+x];
 		}
 	}
-	if(!changed)
-		goto fin;
-	memset(th_gravy, 0, (XRES/CELL)*(YRES/CELL)*sizeof(float));
-	memset(th_gravx, 0, (XRES/CELL)*(YRES/CELL)*sizeof(float));
-#endif
-	th_gravchanged = 1;
-	membwand(th_gravmap, gravmask, (XRES/CELL)*(YRES/CELL)*sizeof(float), (XRES/CELL)*(YRES/CELL)*sizeof(unsigned));
-	for (i = 0; i < YRES / CELL; i++) {
-		for (j = 0; j < XRES / CELL; j++) {
-#ifdef GRAV_DIFF
-			if (th_ogravmap[i*(XRES/CELL)+j] != th_gravmap[i*(XRES/CELL)+j])
-			{
-#else
-			if (th_gravmap[i*(XRES/CELL)+j] > 0.0001f || th_gravmap[i*(XRES/CELL)+j]<-0.0001f) //Only calculate with populated or changed cells.
-			{
-#endif
-				for (y = 0; y < YRES / CELL; y++) {
-					for (x = 0; x < XRES / CELL; x++) {
-						if (x == j && y == i)//Ensure it doesn't calculate with itself
-							continue;
-						distance = sqrt(pow(j - x, 2.0f) + pow(i - y, 2.0f));
-#ifdef GRAV_DIFF
-						val = th_gravmap[i*(XRES/CELL)+j] - th_ogravmap[i*(XRES/CELL)+j];
-#else
-						val = th_gravmap[i*(XRES/CELL)+j];
-#endif
-						th_gravx[y*(XRES/CELL)+x] += M_GRAV * val * (j - x) / pow(distance, 3.0f);
-						th_gravy[y*(XRES/CELL)+x] += M_GRAV * val * (i - y) / pow(distance, 3.0f);
-						th_gravp[y*(XRES/CELL)+x] += M_GRAV * val / pow(distance, 2.0f);
-					}
-				}
-			}
+	//transform gravmap
+	fftwf_execute(plan_gravmap);
+	//do convolution (multiply the complex numbers)
+	for (int i = 0; i < fft_tsize; i++)
+	{
+		mr = th_gravmapbigt[i][0];
+		mc = th_gravmapbigt[i][1];
+		pr = th_ptgravxt[i][0];
+		pc = th_ptgravxt[i][1];
+		gr = mr*pr-mc*pc;
+		gc = mr*pc+mc*pr;
+		th_gravxbigt[i][0] = gr;
+		th_gravxbigt[i][1] = gc;
+		pr = th_ptgravyt[i][0];
+		pc = th_ptgravyt[i][1];
+		gr = mr*pr-mc*pc;
+		gc = mr*pc+mc*pr;
+		th_gravybigt[i][0] = gr;
+		th_gravybigt[i][1] = gc;
+	}
+	//inverse transform, and copy from padded arrays into normal velocity maps
+	fftwf_execute(plan_gravx_inverse);
+	fftwf_execute(plan_gravy_inverse);
+	for (int y = 0; y < YRES / CELL; y++)
+	{
+		for (int x = 0; x < XRES / CELL; x++)
+		{
+			th_gravx[y*(XRES/CELL)+x] = th_gravxbig[y*xblock2+x];
+			th_gravy[y*(XRES/CELL)+x] = th_gravybig[y*xblock2+x];
+			th_gravp[y*(XRES/CELL)+x] = sqrtf(pow(th_gravxbig[y*xblock2+x],2)+pow(th_gravybig[y*xblock2+x],2));
 		}
 	}
-	memcpy(th_ogravmap, th_gravmap, (XRES/CELL)*(YRES/CELL)*sizeof(float));
+}
+
+#else
+// gravity with the built in FFT, see GravityFFT
+
+void Gravity::solve_grav()
+{
+	if (!th_solver)
+		th_solver.reset(new GravityFFT());
+	th_solver->Solve(th_gravmap, th_gravx, th_gravy, th_gravp);
 }
 #endif
 
@@ -523,4 +547,5 @@ void Gravity::gravity_mask()
 		c_mask_el = c_mask_el->next;
 	}
 	mask_free(t_mask_el);
+	publish_mask();
 }
@@ -2,14 +2,22 @@
 #define GRAVITY_H
 #include "Config.h"
 
+#include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 
+#include "common/TripleBuffer.h"
+
 #ifdef GRAVFFT
 #include <fftw3.h>
+#else
+class GravityFFT;
 #endif
 
+class GravityDelta;
 class Simulation;
 
 class Gravity
@@ -25,13 +33,36 @@ private:
 	float *th_gravy = nullptr;
 	float *th_gravp = nullptr;
 
+	// The gravity thread's copy of gravmask
+	unsigned *th_gravmask = nullptr;
+
 	int th_gravchanged = 0;
 
+	// Cells that changed this update, and how many were applied on their own since the field was last worked out in full
+	std::vector<int> th_changed;
+	int th_deltaCells = 0;
+	std::unique_ptr<GravityDelta> th_delta;
+
+	// Buffers passed between the main thread and the gravity thread, three of
+	// each, see TripleBuffer. The main thread writes masses into gravmap, which
+	// is one of inputMaps, and reads results out of gravx, gravy and gravp, which
+	// are one of each of outputX, outputY and outputP. New masks are passed on
+	// through inputMasks.
+	float *inputMaps[3];
+	unsigned *inputMasks[3];
+	float *outputX[3];
+	float *outputY[3];
+	float *outputP[3];
+	TripleBuffer inputs;
+	TripleBuffer masks;
+	TripleBuffer outputs;
+
 	std::thread gravthread;
+	// Only used by the gravity thread to sleep while there is nothing new to
+	// work on; the main thread never waits for it
 	std::mutex gravmutex;
 	std::condition_variable gravcv;
-	int grav_ready = 0;
-	int gravthread_done = 0;
+	bool gravthread_done = false;
 	bool ignoreNextResult = false;
 
 #ifdef GRAVFFT
@@ -44,6 +75,8 @@ private:
 
 	fftwf_complex *th_ptgravxt, *th_ptgravyt, *th_gravmapbigt, *th_gravxbigt, *th_gravybigt;
 	fftwf_plan plan_gravmap, plan_gravx_inverse, plan_gravy_inverse;
+#else
+	std::unique_ptr<GravityFFT> th_solver;
 #endif
 
 	struct mask_el {
@@ -57,7 +90,10 @@ private:
 	void mask_free(mask_el *c_mask_el);
 
 	void update_grav();
+	// Works out the whole field of th_gravmap
+	void solve_grav();
 	void update_grav_async();
+	void publish_mask();
 
 
 #ifdef GRAVFFT
@@ -75,6 +111,11 @@ public:
 
 	unsigned char (*bmap)[XRES/CELL];
 
+	// Updates where at most this many cells of gravmap changed only add on the
+	// field of those cells, see GravityDelta; bigger ones redo the whole field.
+	// 0 always redoes the whole field.
+	std::atomic<int> deltaLimit;
+
 	bool IsEnabled() { return enabled; }
 
 	void Clear();
@@ -0,0 +1,50 @@
+#include "GravityDelta.h"
+
+#include <cmath>
+
+#include "VectorFloat.h"
+
+namespace
+{
+	const int width = XRES/CELL, height = YRES/CELL;
+	const int kernelWidth = 2 * width - 1, kernelHeight = 2 * height - 1;
+
+	inline void AddRow(float *to, float const *from, float mass)
+	{
+		const int w = VectorFloat::Width;
+		int x = 0;
+		for (int end = width / w * w; x < end; x += w)
+			(VectorFloat::Load(to + x) + VectorFloat::Load(from + x) * mass).Store(to + x);
+		for (; x < width; x++)
+			to[x] += from[x] * mass;
+	}
+}
+
+GravityDelta::GravityDelta():
+	pointX(kernelWidth * kernelHeight),
+	pointY(kernelWidth * kernelHeight)
+{
+	// Same as the full solvers: a mass pulls cells towards itself
+	for (int dy = 1 - height; dy < height; dy++)
+		for (int dx = 1 - width; dx < width; dx++)
+		{
+			if (!dx && !dy)
+				continue;
+			float distance = std::sqrt(float(dx * dx + dy * dy));
+			int i = (dy + height - 1) * kernelWidth + dx + width - 1;
+			pointX[i] = -M_GRAV * dx / (distance * distance * distance);
+			pointY[i] = -M_GRAV * dy / (distance * distance * distance);
+		}
+}
+
+void GravityDelta::Add(int cell, float mass, float *gravx, float *gravy) const
+{
+	int cx = cell % width, cy = cell / width;
+	for (int y = 0; y < height; y++)
+	{
+		// Offset of cell (0, y) from the mass
+		int row = (y - cy + height - 1) * kernelWidth + width - 1 - cx;
+		AddRow(gravx + y * width, &pointX[row], mass);
+		AddRow(gravy + y * width, &pointY[row], mass);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef GRAVITYDELTA_H
+#define GRAVITYDELTA_H
+#include "Config.h"
+
+#include <vector>
+
+/*
+ * Updates a gravity field for a few changed cells without redoing the whole
+ * field: the field of a point mass at every offset is worked out once, and each
+ * change adds a scaled copy of it, centred on the cell, onto the field. This
+ * costs one pass over the map per changed cell, so it only wins over a full
+ * solve while few cells change. See Gravity::deltaLimit.
+ */
+class GravityDelta
+{
+	// Field of a unit mass at offsets -(XRES/CELL-1)..(XRES/CELL-1), -(YRES/CELL-1)..(YRES/CELL-1)
+	std::vector<float> pointX, pointY;
+
+public:
+	GravityDelta();
+
+	// Adds the field of mass placed in cell, an index into the map, onto gravx and gravy
+	void Add(int cell, float mass, float *gravx, float *gravy) const;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "GravityFFT.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "VectorFloat.h"
+
+namespace
+{
+	// Copies the first rows rows of the rows x columns grid from into to, transposed
+	void Transpose(float const *from, float *to, int rows, int columns, int fromStride, int toStride)
+	{
+		const int block = 16;
+		for (int r0 = 0; r0 < rows; r0 += block)
+			for (int c0 = 0; c0 < columns; c0 += block)
+			{
+				int r1 = std::min(r0 + block, rows), c1 = std::min(c0 + block, columns);
+				for (int r = r0; r < r1; r++)
+					for (int c = c0; c < c1; c++)
+						to[c * toStride + r] = from[r * fromStride + c];
+			}
+	}
+}
+
+GravityFFT::GravityFFT():
+	sizeX(FFT::GoodSize(2 * (XRES/CELL) - 1)),
+	sizeY(FFT::GoodSize(2 * (YRES/CELL) - 1)),
+	widthX(((XRES/CELL) + VectorFloat::Width - 1) / VectorFloat::Width * VectorFloat::Width),
+	fftX(sizeX),
+	fftY(sizeY),
+	re(sizeX * sizeY),
+	im(sizeX * sizeY),
+	reT(sizeX * sizeY),
+	imT(sizeX * sizeY)
+{
+	// Field at each offset from a point mass, x in re and y in im, with negative
+	// offsets wrapped around to the end. The scale undoes the unscaled inverse.
+	float scale = M_GRAV / (float(sizeX) * sizeY);
+	auto offset = [](int i, int size, int limit) {
+		return i < limit ? i : (i > size - limit ? i - size : 0);
+	};
+	for (int y = 0; y < sizeY; y++)
+		for (int x = 0; x < sizeX; x++)
+		{
+			int dx = offset(x, sizeX, XRES/CELL), dy = offset(y, sizeY, YRES/CELL);
+			if ((!dx && x) || (!dy && y) || (!dx && !dy))
+				continue;
+			float distance = std::sqrt(float(dx * dx + dy * dy));
+			re[y * sizeX + x] = -scale * dx / (distance * distance * distance);
+			im[y * sizeX + x] = -scale * dy / (distance * distance * distance);
+		}
+	fftY.Transform(re.data(), im.data(), sizeX, sizeX, false);
+	Transpose(re.data(), reT.data(), sizeY, sizeX, sizeX, sizeY);
+	Transpose(im.data(), imT.data(), sizeY, sizeX, sizeX, sizeY);
+	fftX.Transform(reT.data(), imT.data(), sizeY, sizeY, false);
+	kernelRe = reT;
+	kernelIm = imT;
+}
+
+void GravityFFT::Forward(float const *mass)
+{
+	std::fill(re.begin(), re.end(), 0.0f);
+	std::fill(im.begin(), im.end(), 0.0f);
+	for (int y = 0; y < YRES/CELL; y++)
+		std::copy(mass + y * (XRES/CELL), mass + (y + 1) * (XRES/CELL), &re[y * sizeX]);
+	// Only the first widthX columns hold anything, so only those need transforming
+	fftY.Transform(re.data(), im.data(), sizeX, widthX, false);
+	Transpose(re.data(), reT.data(), sizeY, widthX, sizeX, sizeY);
+	Transpose(im.data(), imT.data(), sizeY, widthX, sizeX, sizeY);
+	std::fill(reT.begin() + widthX * sizeY, reT.end(), 0.0f);
+	std::fill(imT.begin() + widthX * sizeY, imT.end(), 0.0f);
+	fftX.Transform(reT.data(), imT.data(), sizeY, sizeY, false);
+}
+
+void GravityFFT::Inverse()
+{
+	fftX.Transform(reT.data(), imT.data(), sizeY, sizeY, true);
+	// Only the first widthX columns of the result are needed
+	Transpose(reT.data(), re.data(), widthX, sizeY, sizeY, sizeX);
+	Transpose(imT.data(), im.data(), widthX, sizeY, sizeY, sizeX);
+	fftY.Transform(re.data(), im.data(), sizeX, widthX, true);
+}
+
+void GravityFFT::Solve(float const *gravmap, float *gravx, float *gravy, float *gravp)
+{
+	Forward(gravmap);
+	const int w = VectorFloat::Width;
+	int n = sizeX * sizeY;
+	for (int i = 0; i < n; i += w)
+	{
+		VectorFloat mr = VectorFloat::Load(&reT[i]), mi = VectorFloat::Load(&imT[i]);
+		VectorFloat kr = VectorFloat::Load(&kernelRe[i]), ki = VectorFloat::Load(&kernelIm[i]);
+		(mr * kr - mi * ki).Store(&reT[i]);
+		(mr * ki + mi * kr).Store(&imT[i]);
+	}
+	Inverse();
+	for (int y = 0; y < YRES/CELL; y++)
+		for (int x = 0; x < XRES/CELL; x++)
+		{
+			float gx = re[y * sizeX + x], gy = im[y * sizeX + x];
+			gravx[y * (XRES/CELL) + x] = gx;
+			gravy[y * (XRES/CELL) + x] = gy;
+			gravp[y * (XRES/CELL) + x] = std::sqrt(gx * gx + gy * gy);
+		}
+}
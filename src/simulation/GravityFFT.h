@@ -0,0 +1,40 @@
+#ifndef GRAVITYFFT_H
+#define GRAVITYFFT_H
+#include "Config.h"
+
+#include <vector>
+
+#include "FFT.h"
+
+/*
+ * Newtonian gravity of a whole mass map by convolution with the field of a
+ * point mass, using the built in FFT. This is what Gravity uses when the game
+ * is built without FFTW. Masses are placed in a grid padded to at least twice
+ * the size of the map so the convolution doesn't wrap around. The x and y
+ * fields are real, so both are worked out in one complex convolution, x in the
+ * real part and y in the imaginary part.
+ */
+class GravityFFT
+{
+	int sizeX, sizeY;
+	// Columns actually carried through the first pass, the map width rounded up to whole vectors
+	int widthX;
+	FFT fftX, fftY;
+	// Grids of sizeY rows of sizeX
+	std::vector<float> re, im;
+	// The same, transposed, for transforming along x
+	std::vector<float> reT, imT;
+	// Spectrum of the point mass field, transposed
+	std::vector<float> kernelRe, kernelIm;
+
+	void Forward(float const *mass);
+	void Inverse();
+
+public:
+	GravityFFT();
+
+	// Fills gravx, gravy and gravp, (XRES/CELL)*(YRES/CELL) each, with the field of gravmap
+	void Solve(float const *gravmap, float *gravx, float *gravy, float *gravp);
+};
+
+#endif
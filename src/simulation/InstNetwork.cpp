@@ -0,0 +1,170 @@
+#include "InstNetwork.h"
+
+#include <algorithm>
+
+#include "ElementClasses.h"
+#include "Particle.h"
+
+InstNetwork::InstNetwork():
+	runAt(XRES * YRES, -1),
+	valid(false),
+	stamp(0)
+{
+}
+
+// Calls push(y * XRES + x) for every cell that conducts and that FloodINST would push
+// after sparking the span x1..x2 of row y, if that cell is idle, in the order it would
+template<class F>
+void InstNetwork::SpanPushes(int y, int x1, int x2, F push) const
+{
+	// Travelling vertically up, skipping a horizontal line
+	if (y >= CELL + 1 && x1 == x2 &&
+		Conducts(x1 - 1, y - 1) && Conducts(x1, y - 1) && Conducts(x1 + 1, y - 1) &&
+		!Conducts(x1 - 1, y - 2) && Conducts(x1, y - 2) && !Conducts(x1 + 1, y - 2))
+	{
+		push((y - 2) * XRES + x1);
+	}
+	else if (y >= CELL + 1)
+	{
+		for (int x = x1; x <= x2; x++)
+		{
+			// If at the end of a horizontal section, or if it's a T junction or not a 1px wire crossing
+			if (Conducts(x, y - 1) &&
+				(x == x1 || x == x2 || y >= YRES - CELL - 1 || !Conducts(x, y + 1) || Conducts(x + 1, y + 1) || Conducts(x - 1, y + 1)))
+				push((y - 1) * XRES + x);
+		}
+	}
+
+	// Travelling vertically down, skipping a horizontal line
+	if (y < YRES - CELL - 1 && x1 == x2 &&
+		Conducts(x1 - 1, y + 1) && Conducts(x1, y + 1) && Conducts(x1 + 1, y + 1) &&
+		!Conducts(x1 - 1, y + 2) && Conducts(x1, y + 2) && !Conducts(x1 + 1, y + 2))
+	{
+		push((y + 2) * XRES + x1);
+	}
+	else if (y < YRES - CELL - 1)
+	{
+		for (int x = x1; x <= x2; x++)
+		{
+			if (Conducts(x, y + 1) &&
+				(x == x1 || x == x2 || y < 0 || !Conducts(x, y - 1) || Conducts(x + 1, y - 1) || Conducts(x - 1, y - 1)))
+				push((y + 1) * XRES + x);
+		}
+	}
+}
+
+void InstNetwork::Update(int const (*pmap)[XRES], Particle const *parts)
+{
+	for (int y = 0; y < YRES; y++)
+		for (int x = 0; x < XRES; x++)
+		{
+			int r = pmap[y][x];
+			bool conducts = TYP(r) == PT_INST || (TYP(r) == PT_SPRK && parts[ID(r)].ctype == PT_INST);
+			runAt[y * XRES + x] = conducts ? 0 : -1;
+		}
+
+	runs.clear();
+	for (int y = 0; y < YRES; y++)
+		for (int x = 0; x < XRES; x++)
+		{
+			if (runAt[y * XRES + x] < 0)
+				continue;
+			Run run = { y, x, x, 0, 0 };
+			while (run.x2 + 1 < XRES && runAt[y * XRES + run.x2 + 1] >= 0)
+				run.x2++;
+			for (; x <= run.x2; x++)
+				runAt[y * XRES + x] = int(runs.size());
+			runs.push_back(run);
+		}
+
+	pushes.clear();
+	for (auto &run : runs)
+	{
+		run.pushStart = int(pushes.size());
+		// FloodINST never makes spans reaching past these, Flood leaves such runs to it
+		if (run.x1 >= CELL - 1 && run.x2 <= XRES - CELL)
+			SpanPushes(run.y, run.x1, run.x2, [this](int cell) {
+				pushes.push_back(cell);
+			});
+		run.pushEnd = int(pushes.size());
+	}
+
+	visited.assign(runs.size(), 0);
+	stamp = 0;
+	valid = true;
+}
+
+bool InstNetwork::Flood(int const (*pmap)[XRES], Particle const *parts, int x, int y)
+{
+	if (!valid)
+		Update(pmap, parts);
+	if (!++stamp)
+	{
+		std::fill(visited.begin(), visited.end(), 0);
+		stamp = 1;
+	}
+	sparked.clear();
+
+	// Runs are sparked as a whole, so a cell is idle until its run is visited
+	auto idle = [this, pmap, parts](int cell) {
+		int r = (&pmap[0][0])[cell];
+		return visited[runAt[cell]] != stamp && TYP(r) == PT_INST && !parts[ID(r)].life;
+	};
+	auto push = [this, &idle](int cell) {
+		if (idle(cell))
+			stack.push_back(cell);
+	};
+
+	stack.clear();
+	stack.push_back(y * XRES + x);
+	while (stack.size())
+	{
+		int cell = stack.back();
+		stack.pop_back();
+		int run = runAt[cell];
+		if (run < 0)
+		{
+			// INST that appeared without the runs being updated
+			valid = false;
+			return false;
+		}
+		if (visited[run] == stamp)
+		{
+			// Already sparked, which FloodINST treats as a span of just this cell. That only
+			// pushes cells up to two rows away in runs not visited yet, which there seldom are.
+			auto unvisited = [this](int cell) {
+				return runAt[cell] >= 0 && visited[runAt[cell]] != stamp;
+			};
+			if (unvisited(cell - XRES) || unvisited(cell + XRES) || unvisited(cell - 2 * XRES) || unvisited(cell + 2 * XRES))
+				SpanPushes(cell / XRES, cell % XRES, cell % XRES, push);
+			continue;
+		}
+
+		auto &span = runs[run];
+		if (span.x1 < CELL - 1 || span.x2 > XRES - CELL)
+			return false;
+		int const *row = pmap[span.y];
+		for (int xx = span.x1; xx <= span.x2; xx++)
+		{
+			int r = row[xx];
+			if (TYP(r) != PT_INST || parts[ID(r)].life)
+			{
+				if (TYP(r) != PT_INST && !(TYP(r) == PT_SPRK && parts[ID(r)].ctype == PT_INST))
+					valid = false;
+				return false;
+			}
+		}
+		// INST next to the run that the runs don't know about
+		if ((span.x1 > 0 && TYP(row[span.x1 - 1]) == PT_INST) || (span.x2 < XRES - 1 && TYP(row[span.x2 + 1]) == PT_INST))
+		{
+			valid = false;
+			return false;
+		}
+
+		visited[run] = stamp;
+		sparked.push_back(span);
+		for (int k = span.pushStart; k < span.pushEnd; k++)
+			push(pushes[k]);
+	}
+	return true;
+}
@@ -0,0 +1,73 @@
+#ifndef INSTNETWORK_H
+#define INSTNETWORK_H
+#include "Config.h"
+
+#include <atomic>
+#include <vector>
+
+struct Particle;
+
+/*
+ * INST laid out as runs: maximal horizontal lines of cells that conduct for
+ * INST, which are INST itself and SPRK on INST. Sparking and recharging don't
+ * change which cells those are, so the runs stay valid until INST is created,
+ * destroyed or moved. Each run remembers the cells FloodINST would push for it,
+ * from the same wire crossing rules, so that a flood becomes a walk over runs.
+ *
+ * Flood only handles networks whose every run it reaches is idle, meaning all
+ * INST with life 0; then the spans FloodINST finds are exactly the runs. It
+ * walks them in the same order FloodINST does, including the odd extra pushes
+ * made from cells that were already sparked, so the same cells end up sparked.
+ */
+class InstNetwork
+{
+public:
+	struct Run
+	{
+		int y, x1, x2;
+		// Cells, as y * XRES + x, that FloodINST pushes after sparking this run
+		// if they are still idle then
+		int pushStart, pushEnd;
+	};
+
+private:
+	// Run of every cell, or -1 if it doesn't conduct
+	std::vector<int> runAt;
+	std::vector<Run> runs;
+	std::vector<int> pushes;
+	std::atomic<bool> valid;
+
+	// Flood state, runs visited in the current flood are stamped with it
+	std::vector<unsigned int> visited;
+	unsigned int stamp;
+	std::vector<int> stack;
+	std::vector<Run> sparked;
+
+	bool Conducts(int x, int y) const
+	{
+		return runAt[y * XRES + x] >= 0;
+	}
+	template<class F>
+	void SpanPushes(int y, int x1, int x2, F push) const;
+
+public:
+	InstNetwork();
+
+	// Called whenever a cell may have started or stopped conducting for INST
+	void Invalidate()
+	{
+		valid = false;
+	}
+	void Update(int const (*pmap)[XRES], Particle const *parts);
+
+	// Works out the runs FloodINST(x, y) would spark, or returns false if it
+	// reaches one that isn't idle, leaving FloodINST to search cell by cell.
+	// x, y must be idle INST.
+	bool Flood(int const (*pmap)[XRES], Particle const *parts, int x, int y);
+	std::vector<Run> const &Sparked() const
+	{
+		return sparked;
+	}
+};
+
+#endif
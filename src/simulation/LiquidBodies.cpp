@@ -0,0 +1,92 @@
+#include "LiquidBodies.h"
+
+#include <algorithm>
+
+#include "Element.h"
+
+LiquidBodies::LiquidBodies():
+	label(XRES * YRES, -1),
+	valid(false)
+{
+}
+
+int LiquidBodies::Find(int i)
+{
+	while (label[i] != i)
+	{
+		label[i] = label[label[i]];
+		i = label[i];
+	}
+	return i;
+}
+
+void LiquidBodies::Update(int const (*pmap)[XRES], std::array<Element, PT_NUM> const &elements)
+{
+	auto liquid = [&pmap, &elements](int x, int y) {
+		return elements[TYP(pmap[y][x])].Falldown == 2;
+	};
+
+	// Join every liquid cell with the ones to its left and above it, always
+	// keeping the lower index as the root so that labels don't depend on order
+	for (int y = 0; y < YRES; y++)
+		for (int x = 0; x < XRES; x++)
+		{
+			int i = y * XRES + x;
+			if (!liquid(x, y))
+			{
+				label[i] = -1;
+				continue;
+			}
+			label[i] = i;
+			if (x > 0 && label[i - 1] >= 0)
+				label[i] = Find(i - 1);
+			if (y > 0 && label[i - XRES] >= 0)
+			{
+				int a = label[i], b = Find(i - XRES);
+				if (a < b)
+					label[b] = a;
+				else
+					label[a] = label[i] = b;
+			}
+		}
+
+	// Point every cell straight at its root, then number the bodies in the
+	// order of their roots. A root comes before every other cell of its body,
+	// so it has its number by the time they look it up.
+	for (int i = 0; i < XRES * YRES; i++)
+		if (label[i] >= 0)
+			label[i] = Find(i);
+	int bodies = 0;
+	for (int i = 0; i < XRES * YRES; i++)
+		if (label[i] >= 0)
+			label[i] = label[i] == i ? bodies++ : label[label[i]];
+
+	surfaceRow.assign(bodies, -1);
+	surfaceStart.assign(bodies + 1, 0);
+	for (int y = CELL; y < YRES - CELL; y++)
+		for (int x = CELL; x < XRES - CELL; x++)
+		{
+			int body = label[(y + 1) * XRES + x];
+			if (body >= 0 && !pmap[y][x])
+				surfaceRow[body] = y;
+		}
+	for (int y = CELL; y < YRES - CELL; y++)
+		for (int x = CELL; x < XRES - CELL; x++)
+		{
+			int body = label[(y + 1) * XRES + x];
+			if (body >= 0 && !pmap[y][x] && surfaceRow[body] == y)
+				surfaceStart[body + 1]++;
+		}
+	for (int body = 0; body < bodies; body++)
+		surfaceStart[body + 1] += surfaceStart[body];
+	surface.resize(surfaceStart[bodies]);
+	surfaceEnd.assign(surfaceStart.begin(), surfaceStart.end() - 1);
+	for (int y = CELL; y < YRES - CELL; y++)
+		for (int x = CELL; x < XRES - CELL; x++)
+		{
+			int body = label[(y + 1) * XRES + x];
+			if (body >= 0 && !pmap[y][x] && surfaceRow[body] == y)
+				surface[surfaceEnd[body]++] = y * XRES + x;
+		}
+	valid = true;
+}
@@ -0,0 +1,71 @@
+#ifndef LIQUIDBODIES_H
+#define LIQUIDBODIES_H
+#include "Config.h"
+
+#include <array>
+#include <vector>
+
+#include "ElementDefs.h"
+
+class Element;
+
+/*
+ * Connected bodies of liquid (elements with Falldown 2), labelled with a
+ * union-find pass over pmap, for water equalisation. Each body records the
+ * lowest row that has an empty cell resting on its liquid and the empty cells
+ * in that row, which is where Simulation::flood_water sends particles that are
+ * above the surface.
+ *
+ * Labels are worked out once per frame and describe pmap as it was then.
+ */
+class LiquidBodies
+{
+	// Union-find parents while labelling, then the body of every cell or -1
+	std::vector<int> label;
+	// Per body: the lowest surface row, or -1 if it has no empty cell above it,
+	// and the range of its cells in surface that are still worth trying
+	std::vector<int> surfaceRow, surfaceStart, surfaceEnd;
+	std::vector<int> surface;
+	bool valid;
+
+	int Find(int i);
+
+public:
+	LiquidBodies();
+
+	void Update(int const (*pmap)[XRES], std::array<Element, PT_NUM> const &elements);
+	void Invalidate()
+	{
+		valid = false;
+	}
+	bool Valid() const
+	{
+		return valid;
+	}
+
+	// Body the cell belonged to when labelled, or -1
+	int Body(int x, int y) const
+	{
+		return label[y * XRES + x];
+	}
+	int SurfaceRow(int body) const
+	{
+		return surfaceRow[body];
+	}
+	int SurfaceCount(int body) const
+	{
+		return surfaceEnd[body] - surfaceStart[body];
+	}
+	// i-th surface cell of body, as y * XRES + x
+	int SurfaceCell(int body, int i) const
+	{
+		return surface[surfaceStart[body] + i];
+	}
+	// Stops offering the i-th surface cell of body, for when it has filled up
+	void DropSurfaceCell(int body, int i)
+	{
+		surface[surfaceStart[body] + i] = surface[--surfaceEnd[body]];
+	}
+};
+
+#endif
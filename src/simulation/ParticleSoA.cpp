@@ -0,0 +1,113 @@
+#include <cstddef>
+#include <cstring>
+#include "ParticleSoA.h"
+
+void ParticleSoA::Resize(int count)
+{
+	type.resize(count);
+	life.resize(count);
+	ctype.resize(count);
+	x.resize(count);
+	y.resize(count);
+	vx.resize(count);
+	vy.resize(count);
+	temp.resize(count);
+	pavg0.resize(count);
+	pavg1.resize(count);
+	flags.resize(count);
+	tmp.resize(count);
+	tmp2.resize(count);
+	dcolour.resize(count);
+}
+
+void ParticleSoA::Gather(Particle const *parts, int count)
+{
+	Resize(count);
+	for (int i = 0; i < count; i++)
+		Set(i, parts[i]);
+}
+
+void ParticleSoA::Scatter(Particle *parts) const
+{
+	int count = Size();
+	for (int i = 0; i < count; i++)
+		parts[i] = Get(i);
+}
+
+Particle ParticleSoA::Get(int i) const
+{
+	Particle part;
+	part.type = type[i];
+	part.life = life[i];
+	part.ctype = ctype[i];
+	part.x = x[i];
+	part.y = y[i];
+	part.vx = vx[i];
+	part.vy = vy[i];
+	part.temp = temp[i];
+	part.pavg[0] = pavg0[i];
+	part.pavg[1] = pavg1[i];
+	part.flags = flags[i];
+	part.tmp = tmp[i];
+	part.tmp2 = tmp2[i];
+	part.dcolour = dcolour[i];
+	return part;
+}
+
+void ParticleSoA::Set(int i, Particle const &part)
+{
+	type[i] = part.type;
+	life[i] = part.life;
+	ctype[i] = part.ctype;
+	x[i] = part.x;
+	y[i] = part.y;
+	vx[i] = part.vx;
+	vy[i] = part.vy;
+	temp[i] = part.temp;
+	pavg0[i] = part.pavg[0];
+	pavg1[i] = part.pavg[1];
+	flags[i] = part.flags;
+	tmp[i] = part.tmp;
+	tmp2[i] = part.tmp2;
+	dcolour[i] = part.dcolour;
+}
+
+void *ParticleSoA::Column(intptr_t offset)
+{
+	switch (offset)
+	{
+	case offsetof(Particle, type):    return type.data();
+	case offsetof(Particle, life):    return life.data();
+	case offsetof(Particle, ctype):   return ctype.data();
+	case offsetof(Particle, x):       return x.data();
+	case offsetof(Particle, y):       return y.data();
+	case offsetof(Particle, vx):      return vx.data();
+	case offsetof(Particle, vy):      return vy.data();
+	case offsetof(Particle, temp):    return temp.data();
+	case offsetof(Particle, pavg[0]): return pavg0.data();
+	case offsetof(Particle, pavg[1]): return pavg1.data();
+	case offsetof(Particle, flags):   return flags.data();
+	case offsetof(Particle, tmp):     return tmp.data();
+	case offsetof(Particle, tmp2):    return tmp2.data();
+	case offsetof(Particle, dcolour): return dcolour.data();
+	}
+	return nullptr;
+}
+
+// Every Particle member is 4 bytes wide, the same as PropertyValue
+PropertyValue ParticleSoA::GetProperty(int i, StructProperty const &property)
+{
+	PropertyValue value;
+	value.Integer = 0;
+	char *column = static_cast<char *>(Column(property.Offset));
+	if (column)
+		std::memcpy(&value, column + i * sizeof(value), sizeof(value));
+	return value;
+}
+
+void ParticleSoA::SetProperty(int i, StructProperty const &property, PropertyValue value)
+{
+	char *column = static_cast<char *>(Column(property.Offset));
+	if (column)
+		std::memcpy(column + i * sizeof(value), &value, sizeof(value));
+}
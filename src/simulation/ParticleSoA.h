@@ -0,0 +1,47 @@
+#ifndef PARTICLESOA_H_
+#define PARTICLESOA_H_
+#include "Config.h"
+
+#include <vector>
+#include "Particle.h"
+
+/** Structure-of-arrays copy of a range of Simulation::parts, one array per Particle member.
+ Passes that only look at a few members (type, position, temp) can sweep these instead of
+ pulling in whole particles. Gather copies parts in, Scatter writes them back; anything that
+ changes particles in between has to go through one of the two layouts consistently.
+ This is a prototype of the layout: Simulation doesn't keep one, only bench_layout uses it. **/
+class ParticleSoA
+{
+public:
+	std::vector<int> type;
+	std::vector<int> life;
+	std::vector<int> ctype;
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> temp;
+	std::vector<float> pavg0;
+	std::vector<float> pavg1;
+	std::vector<int> flags;
+	std::vector<int> tmp;
+	std::vector<int> tmp2;
+	std::vector<unsigned int> dcolour;
+
+	int Size() const { return int(type.size()); }
+	void Resize(int count);
+
+	void Gather(Particle const *parts, int count);
+	void Scatter(Particle *parts) const;
+
+	Particle Get(int i) const;
+	void Set(int i, Particle const &part);
+
+	/** Returns the array holding the Particle member at offset, as found in
+	 Particle::GetProperties, or nullptr for unknown offsets **/
+	void *Column(intptr_t offset);
+	PropertyValue GetProperty(int i, StructProperty const &property);
+	void SetProperty(int i, StructProperty const &property, PropertyValue value);
+};
+
+#endif
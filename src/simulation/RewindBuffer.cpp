@@ -0,0 +1,378 @@
+#include "RewindBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <zlib.h>
+
+#include "Simulation.h"
+#include "Snapshot.h"
+
+namespace
+{
+	// A capture is the state laid out flat, in the order of Snapshot. Everything
+	// but the particles is the same size every time and goes first, so that it
+	// still lines up with the keyframe when the number of particles changes.
+	template<class T>
+	void Put(std::vector<unsigned char> &out, T const *data, size_t count)
+	{
+		auto bytes = reinterpret_cast<unsigned char const *>(data);
+		out.insert(out.end(), bytes, bytes + count * sizeof(T));
+	}
+
+	template<class T>
+	void Take(unsigned char const *&in, T *data, size_t count)
+	{
+		std::memcpy(data, in, count * sizeof(T));
+		in += count * sizeof(T);
+	}
+
+	template<class T>
+	void Take(unsigned char const *&in, PagedArray<T> &array, size_t count)
+	{
+		std::vector<T> data(count);
+		Take(in, data.data(), count);
+		array.Assign(data.data(), count, nullptr);
+	}
+
+	float Since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+RewindBuffer::RewindBuffer(Simulation &sim):
+	sim(sim)
+{
+}
+
+RewindBuffer::~RewindBuffer()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+}
+
+void RewindBuffer::Work()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	while (true)
+	{
+		cv.wait(l, [this]() { return queued || stopping; });
+		if (stopping)
+			return;
+		queued = false;
+		busy = true;
+		bool key = newKeyframe;
+		newKeyframe = false;
+		l.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		Capture capture = std::move(jobCapture);
+		jobCapture = Capture();
+		capture.keyframe = key || keyframe.empty() || sinceKeyframe >= keyframeInterval;
+		Compress(capture);
+		float time = Since(start);
+		size_t working = job.capacity() + keyframe.capacity() + delta.capacity() + packed.capacity();
+
+		l.lock();
+		busy = false;
+		compressTime = time;
+		if (capture.data.size())
+		{
+			bytes += capture.data.size();
+			captures.push_back(std::move(capture));
+		}
+		else
+			newKeyframe = true;
+		workingBytes = working;
+		// Drop whole keyframes, as the captures after them can't be read without them
+		while (bytes + workingBytes > budget && captures.size() > 1)
+		{
+			auto next = std::find_if(captures.begin() + 1, captures.end(), [](Capture const &c) { return c.keyframe; });
+			if (next == captures.end())
+				break;
+			for (auto it = captures.begin(); it != next; ++it)
+				bytes -= it->data.size();
+			captures.erase(captures.begin(), next);
+		}
+		cv.notify_all();
+	}
+}
+
+void RewindBuffer::Compress(Capture &capture)
+{
+	std::vector<unsigned char> *source = &job;
+	if (capture.keyframe)
+	{
+		// The frame gets the old keyframe's buffer to fill next time
+		keyframe.swap(job);
+		source = &keyframe;
+		sinceKeyframe = 0;
+	}
+	else
+	{
+		// Whatever is the same as in the keyframe becomes zeros, which take next to nothing compressed
+		delta.resize(job.size());
+		size_t common = std::min(job.size(), keyframe.size());
+		for (size_t i = 0; i < common; i++)
+			delta[i] = job[i] ^ keyframe[i];
+		std::copy(job.begin() + common, job.end(), delta.begin() + common);
+		source = &delta;
+		sinceKeyframe++;
+	}
+
+	// Run length coding is quicker and nearly as small on the changes, being mostly zeros
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15, 8, capture.keyframe ? Z_DEFAULT_STRATEGY : Z_RLE) != Z_OK)
+	{
+		capture.data.clear();
+		return;
+	}
+	packed.resize(deflateBound(&stream, source->size()));
+	stream.next_in = source->data();
+	stream.avail_in = source->size();
+	stream.next_out = packed.data();
+	stream.avail_out = packed.size();
+	bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+	size_t size = stream.total_out;
+	deflateEnd(&stream);
+	if (!done)
+	{
+		capture.data.clear();
+		return;
+	}
+	capture.data.assign(packed.begin(), packed.begin() + size);
+}
+
+void RewindBuffer::Wait()
+{
+	std::unique_lock<std::mutex> l(mutex);
+	cv.wait(l, [this]() { return !queued && !busy; });
+}
+
+void RewindBuffer::Frame()
+{
+	if (!enabled)
+		return;
+	uint64_t tick = sim.currentTick;
+	if (restored && tick != lastTick)
+	{
+		// Running on from a capture that was rewound to, so the captures after it are no longer where the simulation is going
+		DropAfter(lastTick);
+		restored = false;
+	}
+	if (captured && tick < lastTick)
+		DropAfter(tick);
+	else if (captured && tick - lastTick < uint64_t(std::max(interval, 1)))
+		return;
+	lastTick = tick;
+	captured = true;
+
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		if (queued || busy)
+		{
+			skipped++;
+			return;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	const int cells = (XRES / CELL) * (YRES / CELL);
+	job.clear();
+	job.reserve(cells * (11 * sizeof(float) + 2) + sizeof(sim.wireless) + sizeof(sim.portalp) + (MAX_FIGHTERS + 2) * sizeof(playerst) + (sim.parts_lastActiveIndex + 1) * sizeof(Particle));
+	Put(job, &sim.pv[0][0], cells);
+	Put(job, &sim.vx[0][0], cells);
+	Put(job, &sim.vy[0][0], cells);
+	Put(job, &sim.hv[0][0], cells);
+	Put(job, sim.gravx, cells);
+	Put(job, sim.gravy, cells);
+	Put(job, sim.gravp, cells);
+	Put(job, sim.gravmap, cells);
+	Put(job, &sim.bmap[0][0], cells);
+	Put(job, &sim.emap[0][0], cells);
+	Put(job, &sim.fvx[0][0], cells);
+	Put(job, &sim.fvy[0][0], cells);
+	Put(job, &sim.wireless[0][0], CHANNELS * 2);
+	Put(job, &sim.portalp[0][0][0], sizeof(sim.portalp) / sizeof(Particle));
+	Put(job, &sim.fighters[0], MAX_FIGHTERS);
+	Put(job, &sim.player2, 1);
+	Put(job, &sim.player, 1);
+	Put(job, sim.parts, sim.parts_lastActiveIndex + 1);
+	jobCapture.tick = tick;
+	jobCapture.particles = sim.parts_lastActiveIndex + 1;
+	jobCapture.rawSize = job.size();
+	jobCapture.signs = sim.signs;
+	float time = Since(start);
+
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		copyTime = time;
+		queued = true;
+	}
+	if (!thread.joinable())
+		thread = std::thread([this]() { Work(); });
+	cv.notify_all();
+}
+
+void RewindBuffer::DropAfter(uint64_t tick)
+{
+	Wait();
+	std::lock_guard<std::mutex> g(mutex);
+	while (captures.size() && captures.back().tick > tick)
+	{
+		bytes -= captures.back().data.size();
+		captures.pop_back();
+	}
+	// The keyframe the compressing thread holds may have gone with them
+	newKeyframe = true;
+}
+
+void RewindBuffer::Clear()
+{
+	Wait();
+	std::lock_guard<std::mutex> g(mutex);
+	captures.clear();
+	bytes = 0;
+	newKeyframe = true;
+	skipped = 0;
+	captured = false;
+	restored = false;
+}
+
+bool RewindBuffer::Decompress(Capture const &capture, std::vector<unsigned char> &out)
+{
+	out.resize(capture.rawSize);
+	uLongf size = capture.rawSize;
+	return uncompress(out.data(), &size, capture.data.data(), capture.data.size()) == Z_OK && size == capture.rawSize;
+}
+
+int RewindBuffer::Count()
+{
+	std::lock_guard<std::mutex> g(mutex);
+	return int(captures.size());
+}
+
+uint64_t RewindBuffer::Tick(int back)
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (back < 0 || back >= int(captures.size()))
+		return 0;
+	return captures[captures.size() - 1 - back].tick;
+}
+
+bool RewindBuffer::Keyframe(int back)
+{
+	std::lock_guard<std::mutex> g(mutex);
+	if (back < 0 || back >= int(captures.size()))
+		return false;
+	return captures[captures.size() - 1 - back].keyframe;
+}
+
+int RewindBuffer::Position()
+{
+	if (!restored)
+		return -1;
+	std::lock_guard<std::mutex> g(mutex);
+	for (size_t back = 0; back < captures.size(); back++)
+		if (captures[captures.size() - 1 - back].tick == lastTick)
+			return int(back);
+	return -1;
+}
+
+bool RewindBuffer::Restore(int back)
+{
+	Wait();
+	std::vector<unsigned char> raw, changes;
+	uint64_t tick;
+	int particles;
+	std::vector<sign> signs;
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		if (back < 0 || back >= int(captures.size()))
+			return false;
+		size_t index = captures.size() - 1 - back;
+		size_t key = index;
+		// The oldest capture is always a keyframe
+		while (!captures[key].keyframe)
+			key--;
+		if (!Decompress(captures[key], raw))
+			return false;
+		if (key != index)
+		{
+			if (!Decompress(captures[index], changes))
+				return false;
+			size_t common = std::min(changes.size(), raw.size());
+			for (size_t i = 0; i < common; i++)
+				changes[i] ^= raw[i];
+			raw.swap(changes);
+		}
+		tick = captures[index].tick;
+		particles = captures[index].particles;
+		signs = captures[index].signs;
+	}
+
+	const int cells = (XRES / CELL) * (YRES / CELL);
+	Snapshot snap;
+	unsigned char const *in = raw.data();
+	Take(in, snap.AirPressure, cells);
+	Take(in, snap.AirVelocityX, cells);
+	Take(in, snap.AirVelocityY, cells);
+	Take(in, snap.AmbientHeat, cells);
+	Take(in, snap.GravVelocityX, cells);
+	Take(in, snap.GravVelocityY, cells);
+	Take(in, snap.GravValue, cells);
+	Take(in, snap.GravMap, cells);
+	Take(in, snap.BlockMap, cells);
+	Take(in, snap.ElecMap, cells);
+	Take(in, snap.FanVelocityX, cells);
+	Take(in, snap.FanVelocityY, cells);
+	snap.WirelessData.resize(CHANNELS * 2);
+	Take(in, snap.WirelessData.data(), CHANNELS * 2);
+	Take(in, snap.PortalParticles, sizeof(sim.portalp) / sizeof(Particle));
+	snap.stickmen.resize(MAX_FIGHTERS + 2);
+	Take(in, snap.stickmen.data(), MAX_FIGHTERS + 2);
+	Take(in, snap.Particles, particles);
+	snap.signs = signs;
+
+	sim.Restore(snap);
+	// The random streams are keyed on the tick, see BeforeSim
+	sim.currentTick = tick;
+	lastTick = tick;
+	captured = true;
+	restored = true;
+	return true;
+}
+
+RewindBuffer::Stats RewindBuffer::GetStats()
+{
+	std::lock_guard<std::mutex> g(mutex);
+	Stats stats;
+	stats.captures = int(captures.size());
+	stats.keyframes = 0;
+	stats.rawBytes = 0;
+	for (auto &capture : captures)
+	{
+		if (capture.keyframe)
+			stats.keyframes++;
+		stats.rawBytes += capture.rawSize;
+	}
+	stats.skipped = skipped;
+	stats.bytes = bytes;
+	stats.workingBytes = workingBytes;
+	stats.copyTime = copyTime;
+	stats.compressTime = compressTime;
+	stats.oldestTick = captures.size() ? captures.front().tick : 0;
+	stats.newestTick = captures.size() ? captures.back().tick : 0;
+	return stats;
+}
@@ -0,0 +1,128 @@
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+#include "Config.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Sign.h"
+
+class Simulation;
+
+/*
+ * Keeps the state of the simulation every few frames, for rewinding it. The
+ * frame itself only copies the state into a flat buffer; a thread of its own
+ * compresses it, as the difference from the last keyframe where it isn't a
+ * keyframe itself, so that a capture costs the frame about one copy. A capture
+ * that comes due while the previous one is still being compressed is skipped.
+ *
+ * Captures are kept under budget bytes by dropping the oldest keyframe along
+ * with the captures made against it. The budget covers the compressed
+ * captures and the buffers used to make them, which hold a whole uncompressed
+ * state each, so the newest keyframe and what follows it are kept even if the
+ * buffers alone go over.
+ */
+class RewindBuffer
+{
+public:
+	struct Stats
+	{
+		int captures;
+		int keyframes;
+		int skipped;
+		// Compressed bytes kept, and what they would take uncompressed
+		size_t bytes;
+		size_t rawBytes;
+		// Buffers held for capturing and compressing, counted against the budget along with bytes
+		size_t workingBytes;
+		// Milliseconds spent by the last capture copying the state, and compressing it
+		float copyTime;
+		float compressTime;
+		uint64_t oldestTick;
+		uint64_t newestTick;
+	};
+
+private:
+	struct Capture
+	{
+		uint64_t tick;
+		bool keyframe;
+		int particles;
+		size_t rawSize;
+		std::vector<unsigned char> data;
+		std::vector<sign> signs;
+	};
+
+	Simulation &sim;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+	bool queued = false;
+	bool busy = false;
+
+	// Filled by the frame, and only touched by the compressing thread while a job is queued or running
+	std::vector<unsigned char> job;
+	Capture jobCapture;
+
+	// Only touched by the compressing thread
+	std::vector<unsigned char> keyframe;
+	std::vector<unsigned char> delta;
+	std::vector<unsigned char> packed;
+	int sinceKeyframe = 0;
+
+	// Guarded by mutex
+	std::deque<Capture> captures;
+	size_t bytes = 0;
+	bool newKeyframe = true;
+	int skipped = 0;
+	float copyTime = 0;
+	float compressTime = 0;
+	size_t workingBytes = 0;
+
+	uint64_t lastTick = 0;
+	bool captured = false;
+	// The simulation was last put back to the capture at lastTick
+	bool restored = false;
+
+	void Work();
+	void Compress(Capture &capture);
+	void Wait();
+	void DropAfter(uint64_t tick);
+	bool Decompress(Capture const &capture, std::vector<unsigned char> &out);
+
+public:
+	bool enabled = false;
+	// Frames between captures
+	int interval = 10;
+	// Captures between keyframes
+	int keyframeInterval = 8;
+	size_t budget = 128 << 20;
+
+	RewindBuffer(Simulation &sim);
+	~RewindBuffer();
+
+	// Captures the state if one is due. Called at the end of every frame.
+	void Frame();
+	void Clear();
+
+	int Count();
+	// Tick of the capture back captures before the newest one
+	uint64_t Tick(int back);
+	bool Keyframe(int back);
+	// How many captures before the newest one the simulation was put back to,
+	// or -1 if it has run on since, or was never put back
+	int Position();
+	// Puts the simulation back to the capture back captures before the newest
+	// one. The captures after it stay until the simulation runs on from there.
+	bool Restore(int back);
+
+	Stats GetStats();
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "Simulation.h"
 
+#include <cassert>
 #include <iostream>
 #include <cmath>
 #include <set>
@@ -16,8 +17,12 @@
 #include "Gravity.h"
 #include "Sample.h"
 #include "Snapshot.h"
+#include "WorkerPool.h"
+#include "AirPipeline.h"
+#include "RewindBuffer.h"
 
 #include "client/Client.h"
+#include "client/LevelPack.h"
 #include "client/SaveFile.h"
 
 #include "Misc.h"
@@ -29,6 +34,7 @@
 #include "graphics/Renderer.h"
 
 #include "client/GameSave.h"
+#include "common/Profiler.h"
 #include "common/tpt-compat.h"
 #include "common/tpt-minmax.h"
 #include "common/tpt-rand.h"
@@ -45,26 +51,118 @@ extern int Element_LOLZ_lolz[XRES / 9][YRES / 9];
 extern int Element_LOVE_RuleTable[9][9];
 extern int Element_LOVE_love[XRES / 9][YRES / 9];
 
+// Called from LOAD's update, so the level only replaces this one at the end
+// of the frame, once it has been read and parsed, see SwapInNextSave
 int Simulation::LoadNextSave()
 {
-	if (saveIndex >= filePaths.size())
-		saveIndex = filePaths.size() - 1;
+	loadNextSave = true;
+	PreloadNextSave();
+	return 0;
+}
 
-	std::vector<unsigned char> gameSaveData = Client::Ref().ReadFile(filePaths[saveIndex]);
-	if (!gameSaveData.size())
-	{
-		std::cout << "No File..." << std::endl;
-	}
-	else
+void Simulation::LoadLevel(int index)
+{
+	saveIndex = index;
+	LoadNextSave();
+}
+
+int Simulation::LevelCount()
+{
+	return levelPack ? levelPack->Count() : int(filePaths.size());
+}
+
+ByteString Simulation::LevelName(int index)
+{
+	if (levelPack)
+		return levelPack->Name(index);
+	return index >= 0 && index < int(filePaths.size()) ? filePaths[index] : "";
+}
+
+int Simulation::FindLevel(ByteString name)
+{
+	if (levelPack)
+		return levelPack->Find(name);
+	// Loose levels go by their file name, with or without the extension
+	for (int i = 0; i < int(filePaths.size()); i++)
+		if (filePaths[i] == name || filePaths[i] == name + ".cps")
+			return i;
+	return -1;
+}
+
+void Simulation::SetLevelPack(std::shared_ptr<LevelPack> pack)
+{
+	if (savePreload.joinable())
+		savePreload.join();
+	levelPack = pack;
+	saveIndex = 0;
+	preloadIndex = -1;
+	preloadedSave.reset();
+	savePreloaded = false;
+	loadNextSave = false;
+}
+
+// Starts reading and parsing the level LoadNextSave would load, unless that's already under way
+void Simulation::PreloadNextSave()
+{
+	int count = LevelCount();
+	if (!count)
+		return;
+	int index = std::max(0, std::min(saveIndex, count - 1));
+	if (index == preloadIndex)
+		return;
+	if (savePreload.joinable())
+		savePreload.join();
+	preloadIndex = index;
+	preloadedSave.reset();
+	savePreloaded = false;
+	ByteString path = LevelName(index);
+	std::shared_ptr<LevelPack> pack = levelPack;
+	savePreload = std::thread([this, path, pack, index]() {
+		// The pack is mapped, so this only reads the pages the save is in
+		std::vector<char> gameSaveData;
+		if (pack)
+			gameSaveData = pack->Save(index);
+		else
+		{
+			std::vector<unsigned char> fileData = Client::Ref().ReadFile(path);
+			gameSaveData.assign(fileData.begin(), fileData.end());
+		}
+		if (!gameSaveData.size())
+		{
+			std::cout << "No File..." << std::endl;
+		}
+		else
+		{
+			try
+			{
+				GameSave *newSave = new GameSave(gameSaveData);
+				// The constructor only checks that it parses, this keeps it parsed for Load
+				newSave->Expand();
+				preloadedSave.reset(newSave);
+			}
+			catch (ParseException &e)
+			{
+				std::cerr << "Can't load " << path << ": " << e.what() << std::endl;
+			}
+		}
+		savePreloaded = true;
+	});
+}
+
+void Simulation::SwapInNextSave()
+{
+	savePreload.join();
+	savePreloaded = false;
+	loadNextSave = false;
+	std::unique_ptr<GameSave> newSave = std::move(preloadedSave);
+	saveIndex = preloadIndex + 1;
+	preloadIndex = -1;
+	if (newSave)
 	{
-		GameSave *newSave = new GameSave(gameSaveData);
 		newSave->paused = false;
 		clear_area(0, 0, XRES, YRES);
-		Load(newSave, true);
+		Load(newSave.get(), true);
 	}
-
-	saveIndex++;
-	return 0;
 }
 
 int Simulation::Load(GameSave *save, bool includePressure)
@@ -303,6 +401,9 @@ int Simulation::Load(GameSave *save, bool includePressure, int fullX, int fullY)
 	parts_lastActiveIndex = NPART - 1;
 	force_stacking_check = true;
 	Element_PPIP_ppip_changed = 1;
+	pmapRebuild = true;
+	WakeAll();
+	airPipeline->Discard();
 	RecalcFreeParticles(false);
 
 	// fix SOAP links using soapList, a map of old particle ID -> new particle ID
@@ -365,6 +466,10 @@ int Simulation::Load(GameSave *save, bool includePressure, int fullX, int fullY)
 	gravWallChanged = true;
 	air->RecalculateBlockAirMaps();
 
+	// A save with LOAD in it is a level, so get the one after it ready
+	if (elementCount[PT_LOAD])
+		PreloadNextSave();
+
 	return 0;
 }
 
@@ -539,30 +644,43 @@ void Simulation::SaveSimOptions(GameSave *gameSave)
 	gameSave->waterEEnabled = water_equal_test;
 	gameSave->gravityEnable = grav->IsEnabled();
 	gameSave->aheatEnable = aheat_enable;
+	gameSave->pipelineAir = pipelineAir;
+	gameSave->hasRngSeed = true;
+	gameSave->rngSeed = rngSeed;
+	gameSave->currentTick = currentTick;
+}
+
+void Simulation::NewRngSeed()
+{
+	rngSeed = uint64_t(RNG::Ref()()) << 32 | RNG::Ref()();
 }
 
 Snapshot *Simulation::CreateSnapshot()
 {
+	const int cells = (XRES / CELL) * (YRES / CELL);
 	Snapshot *snap = new Snapshot();
-	snap->AirPressure.insert(snap->AirPressure.begin(), &pv[0][0], &pv[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->AirVelocityX.insert(snap->AirVelocityX.begin(), &vx[0][0], &vx[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->AirVelocityY.insert(snap->AirVelocityY.begin(), &vy[0][0], &vy[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->AmbientHeat.insert(snap->AmbientHeat.begin(), &hv[0][0], &hv[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->Particles.insert(snap->Particles.begin(), parts, parts + parts_lastActiveIndex + 1);
-	snap->PortalParticles.insert(snap->PortalParticles.begin(), &portalp[0][0][0], &portalp[CHANNELS - 1][8 - 1][80 - 1]);
+	Snapshot const *base = snapshotBase.get();
+	snap->AirPressure.Assign(&pv[0][0], cells, base ? &base->AirPressure : nullptr);
+	snap->AirVelocityX.Assign(&vx[0][0], cells, base ? &base->AirVelocityX : nullptr);
+	snap->AirVelocityY.Assign(&vy[0][0], cells, base ? &base->AirVelocityY : nullptr);
+	snap->AmbientHeat.Assign(&hv[0][0], cells, base ? &base->AmbientHeat : nullptr);
+	snap->Particles.Assign(parts, parts_lastActiveIndex + 1, base ? &base->Particles : nullptr);
+	snap->PortalParticles.Assign(&portalp[0][0][0], sizeof(portalp) / sizeof(Particle), base ? &base->PortalParticles : nullptr);
 	snap->WirelessData.insert(snap->WirelessData.begin(), &wireless[0][0], &wireless[CHANNELS - 1][2 - 1]);
-	snap->GravVelocityX.insert(snap->GravVelocityX.begin(), gravx, gravx + ((XRES / CELL) * (YRES / CELL)));
-	snap->GravVelocityY.insert(snap->GravVelocityY.begin(), gravy, gravy + ((XRES / CELL) * (YRES / CELL)));
-	snap->GravValue.insert(snap->GravValue.begin(), gravp, gravp + ((XRES / CELL) * (YRES / CELL)));
-	snap->GravMap.insert(snap->GravMap.begin(), gravmap, gravmap + ((XRES / CELL) * (YRES / CELL)));
-	snap->BlockMap.insert(snap->BlockMap.begin(), &bmap[0][0], &bmap[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->ElecMap.insert(snap->ElecMap.begin(), &emap[0][0], &emap[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->FanVelocityX.insert(snap->FanVelocityX.begin(), &fvx[0][0], &fvx[0][0] + ((XRES / CELL) * (YRES / CELL)));
-	snap->FanVelocityY.insert(snap->FanVelocityY.begin(), &fvy[0][0], &fvy[0][0] + ((XRES / CELL) * (YRES / CELL)));
+	snap->GravVelocityX.Assign(gravx, cells, base ? &base->GravVelocityX : nullptr);
+	snap->GravVelocityY.Assign(gravy, cells, base ? &base->GravVelocityY : nullptr);
+	snap->GravValue.Assign(gravp, cells, base ? &base->GravValue : nullptr);
+	snap->GravMap.Assign(gravmap, cells, base ? &base->GravMap : nullptr);
+	snap->BlockMap.Assign(&bmap[0][0], cells, base ? &base->BlockMap : nullptr);
+	snap->ElecMap.Assign(&emap[0][0], cells, base ? &base->ElecMap : nullptr);
+	snap->FanVelocityX.Assign(&fvx[0][0], cells, base ? &base->FanVelocityX : nullptr);
+	snap->FanVelocityY.Assign(&fvy[0][0], cells, base ? &base->FanVelocityY : nullptr);
 	snap->stickmen.push_back(player2);
 	snap->stickmen.push_back(player);
 	snap->stickmen.insert(snap->stickmen.begin(), &fighters[0], &fighters[MAX_FIGHTERS]);
 	snap->signs = signs;
+	// Shares all of its pages, so this costs next to nothing
+	snapshotBase.reset(new Snapshot(*snap));
 	return snap;
 }
 
@@ -572,34 +690,39 @@ void Simulation::Restore(const Snapshot &snap)
 	elementRecount = true;
 	force_stacking_check = true;
 
-	std::copy(snap.AirPressure.begin(), snap.AirPressure.end(), &pv[0][0]);
-	std::copy(snap.AirVelocityX.begin(), snap.AirVelocityX.end(), &vx[0][0]);
-	std::copy(snap.AirVelocityY.begin(), snap.AirVelocityY.end(), &vy[0][0]);
-	std::copy(snap.AmbientHeat.begin(), snap.AmbientHeat.end(), &hv[0][0]);
+	snap.AirPressure.CopyTo(&pv[0][0]);
+	snap.AirVelocityX.CopyTo(&vx[0][0]);
+	snap.AirVelocityY.CopyTo(&vy[0][0]);
+	snap.AmbientHeat.CopyTo(&hv[0][0]);
 	for (int i = 0; i < NPART; i++)
 		parts[i].type = 0;
-	std::copy(snap.Particles.begin(), snap.Particles.end(), parts);
+	snap.Particles.CopyTo(parts);
 	parts_lastActiveIndex = NPART - 1;
+	pmapRebuild = true;
+	WakeAll();
+	airPipeline->Discard();
 	RecalcFreeParticles(false);
-	std::copy(snap.PortalParticles.begin(), snap.PortalParticles.end(), &portalp[0][0][0]);
+	snap.PortalParticles.CopyTo(&portalp[0][0][0]);
 	std::copy(snap.WirelessData.begin(), snap.WirelessData.end(), &wireless[0][0]);
 	if (grav->IsEnabled())
 	{
 		grav->Clear();
-		std::copy(snap.GravVelocityX.begin(), snap.GravVelocityX.end(), gravx);
-		std::copy(snap.GravVelocityY.begin(), snap.GravVelocityY.end(), gravy);
-		std::copy(snap.GravValue.begin(), snap.GravValue.end(), gravp);
-		std::copy(snap.GravMap.begin(), snap.GravMap.end(), gravmap);
+		snap.GravVelocityX.CopyTo(gravx);
+		snap.GravVelocityY.CopyTo(gravy);
+		snap.GravValue.CopyTo(gravp);
+		snap.GravMap.CopyTo(gravmap);
 	}
 	gravWallChanged = true;
-	std::copy(snap.BlockMap.begin(), snap.BlockMap.end(), &bmap[0][0]);
-	std::copy(snap.ElecMap.begin(), snap.ElecMap.end(), &emap[0][0]);
-	std::copy(snap.FanVelocityX.begin(), snap.FanVelocityX.end(), &fvx[0][0]);
-	std::copy(snap.FanVelocityY.begin(), snap.FanVelocityY.end(), &fvy[0][0]);
+	snap.BlockMap.CopyTo(&bmap[0][0]);
+	snap.ElecMap.CopyTo(&emap[0][0]);
+	snap.FanVelocityX.CopyTo(&fvx[0][0]);
+	snap.FanVelocityY.CopyTo(&fvy[0][0]);
 	std::copy(snap.stickmen.begin(), snap.stickmen.end() - 2, &fighters[0]);
 	player = snap.stickmen[snap.stickmen.size() - 1];
 	player2 = snap.stickmen[snap.stickmen.size() - 2];
 	signs = snap.signs;
+	// The state is the snapshot's again, so the next one can share its pages
+	snapshotBase.reset(new Snapshot(snap));
 }
 
 void Simulation::clear_area(int area_x, int area_y, int area_w, int area_h)
@@ -684,6 +807,8 @@ int Simulation::flood_prop(int x, int y, size_t propoffset, PropertyValue propva
 					break;
 				x2++;
 			}
+			CheckReach(x1, y);
+			CheckReach(x2, y);
 			for (x = x1; x <= x2; x++)
 			{
 				i = pmap[y][x];
@@ -783,6 +908,15 @@ int Simulation::FloodINST(int x, int y)
 	if (TYP(pmap[y][x]) != cm || parts[ID(pmap[y][x])].life != 0)
 		return 1;
 
+	// An idle network can be sparked a run at a time, the search below is for the rest
+	if (instNetwork.Flood(pmap, parts, x, y))
+	{
+		for (auto &run : instNetwork.Sparked())
+			for (x = run.x1; x <= run.x2; x++)
+				create_part(-1, x, run.y, PT_SPRK);
+		return 1;
+	}
+
 	CoordStack &cs = getCoordStackSingleton();
 	cs.clear();
 
@@ -883,75 +1017,39 @@ int Simulation::FloodINST(int x, int y)
 
 bool Simulation::flood_water(int x, int y, int i)
 {
-	int x1, x2, originalY = y;
-	int r = pmap[y][x];
-	if (!r)
+	if (!pmap[y][x])
 		return false;
+	if (!liquidBodies.Valid())
+		liquidBodies.Update(pmap, elements);
 
-	// Bitmap for checking where we've already looked
-	auto bitmapPtr = std::unique_ptr<char[]>(new char[XRES * YRES]);
-	char *bitmap = bitmapPtr.get();
-	std::fill(&bitmap[0], &bitmap[XRES * YRES], 0);
-
-	try
-	{
-		CoordStack &cs = getCoordStackSingleton();
-		cs.clear();
-
-		cs.push(x, y);
-		do
+	// Move the particle to the lowest surface of the body of liquid it is in,
+	// if that is below it
+	int body = liquidBodies.Body(x, y);
+	if (body < 0 || liquidBodies.SurfaceRow(body) <= y)
+		return false;
+	while (int count = liquidBodies.SurfaceCount(body))
+	{
+		// Surface cells fill up as particles move into them, so pick one at random
+		// and forget it if it's no longer free
+		int pick = RNG::Ref().between(0, count - 1);
+		int cell = liquidBodies.SurfaceCell(body, pick);
+		int nx = cell % XRES, ny = cell / XRES;
+		if (pmap[ny][nx] || !eval_move(parts[i].type, nx, ny, nullptr))
 		{
-			cs.pop(x, y);
-			x1 = x2 = x;
-			while (x1 >= CELL)
-			{
-				if (elements[TYP(pmap[y][x1 - 1])].Falldown != 2 || bitmap[(y * XRES) + x1 - 1])
-					break;
-				x1--;
-			}
-			while (x2 < XRES - CELL)
-			{
-				if (elements[TYP(pmap[y][x2 + 1])].Falldown != 2 || bitmap[(y * XRES) + x1 - 1])
-					break;
-				x2++;
-			}
-			for (int x = x1; x <= x2; x++)
-			{
-				if ((y - 1) > originalY && !pmap[y - 1][x])
-				{
-					// Try to move the water to a random position on this line, because there's probably a free location somewhere
-					int randPos = RNG::Ref().between(x, x2);
-					if (!pmap[y - 1][randPos] && eval_move(parts[i].type, randPos, y - 1, nullptr))
-						x = randPos;
-					// Couldn't move to random position, so try the original position on the left
-					else if (!eval_move(parts[i].type, x, y - 1, nullptr))
-						continue;
-
-					int oldx = (int)(parts[i].x + 0.5f);
-					int oldy = (int)(parts[i].y + 0.5f);
-					pmap[y - 1][x] = pmap[oldy][oldx];
-					pmap[oldy][oldx] = 0;
-					parts[i].x = x;
-					parts[i].y = y - 1;
-					return true;
-				}
+			liquidBodies.DropSurfaceCell(body, pick);
+			continue;
+		}
 
-				bitmap[(y * XRES) + x] = 1;
-			}
-			if (y >= CELL + 1)
-				for (int x = x1; x <= x2; x++)
-					if (elements[TYP(pmap[y - 1][x])].Falldown == 2 && !bitmap[((y - 1) * XRES) + x])
-						cs.push(x, y - 1);
-			if (y < YRES - CELL - 1)
-				for (int x = x1; x <= x2; x++)
-					if (elements[TYP(pmap[y + 1][x])].Falldown == 2 && !bitmap[((y + 1) * XRES) + x])
-						cs.push(x, y + 1);
-		} while (cs.getSize() > 0);
-	}
-	catch (std::exception &e)
-	{
-		std::cerr << e.what() << std::endl;
-		return false;
+		int oldx = (int)(parts[i].x + 0.5f);
+		int oldy = (int)(parts[i].y + 0.5f);
+		cellIdle[oldy / CELL][oldx / CELL] = 0;
+		pmap[ny][nx] = pmap[oldy][oldx];
+		pmap[oldy][oldx] = 0;
+		parts[i].x = nx;
+		parts[i].y = ny;
+		UpdatePartCell(i);
+		liquidBodies.DropSurfaceCell(body, pick);
+		return true;
 	}
 	return false;
 }
@@ -1388,6 +1486,7 @@ int Simulation::Tool(int x, int y, int tool, int brushX, int brushY, float stren
 		cpart = &(parts[ID(r)]);
 	else if ((r = photons[y][x]))
 		cpart = &(parts[ID(r)]);
+	WakeCell(x, y);
 	return tools[tool].Perform(this, cpart, x, y, brushX, brushY, strength);
 }
 
@@ -1521,6 +1620,7 @@ int Simulation::CreateWalls(int x, int y, int rx, int ry, int wall, Brush *cBrus
 				}
 				if (wall == WL_GRAV || bmap[wallY][wallX] == WL_GRAV)
 					gravWallChanged = true;
+				cellIdle[wallY][wallX] = 0;
 
 				if (wall == WL_ERASEALL)
 				{
@@ -2191,7 +2291,10 @@ void Simulation::set_emap(int x, int y)
 
 	// fill span
 	for (x = x1; x <= x2; x++)
+	{
 		emap[y][x] = 16;
+		cellIdle[y][x] = 0;
+	}
 
 	// fill children
 
@@ -2288,6 +2391,7 @@ void Simulation::clear_sim(void)
 	debug_currentParticle = 0;
 	emp_decor = 0;
 	emp_trigger_count = 0;
+	NewRngSeed();
 	signs.clear();
 	memset(bmap, 0, sizeof(bmap));
 	memset(emap, 0, sizeof(emap));
@@ -2301,8 +2405,17 @@ void Simulation::clear_sim(void)
 	memset(fvx, 0, sizeof(fvx));
 	memset(fvy, 0, sizeof(fvy));
 	memset(photons, 0, sizeof(photons));
+	pmapRebuild = true;
+	std::fill(partListType, partListType + partListEnd, 0);
+	for (auto &list : partLists)
+		list.clear();
+	partListSorted.fill(true);
+	partListEnd = 0;
+	WakeAll();
+	airPipeline->Discard();
+	snapshotBase.reset();
+	rewind->Clear();
 	memset(wireless, 0, sizeof(wireless));
-	memset(gol, 0, sizeof(gol));
 	memset(portalp, 0, sizeof(portalp));
 	memset(fighters, 0, sizeof(fighters));
 	std::fill(elementCount, elementCount + PT_NUM, 0);
@@ -2334,21 +2447,16 @@ void Simulation::clear_sim(void)
 
 bool Simulation::IsWallBlocking(int x, int y, int type)
 {
-	if (bmap[y / CELL][x / CELL])
+	int wall = bmap[y / CELL][x / CELL];
+	if (wall && wall < UI_WALLCOUNT)
 	{
-		int wall = bmap[y / CELL][x / CELL];
-		if (wall == WL_ALLOWGAS && !(elements[type].Properties & TYPE_GAS))
-			return true;
-		else if (wall == WL_ALLOWENERGY && !(elements[type].Properties & TYPE_ENERGY))
-			return true;
-		else if (wall == WL_ALLOWLIQUID && !(elements[type].Properties & TYPE_LIQUID))
-			return true;
-		else if (wall == WL_ALLOWPOWDER && !(elements[type].Properties & TYPE_PART))
-			return true;
-		else if (wall == WL_ALLOWAIR || wall == WL_WALL || wall == WL_WALLELEC)
-			return true;
-		else if (wall == WL_EWALL && !emap[y / CELL][x / CELL])
+		switch (wallMove[type][wall])
+		{
+		case WALLMOVE_BLOCK:
 			return true;
+		case WALLMOVE_EWALL:
+			return !emap[y / CELL][x / CELL];
+		}
 	}
 	return false;
 }
@@ -2484,6 +2592,42 @@ void Simulation::init_can_move()
 	can_move[PT_THDR][PT_THDR] = 2;
 	can_move[PT_EMBR][PT_EMBR] = 2;
 	can_move[PT_TRON][PT_SWCH] = 3;
+
+	for (movingType = 0; movingType < PT_NUM; movingType++)
+	{
+		int properties = elements[movingType].Properties;
+		for (int wall = 0; wall < UI_WALLCOUNT; wall++)
+		{
+			int move = WALLMOVE_PASS;
+			if ((wall == WL_ALLOWGAS && !(properties & TYPE_GAS)) ||
+			    (wall == WL_ALLOWENERGY && !(properties & TYPE_ENERGY)) ||
+			    (wall == WL_ALLOWLIQUID && !(properties & TYPE_LIQUID)) ||
+			    (wall == WL_ALLOWPOWDER && !(properties & TYPE_PART)) ||
+			    wall == WL_ALLOWAIR || wall == WL_WALL || wall == WL_WALLELEC)
+				move = WALLMOVE_BLOCK;
+			else if (wall == WL_EWALL)
+				move = WALLMOVE_EWALL;
+			else if (wall == WL_EHOLE)
+				move = WALLMOVE_EHOLE;
+			wallMove[movingType][wall] = move;
+		}
+
+		// Each of these matches a case in try_move
+		bool bounceMover = properties & TYPE_ENERGY;
+		bool swapMover = movingType == PT_NEUT || movingType == PT_CNCT || movingType == PT_GBMB;
+		for (destinationType = 0; destinationType < PT_NUM; destinationType++)
+		{
+			int flags = 0;
+			if (bounceMover || destinationType == PT_WOOD)
+				flags |= MOVE_BOUNCEEFFECT;
+			if (swapMover || destinationType == PT_VOID || destinationType == PT_PVOD || destinationType == PT_BHOL || destinationType == PT_NBHL ||
+			    destinationType == PT_WHOL || destinationType == PT_NWHL || destinationType == PT_DEUT || destinationType == PT_VIBR || destinationType == PT_BVBR)
+				flags |= MOVE_SWAPEFFECT;
+			if (!(properties & TYPE_SOLID) && !(elements[destinationType].Properties & TYPE_SOLID))
+				flags |= MOVE_NONSOLID;
+			moveFlags[movingType][destinationType] = flags;
+		}
+	}
 }
 
 /*
@@ -2566,12 +2710,22 @@ int Simulation::eval_move(int pt, int nx, int ny, unsigned *rr)
 			result = 1;
 		}
 	}
-	if (bmap[ny / CELL][nx / CELL])
+	int wall = bmap[ny / CELL][nx / CELL];
+	if (wall && wall < UI_WALLCOUNT)
 	{
-		if (IsWallBlocking(nx, ny, pt))
+		switch (wallMove[pt][wall])
+		{
+		case WALLMOVE_BLOCK:
 			return 0;
-		if (bmap[ny / CELL][nx / CELL] == WL_EHOLE && !emap[ny / CELL][nx / CELL] && !(elements[pt].Properties & TYPE_SOLID) && !(elements[TYP(r)].Properties & TYPE_SOLID))
-			return 2;
+		case WALLMOVE_EWALL:
+			if (!emap[ny / CELL][nx / CELL])
+				return 0;
+			break;
+		case WALLMOVE_EHOLE:
+			if (!emap[ny / CELL][nx / CELL] && (moveFlags[pt][TYP(r)] & MOVE_NONSOLID))
+				return 2;
+			break;
+		}
 	}
 	return result;
 }
@@ -2594,6 +2748,8 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 	if (!e) //if no movement
 	{
 		int rt = TYP(r);
+		if (!(moveFlags[parts[i].type][rt] & MOVE_BOUNCEEFFECT))
+			return 0;
 		if (rt == PT_WOOD)
 		{
 			float vel = std::sqrt(std::pow(parts[i].vx, 2) + std::pow(parts[i].vy, 2));
@@ -2629,6 +2785,9 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 				parts[ID(r)].tmp = CHANNELS - 1;
 			else if (parts[ID(r)].tmp < 0)
 				parts[ID(r)].tmp = 0;
+			// portalp is shared by every portal on the screen
+			if (checkTile)
+				tiledUpdateOverreach++;
 			for (nnx = 0; nnx < 80; nnx++)
 				if (!portalp[parts[ID(r)].tmp][count][nnx].type)
 				{
@@ -2763,74 +2922,77 @@ int Simulation::try_move(int i, int x, int y, int nx, int ny)
 	}
 	//else e=1 , we are trying to swap the particles, return 0 no swap/move, 1 is still overlap/move, because the swap takes place later
 
-	switch (TYP(r))
+	if (moveFlags[parts[i].type][TYP(r)] & MOVE_SWAPEFFECT)
 	{
-	case PT_VOID:
-	case PT_PVOD:
-		// this is where void eats particles
-		// void ctype already checked in eval_move
-		kill_part(i);
-		return 0;
-	case PT_BHOL:
-	case PT_NBHL:
-		// this is where blackhole eats particles
-		if (!legacy_enable)
-		{
-			parts[ID(r)].temp = restrict_flt(parts[ID(r)].temp + parts[i].temp / 2, MIN_TEMP, MAX_TEMP); //3.0f;
-		}
-		kill_part(i);
-		return 0;
-	case PT_WHOL:
-	case PT_NWHL:
-		// whitehole eats anar
-		if (parts[i].type == PT_ANAR)
+		switch (TYP(r))
 		{
+		case PT_VOID:
+		case PT_PVOD:
+			// this is where void eats particles
+			// void ctype already checked in eval_move
+			kill_part(i);
+			return 0;
+		case PT_BHOL:
+		case PT_NBHL:
+			// this is where blackhole eats particles
 			if (!legacy_enable)
 			{
-				parts[ID(r)].temp = restrict_flt(parts[ID(r)].temp - (MAX_TEMP - parts[i].temp) / 2, MIN_TEMP, MAX_TEMP);
+				parts[ID(r)].temp = restrict_flt(parts[ID(r)].temp + parts[i].temp / 2, MIN_TEMP, MAX_TEMP); //3.0f;
 			}
 			kill_part(i);
 			return 0;
+		case PT_WHOL:
+		case PT_NWHL:
+			// whitehole eats anar
+			if (parts[i].type == PT_ANAR)
+			{
+				if (!legacy_enable)
+				{
+					parts[ID(r)].temp = restrict_flt(parts[ID(r)].temp - (MAX_TEMP - parts[i].temp) / 2, MIN_TEMP, MAX_TEMP);
+				}
+				kill_part(i);
+				return 0;
+			}
+			break;
+		case PT_DEUT:
+			if (parts[i].type == PT_ELEC)
+			{
+				if (parts[ID(r)].life < 6000)
+					parts[ID(r)].life += 1;
+				parts[ID(r)].temp = 0;
+				kill_part(i);
+				return 0;
+			}
+			break;
+		case PT_VIBR:
+		case PT_BVBR:
+			if ((elements[parts[i].type].Properties & TYPE_ENERGY))
+			{
+				parts[ID(r)].tmp += 20;
+				kill_part(i);
+				return 0;
+			}
+			break;
 		}
-		break;
-	case PT_DEUT:
-		if (parts[i].type == PT_ELEC)
-		{
-			if (parts[ID(r)].life < 6000)
-				parts[ID(r)].life += 1;
-			parts[ID(r)].temp = 0;
-			kill_part(i);
-			return 0;
-		}
-		break;
-	case PT_VIBR:
-	case PT_BVBR:
-		if ((elements[parts[i].type].Properties & TYPE_ENERGY))
-		{
-			parts[ID(r)].tmp += 20;
-			kill_part(i);
-			return 0;
-		}
-		break;
-	}
 
-	switch (parts[i].type)
-	{
-	case PT_NEUT:
-		if (elements[TYP(r)].Properties & PROP_NEUTABSORB)
+		switch (parts[i].type)
 		{
-			kill_part(i);
-			return 0;
+		case PT_NEUT:
+			if (elements[TYP(r)].Properties & PROP_NEUTABSORB)
+			{
+				kill_part(i);
+				return 0;
+			}
+			break;
+		case PT_CNCT:
+			if (y < ny && (TYP(pmap[y + 1][x]) == PT_CNCT || TYP(pmap[y + 1][x]) == PT_ROCK)) //check below CNCT for another CNCT or ROCK
+				return 0;
+			break;
+		case PT_GBMB:
+			if (parts[i].life > 0)
+				return 0;
+			break;
 		}
-		break;
-	case PT_CNCT:
-		if (y < ny && (TYP(pmap[y + 1][x]) == PT_CNCT || TYP(pmap[y + 1][x]) == PT_ROCK)) //check below CNCT for another CNCT or ROCK
-			return 0;
-		break;
-	case PT_GBMB:
-		if (parts[i].life > 0)
-			return 0;
-		break;
 	}
 
 	if ((bmap[y / CELL][x / CELL] == WL_EHOLE && !emap[y / CELL][x / CELL]) && !(bmap[ny / CELL][nx / CELL] == WL_EHOLE && !emap[ny / CELL][nx / CELL]))
@@ -2904,6 +3066,8 @@ int Simulation::do_move(int i, int x, int y, float nxf, float nyf)
 		parts[i].y = nyf;
 		if (ny != y || nx != x)
 		{
+			// (the cell it arrives in is picked up by TrackActivity)
+			cellIdle[y / CELL][x / CELL] = 0;
 			if (ID(pmap[y][x]) == i)
 				pmap[y][x] = 0;
 			if (ID(photons[y][x]) == i)
@@ -2918,6 +3082,7 @@ int Simulation::do_move(int i, int x, int y, float nxf, float nyf)
 				photons[ny][nx] = PMAP(i, t);
 			else if (t)
 				pmap[ny][nx] = PMAP(i, t);
+			UpdatePartCell(i);
 		}
 	}
 	return result;
@@ -3105,6 +3270,7 @@ void Simulation::kill_part(int i) //kills particle number i
 	int y = (int)(parts[i].y + 0.5f);
 
 	int t = parts[i].type;
+	CheckReach(x, y);
 	if (t && elements[t].ChangeType)
 	{
 		(*(elements[t].ChangeType))(this, i, x, y, t, PT_NONE);
@@ -3116,17 +3282,19 @@ void Simulation::kill_part(int i) //kills particle number i
 			pmap[y][x] = 0;
 		else if (ID(photons[y][x]) == i)
 			photons[y][x] = 0;
+		cellIdle[y / CELL][x / CELL] = 0;
 	}
 
 	// This shouldn't happen but ... you never know?
 	if (t == PT_NONE)
 		return;
 
-	elementCount[t]--;
+	CountElement(t, -1);
 
 	parts[i].type = PT_NONE;
-	parts[i].life = pfree;
-	pfree = i;
+	UpdatePartCell(i);
+	UpdatePartList(i);
+	FreeParticle(i);
 }
 
 // Changes the type of particle number i, to t.  This also changes pmap at the same time
@@ -3135,6 +3303,7 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 {
 	if (x < 0 || y < 0 || x >= XRES || y >= YRES || i >= NPART || t < 0 || t >= PT_NUM || !parts[i].type)
 		return false;
+	CheckReach(x, y);
 	if (!elements[t].Enabled || t == PT_NONE)
 	{
 		kill_part(i);
@@ -3151,9 +3320,10 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 	if (elements[t].ChangeType)
 		(*(elements[t].ChangeType))(this, i, x, y, parts[i].type, t);
 
-	if (parts[i].type > 0 && parts[i].type < PT_NUM && elementCount[parts[i].type])
-		elementCount[parts[i].type]--;
-	elementCount[t]++;
+	// (a tile only knows the counts from the start of the frame)
+	if (parts[i].type > 0 && parts[i].type < PT_NUM && (currentTile || elementCount[parts[i].type]))
+		CountElement(parts[i].type, -1);
+	CountElement(t, 1);
 
 	parts[i].type = t;
 	if (elements[t].Properties & TYPE_ENERGY)
@@ -3168,6 +3338,8 @@ bool Simulation::part_change_type(int i, int x, int y, int t)
 		if (ID(photons[y][x]) == i)
 			photons[y][x] = 0;
 	}
+	UpdatePartCell(i);
+	UpdatePartList(i);
 	return false;
 }
 
@@ -3179,6 +3351,7 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 
 	if (x < 0 || y < 0 || x >= XRES || y >= YRES || t <= 0 || t >= PT_NUM || !elements[t].Enabled)
 		return -1;
+	CheckReach(x, y);
 
 	if (t == PT_SPRK && !(p == -2 && elements[TYP(pmap[y][x])].CtypeDraw))
 	{
@@ -3238,24 +3411,21 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 		{
 			return -1;
 		}
-		if (pfree == -1)
+		i = AllocParticle();
+		if (i == -1)
 			return -1;
-		i = pfree;
-		pfree = parts[i].life;
 	}
 	else if (p == -2) //creating from brush
 	{
-		if (pfree == -1)
+		i = AllocParticle();
+		if (i == -1)
 			return -1;
-		i = pfree;
-		pfree = parts[i].life;
 	}
 	else if (p == -3) //skip pmap checks, e.g. for sing explosion
 	{
-		if (pfree == -1)
+		i = AllocParticle();
+		if (i == -1)
 			return -1;
-		i = pfree;
-		pfree = parts[i].life;
 	}
 	else
 	{
@@ -3271,14 +3441,11 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 		if (elements[oldType].ChangeType)
 			(*(elements[oldType].ChangeType))(this, p, oldX, oldY, oldType, t);
 		if (oldType)
-			elementCount[oldType]--;
+			CountElement(oldType, -1);
 
 		i = p;
 	}
 
-	if (i > parts_lastActiveIndex)
-		parts_lastActiveIndex = i;
-
 	parts[i] = elements[t].DefaultProperties;
 	parts[i].type = t;
 	parts[i].x = (float)x;
@@ -3289,6 +3456,8 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 		photons[y][x] = PMAP(i, t);
 	else if (t != PT_STKM && t != PT_STKM2 && t != PT_FIGH)
 		pmap[y][x] = PMAP(i, t);
+	UpdatePartCell(i);
+	UpdatePartList(i);
 
 	//Fancy dust effects for powder types
 	if ((elements[t].Properties & TYPE_PART) && pretty_powder)
@@ -3310,7 +3479,7 @@ int Simulation::create_part(int p, int x, int y, int t, int v)
 	if (elements[t].ChangeType)
 		(*(elements[t].ChangeType))(this, i, x, y, oldType, t);
 
-	elementCount[t]++;
+	CountElement(t, 1);
 	return i;
 }
 
@@ -3341,10 +3510,6 @@ void Simulation::create_gain_photon(int pp) //photons from PHOT going through GL
 	float xx, yy;
 	int i, lr, temp_bin, nx, ny;
 
-	if (pfree == -1)
-		return;
-	i = pfree;
-
 	lr = RNG::Ref().between(0, 1);
 
 	if (lr)
@@ -3367,9 +3532,9 @@ void Simulation::create_gain_photon(int pp) //photons from PHOT going through GL
 	if (TYP(pmap[ny][nx]) != PT_GLOW)
 		return;
 
-	pfree = parts[i].life;
-	if (i > parts_lastActiveIndex)
-		parts_lastActiveIndex = i;
+	i = AllocParticle();
+	if (i == -1)
+		return;
 
 	parts[i].type = PT_PHOT;
 	parts[i].life = 680;
@@ -3381,6 +3546,8 @@ void Simulation::create_gain_photon(int pp) //photons from PHOT going through GL
 	parts[i].tmp = 0;
 	parts[i].pavg[0] = parts[i].pavg[1] = 0.0f;
 	photons[ny][nx] = PMAP(i, PT_PHOT);
+	UpdatePartCell(i);
+	UpdatePartList(i);
 
 	temp_bin = (int)((parts[i].temp - 273.0f) * 0.25f);
 	if (temp_bin < 0)
@@ -3395,10 +3562,6 @@ void Simulation::create_cherenkov_photon(int pp) //photons from NEUT going throu
 	int i, lr, nx, ny;
 	float r;
 
-	if (pfree == -1)
-		return;
-	i = pfree;
-
 	nx = (int)(parts[pp].x + 0.5f);
 	ny = (int)(parts[pp].y + 0.5f);
 	if (TYP(pmap[ny][nx]) != PT_GLAS && TYP(pmap[ny][nx]) != PT_BGLA)
@@ -3407,9 +3570,9 @@ void Simulation::create_cherenkov_photon(int pp) //photons from NEUT going throu
 	if (hypotf(parts[pp].vx, parts[pp].vy) < 1.44f)
 		return;
 
-	pfree = parts[i].life;
-	if (i > parts_lastActiveIndex)
-		parts_lastActiveIndex = i;
+	i = AllocParticle();
+	if (i == -1)
+		return;
 
 	lr = RNG::Ref().between(0, 1);
 
@@ -3422,6 +3585,8 @@ void Simulation::create_cherenkov_photon(int pp) //photons from NEUT going throu
 	parts[i].tmp = 0;
 	parts[i].pavg[0] = parts[i].pavg[1] = 0.0f;
 	photons[ny][nx] = PMAP(i, PT_PHOT);
+	UpdatePartCell(i);
+	UpdatePartList(i);
 
 	if (lr)
 	{
@@ -3460,7 +3625,8 @@ void Simulation::delete_part(int x, int y) //calls kill_part with the particle l
 	kill_part(ID(i));
 }
 
-void Simulation::UpdateParticles(int start, int end)
+// Updates parts[start..end], or parts[ids[start]]..parts[ids[end]] if ids is given
+void Simulation::UpdateParticleList(int const *ids, int start, int end)
 {
 	int i, j, x, y, t, nx, ny, r, surround_space, s, rt, nt;
 	float mv, dx, dy, nrx, nry, dp, ctemph, ctempl, gravtot;
@@ -3476,14 +3642,22 @@ void Simulation::UpdateParticles(int start, int end)
 	bool transitionOccurred;
 
 	//the main particle loop function, goes over all particles.
-	for (i = start; i <= end && i <= parts_lastActiveIndex; i++)
-		if (parts[i].type)
+	for (int n = start; n <= end && (ids || n <= parts_lastActiveIndex); n++)
+		if (parts[i = (ids ? ids[n] : n)].type)
 		{
 			t = parts[i].type;
 
 			x = (int)(parts[i].x + 0.5f);
 			y = (int)(parts[i].y + 0.5f);
 
+			if (currentTile && (x < currentTile->x0 || y < currentTile->y0 || x >= currentTile->x1 || y >= currentTile->y1 || NeedsSerialUpdate(i, x, y)))
+			{
+				// pushed out of its tile or changed into something that reaches further by
+				// a neighbour before its turn, leave it to the serial pass
+				currentTile->deferred.push_back(i);
+				continue;
+			}
+
 			//this kills any particle out of the screen, or in a wall where it isn't supposed to go
 			if (x < CELL || y < CELL || x >= XRES - CELL || y >= YRES - CELL ||
 				(bmap[y / CELL][x / CELL] &&
@@ -3508,6 +3682,9 @@ void Simulation::UpdateParticles(int start, int end)
 				continue;
 			}
 
+			if (cellAsleep[y / CELL][x / CELL])
+				continue;
+
 			if (bmap[y / CELL][x / CELL] == WL_DETECT && emap[y / CELL][x / CELL] < 8)
 				set_emap(x / CELL, y / CELL);
 
@@ -4480,8 +4657,9 @@ void Simulation::UpdateParticles(int start, int end)
 				// Checking stagnant is cool, but then it doesn't update when you change it later.
 				if (water_equal_test && elements[t].Falldown == 2 && RNG::Ref().chance(1, 200))
 				{
-					if (!flood_water(x, y, i))
-						goto movedone;
+					// Moving to the surface is this frame's move; x and y no longer say where it is
+					flood_water(x, y, i);
+					goto movedone;
 				}
 				// liquids and powders
 				if (!do_move(i, x, y, fin_xf, fin_yf))
@@ -4745,56 +4923,492 @@ void Simulation::UpdateParticles(int start, int end)
 		movedone:
 			continue;
 		}
+}
+
+void Simulation::UpdateParticles(int start, int end)
+{
+	ProfileScope profile(Profiler::UpdateParticles);
+	RNGScope rngScope(rng);
+	if (tiledUpdate && start == 0 && end >= NPART - 1)
+		UpdateParticlesTiled();
+	else
+		UpdateParticleList(nullptr, start, end);
 
 	//'f' was pressed (single frame)
 	if (framerender)
 		framerender--;
 }
 
-int Simulation::GetParticleType(ByteString type)
-{
-	char *txt = (char *)type.c_str();
+thread_local Simulation::UpdateTile *Simulation::currentTile = nullptr;
 
-	// alternative names for some elements
-	if (!strcasecmp(txt, "C4"))
-		return PT_PLEX;
-	else if (!strcasecmp(txt, "C5"))
-		return PT_C5;
-	else if (!strcasecmp(txt, "NONE"))
-		return PT_NONE;
-	for (int i = 1; i < PT_NUM; i++)
+// Tiles are this many pixels square. Tiles updated at the same time are at least
+// one tile apart, so a particle may reach up to half a tile outside its own.
+constexpr int UPDATE_TILE_SIZE = 64;
+// Particles faster than this could cross that margin in one frame
+constexpr float UPDATE_TILE_MAXSPEED = 12.0f;
+
+int Simulation::AllocParticle()
+{
+	int i;
+	if (currentTile)
 	{
-		if (!strcasecmp(txt, elements[i].Name.ToUtf8().c_str()) && elements[i].Name.size() && elements[i].Enabled)
+		UpdateTile &tile = *currentTile;
+		if (tile.freeHead != -1)
 		{
-			return i;
+			i = tile.freeHead;
+			tile.freeHead = parts[i].life;
+			if (tile.freeHead == -1)
+				tile.freeTail = -1;
+		}
+		else
+		{
+			if (tile.slotNext >= NPART)
+				return -1;
+			i = tile.slotNext;
+			tile.slotNext += tile.slotStride;
 		}
+		if (i > tile.lastActive)
+			tile.lastActive = i;
+		return i;
 	}
-	return -1;
+	if (pfree == -1)
+		return -1;
+	i = pfree;
+	pfree = parts[i].life;
+	if (i > parts_lastActiveIndex)
+		parts_lastActiveIndex = i;
+	return i;
 }
 
-void Simulation::RecalcFreeParticles(bool do_life_dec)
+void Simulation::FreeParticle(int i)
 {
-	int x, y, t;
-	int lastPartUsed = 0;
-	int lastPartUnused = -1;
+	if (currentTile)
+	{
+		UpdateTile &tile = *currentTile;
+		parts[i].life = tile.freeHead;
+		if (tile.freeHead == -1)
+			tile.freeTail = i;
+		tile.freeHead = i;
+		return;
+	}
+	parts[i].life = pfree;
+	pfree = i;
+}
 
-	memset(pmap, 0, sizeof(pmap));
-	memset(pmap_count, 0, sizeof(pmap_count));
-	memset(photons, 0, sizeof(photons));
+void Simulation::CountElement(int t, int change)
+{
+	if (currentTile)
+		currentTile->countChange[t] += change;
+	else
+		elementCount[t] += change;
+}
 
-	NUM_PARTS = 0;
-	//the particle loop that resets the pmap/photon maps every frame, to update them.
-	for (int i = 0; i <= parts_lastActiveIndex; i++)
-	{
+// Whether a particle may touch state outside the neighbourhood of its tile
+bool Simulation::NeedsSerialUpdate(int i, int x, int y)
+{
+	int t = parts[i].type;
+	int ct = parts[i].ctype;
+	if (serialUpdateOnly[t] || (ct > 0 && ct < PT_NUM && serialUpdateOnly[ct]))
+		return true;
+#if !defined(RENDERER) && defined(LUACONSOLE)
+	if (lua_el_mode[t])
+		return true;
+#endif
+	// SPRK can flood INST and PPIP networks and set off EMP anywhere on the screen
+	if (t == PT_SPRK && (elementCount[PT_INST] || elementCount[PT_PPIP] || elementCount[PT_EMP]))
+		return true;
+	// Energy particles going into PRTI are queued in portalp, which all portals share
+	if ((elements[t].Properties & TYPE_ENERGY) && elementCount[PT_PRTI])
+		return true;
+	if (water_equal_test && elements[t].Falldown == 2)
+		return true;
+	if (bmap[y / CELL][x / CELL] == WL_DETECT)
+		return true;
+	return fabsf(parts[i].vx) > UPDATE_TILE_MAXSPEED || fabsf(parts[i].vy) > UPDATE_TILE_MAXSPEED;
+}
+
+WorkerPool &Simulation::UpdatePool()
+{
+	if (!updatePool || updatePool->Size() != updateThreads)
+		updatePool.reset(new WorkerPool(updateThreads));
+	return *updatePool;
+}
+
+/*
+ * Updates particles on updateThreads threads. The field is cut into tiles, and
+ * tiles are updated in four passes so that tiles running at the same time are
+ * never next to each other. Particles that can reach further than the space
+ * between two tiles are updated serially after the passes, in index order.
+ *
+ * Everything a tile does depends only on the particles in and around it: each
+ * tile has its own random stream, keyed on rngSeed, the tick and the tile,
+ * and its own supply of free particle slots. The result therefore does not
+ * depend on the number of threads or on scheduling, and running with a single
+ * thread reproduces a multithreaded run exactly. It is not the same as the
+ * index order of the serial loop though, so this is an opt-in mode. With
+ * tiledUpdateCheck the serial loop runs instead, see CheckTiledUpdate.
+ */
+void Simulation::UpdateParticlesTiled()
+{
+	int tilesX = (XRES + UPDATE_TILE_SIZE - 1) / UPDATE_TILE_SIZE;
+	int tilesY = (YRES + UPDATE_TILE_SIZE - 1) / UPDATE_TILE_SIZE;
+	if (updateTiles.empty())
+	{
+		updateTiles.resize(tilesX * tilesY);
+		updateTileIndex.resize(tilesX * tilesY);
+		int k = 0;
+		for (int pass = 0; pass < 4; pass++)
+		{
+			updatePassStart[pass] = k;
+			for (int ty = pass / 2; ty < tilesY; ty += 2)
+				for (int tx = pass % 2; tx < tilesX; tx += 2)
+				{
+					UpdateTile &tile = updateTiles[k];
+					tile.x0 = tx * UPDATE_TILE_SIZE;
+					tile.y0 = ty * UPDATE_TILE_SIZE;
+					tile.x1 = std::min(tile.x0 + UPDATE_TILE_SIZE, XRES);
+					tile.y1 = std::min(tile.y0 + UPDATE_TILE_SIZE, YRES);
+					updateTileIndex[ty * tilesX + tx] = k++;
+				}
+		}
+		updatePassStart[4] = k;
+	}
+	WorkerPool &pool = UpdatePool();
+
+	// New particles are taken from the tail of parts past parts_lastActiveIndex,
+	// which is always free and chained in order. The first tail slot is kept back
+	// so that the shared free list stays intact, see below.
+	int stride = updateTiles.size();
+	int base = parts_lastActiveIndex + 1;
+	if (NPART - base < stride * 16)
+	{
+		UpdateParticleList(nullptr, 0, NPART - 1);
+		return;
+	}
+	for (int k = 0; k < stride; k++)
+	{
+		UpdateTile &tile = updateTiles[k];
+		tile.ids.clear();
+		tile.deferred.clear();
+		tile.freeHead = tile.freeTail = -1;
+		tile.slotNext = base + 1 + k;
+		tile.slotStride = stride;
+		tile.lastActive = -1;
+		tile.rng.seed(rngSeed, currentTick, k + 1);
+		tile.countChange.fill(0);
+	}
+
+	updateSerial.clear();
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		if (!parts[i].type)
+			continue;
+		int x = (int)(parts[i].x + 0.5f);
+		int y = (int)(parts[i].y + 0.5f);
+		if (x < 0 || y < 0 || x >= XRES || y >= YRES || NeedsSerialUpdate(i, x, y))
+			updateSerial.push_back(i);
+		else
+			updateTiles[updateTileIndex[(y / UPDATE_TILE_SIZE) * tilesX + x / UPDATE_TILE_SIZE]].ids.push_back(i);
+	}
+
+	if (tiledUpdateCheck)
+	{
+		CheckTiledUpdate();
+		return;
+	}
+
+	for (int pass = 0; pass < 4; pass++)
+	{
+		int first = updatePassStart[pass];
+		pool.Run(updatePassStart[pass + 1] - first, [this, first](int n) {
+			UpdateTile &tile = updateTiles[first + n];
+			currentTile = &tile;
+			RNGScope rngScope(tile.rng);
+			UpdateParticleList(tile.ids.data(), 0, int(tile.ids.size()) - 1);
+			currentTile = nullptr;
+		});
+	}
+
+	// Hand the tail slots the tiles didn't use back to the free list. Slot base
+	// was never given out, so whatever pointed at it before still does.
+	int slotEnd = base + 1;
+	for (int k = 0; k < stride; k++)
+		slotEnd = std::max(slotEnd, updateTiles[k].slotNext - stride + 1);
+	int prev = base;
+	for (int i = base + 1; i < slotEnd; i++)
+		if (i >= updateTiles[(i - base - 1) % stride].slotNext)
+		{
+			parts[prev].life = i;
+			prev = i;
+		}
+	parts[prev].life = slotEnd < NPART ? slotEnd : -1;
+
+	// Particles killed by tiles go in front, in tile order
+	for (int k = stride - 1; k >= 0; k--)
+	{
+		UpdateTile &tile = updateTiles[k];
+		if (tile.freeHead != -1)
+		{
+			parts[tile.freeTail].life = pfree;
+			pfree = tile.freeHead;
+		}
+		parts_lastActiveIndex = std::max(parts_lastActiveIndex, tile.lastActive);
+		for (int t = 0; t < PT_NUM; t++)
+			elementCount[t] += tile.countChange[t];
+		updateSerial.insert(updateSerial.end(), tile.deferred.begin(), tile.deferred.end());
+	}
+
+	std::sort(updateSerial.begin(), updateSerial.end());
+	UpdateParticleList(updateSerial.data(), 0, int(updateSerial.size()) - 1);
+}
+
+/*
+ * Updates particles in index order on the calling thread with the shared
+ * random stream and free list, which is exactly what the serial loop does, so
+ * a save plays out the same as with tiledUpdate off. Meanwhile every particle
+ * that UpdateParticlesTiled would have given to a tile is watched, and
+ * tiledUpdateOverreach goes up each time one moves, creates, kills, changes or
+ * flood fills particles further than half a tile outside its tile, or queues
+ * itself in portalp, which would make the tiled update depend on timing.
+ * Element functions that write to other particles directly are only seen
+ * if they call CheckReach, as PPIP's flood fill does.
+ */
+void Simulation::CheckTiledUpdate()
+{
+	updateTileOf.assign(NPART, -1);
+	for (int k = 0; k < int(updateTiles.size()); k++)
+		for (int i : updateTiles[k].ids)
+			updateTileOf[i] = k;
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		if (!parts[i].type)
+			continue;
+		checkTile = nullptr;
+		if (updateTileOf[i] >= 0)
+		{
+			UpdateTile &tile = updateTiles[updateTileOf[i]];
+			int x = (int)(parts[i].x + 0.5f);
+			int y = (int)(parts[i].y + 0.5f);
+			// Otherwise the tile would have left it to the serial pass, see UpdateParticleList
+			if (x >= tile.x0 && y >= tile.y0 && x < tile.x1 && y < tile.y1 && !NeedsSerialUpdate(i, x, y))
+				checkTile = &tile;
+		}
+		UpdateParticleList(&i, 0, 0);
+		if (parts[i].type)
+			CheckReach((int)(parts[i].x + 0.5f), (int)(parts[i].y + 0.5f));
+	}
+	checkTile = nullptr;
+}
+
+void Simulation::CheckReach(int x, int y)
+{
+	const int margin = UPDATE_TILE_SIZE / 2;
+	if (checkTile && (x < checkTile->x0 - margin || y < checkTile->y0 - margin || x >= checkTile->x1 + margin || y >= checkTile->y1 + margin))
+		tiledUpdateOverreach++;
+}
+
+int Simulation::GetParticleType(ByteString type)
+{
+	char *txt = (char *)type.c_str();
+
+	// alternative names for some elements
+	if (!strcasecmp(txt, "C4"))
+		return PT_PLEX;
+	else if (!strcasecmp(txt, "C5"))
+		return PT_C5;
+	else if (!strcasecmp(txt, "NONE"))
+		return PT_NONE;
+	for (int i = 1; i < PT_NUM; i++)
+	{
+		if (!strcasecmp(txt, elements[i].Name.ToUtf8().c_str()) && elements[i].Name.size() && elements[i].Enabled)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Encodes the cell a particle of type t at x, y is entered in: y*XRES+x, times four, plus
+// 0 if it is in pmap and counted in pmap_count, 1 if it is in pmap but not counted, 2 if it
+// is in photons. -1 for no particle or out of bounds.
+int Simulation::PartCellOf(int t, int x, int y)
+{
+	if (!t || x < 0 || y < 0 || x >= XRES || y >= YRES)
+		return -1;
+	int kind;
+	if (elements[t].Properties & TYPE_ENERGY)
+		kind = 2;
+	else if (t == PT_THDR || t == PT_EMBR || t == PT_FIGH || t == PT_PLSM)
+		kind = 1;
+	else
+		kind = 0;
+	return (y * XRES + x) * 4 + kind;
+}
+
+// Moves particle i's entry in pmap_count to cell, and clears the map entry it leaves
+// behind if that still points at it. Entering the new pmap/photons entry is left to
+// the caller, or to RecalcFreeParticles.
+void Simulation::MovePartCell(int i, int cell)
+{
+	int old = partCell[i];
+	if (old == cell)
+		return;
+	if (parts[i].type == PT_INST)
+		instNetwork.Invalidate();
+	if (old >= 0)
+	{
+		int oldPos = old / 4, oldKind = old % 4;
+		if (!oldKind)
+			(&pmap_count[0][0])[oldPos]--;
+		if (cell < 0 || oldPos != cell / 4 || (oldKind == 2) != (cell % 4 == 2))
+		{
+			int &r = oldKind == 2 ? (&photons[0][0])[oldPos] : (&pmap[0][0])[oldPos];
+			if (r && ID(r) == i)
+				r = 0;
+		}
+	}
+	if (cell >= 0 && !(cell % 4))
+		(&pmap_count[0][0])[cell / 4]++;
+	partCell[i] = cell;
+}
+
+// Called wherever a particle is created, killed, moved or changes type
+void Simulation::UpdatePartCell(int i)
+{
+	if (!incrementalPmap || pmapRebuild)
+		return;
+	MovePartCell(i, PartCellOf(parts[i].type, (int)(parts[i].x + 0.5f), (int)(parts[i].y + 0.5f)));
+}
+
+// Moves particle i to the list of its current type. Called wherever a particle is created, killed
+// or changes type, except by threads of a tiled update; RecalcFreeParticles catches up on those.
+void Simulation::UpdatePartList(int i)
+{
+	int t = parts[i].type;
+	if (currentTile || partListType[i] == t)
+		return;
+	// SPRK on INST still conducts for INST, so sparking and recharging keep the runs.
+	// SPRK turning into INST was on INST, though it clears its ctype before that.
+	auto conductsForInst = [this, i](int type) {
+		return type == PT_INST || (type == PT_SPRK && parts[i].ctype == PT_INST);
+	};
+	if (!(partListType[i] == PT_SPRK && t == PT_INST) && conductsForInst(partListType[i]) != conductsForInst(t))
+		instNetwork.Invalidate();
+	if (partListType[i])
+	{
+		auto &list = partLists[partListType[i]];
+		int last = list.back();
+		if (last != i)
+		{
+			list[partListIndex[i]] = last;
+			partListIndex[last] = partListIndex[i];
+			partListSorted[partListType[i]] = false;
+		}
+		list.pop_back();
+	}
+	partListType[i] = t;
+	if (t)
+	{
+		auto &list = partLists[t];
+		if (list.size() && list.back() > i)
+			partListSorted[t] = false;
+		partListIndex[i] = list.size();
+		list.push_back(i);
+		partListEnd = std::max(partListEnd, i + 1);
+	}
+}
+
+std::vector<int> const &Simulation::ElementParts(int t)
+{
+	auto &list = partLists[t];
+	if (!partListSorted[t])
+	{
+		std::sort(list.begin(), list.end());
+		for (int k = 0; k < int(list.size()); k++)
+			partListIndex[list[k]] = k;
+		partListSorted[t] = true;
+	}
+	return list;
+}
+
+// Enters particle i in pmap or photons at x, y the same way a full rebuild would. A full rebuild
+// leaves the highest numbered particle in photons and in pmap, except that INVS and FILT only
+// take an empty pmap entry. Both rules pick a particle regardless of the order they are
+// applied in, so they can be applied on top of an existing entry as long as that entry
+// still describes a particle in the same spot.
+void Simulation::ReconcilePmap(int i, int t, int x, int y)
+{
+	bool energy = elements[t].Properties & TYPE_ENERGY;
+	int &r = energy ? photons[y][x] : pmap[y][x];
+	if (r == PMAP(i, t))
+		return;
+	if (r)
+	{
+		int j = ID(r);
+		bool better;
+		if (energy)
+			better = j < i;
+		else
+		{
+			bool solid = t != PT_INVIS && t != PT_FILT;
+			bool otherSolid = TYP(r) != PT_INVIS && TYP(r) != PT_FILT;
+			better = solid != otherSolid ? solid : (solid ? j < i : j > i);
+		}
+		if (!better && j != i && parts[j].type == TYP(r) && (int)(parts[j].x + 0.5f) == x && (int)(parts[j].y + 0.5f) == y)
+			return;
+	}
+	r = PMAP(i, t);
+}
+
+void Simulation::RecalcFreeParticles(bool do_life_dec)
+{
+	ProfileScope profile(Profiler::RecalcFreeParticles);
+	int x, y, t;
+	int lastPartUsed = 0;
+	int lastPartUnused = -1;
+
+	// In incremental mode the maps are already up to date except for particles that were
+	// moved or retyped by writing to parts directly; the loop below catches up on those.
+	bool rebuild = pmapRebuild || !incrementalPmap;
+	if (rebuild)
+	{
+		memset(pmap, 0, sizeof(pmap));
+		memset(pmap_count, 0, sizeof(pmap_count));
+		memset(photons, 0, sizeof(photons));
+		if (incrementalPmap)
+			std::fill(partCell, partCell + NPART, -1);
+		// Moves aren't tracked either
+		instNetwork.Invalidate();
+	}
+	pmapRebuild = !incrementalPmap;
+
+	NUM_PARTS = 0;
+	//the particle loop that resets the pmap/photon maps every frame, to update them.
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
 		if (parts[i].type)
 		{
 			t = parts[i].type;
 			x = (int)(parts[i].x + 0.5f);
 			y = (int)(parts[i].y + 0.5f);
 			bool inBounds = false;
+			if (incrementalPmap)
+			{
+				int cell = PartCellOf(t, x, y);
+				if (rebuild)
+				{
+					partCell[i] = cell;
+					if (cell >= 0 && !(cell % 4))
+						pmap_count[y][x]++;
+				}
+				else if (cell != partCell[i])
+					MovePartCell(i, cell);
+			}
 			if (x >= 0 && y >= 0 && x < XRES && y < YRES)
 			{
-				if (elements[t].Properties & TYPE_ENERGY)
+				if (!rebuild)
+					ReconcilePmap(i, t, x, y);
+				else if (elements[t].Properties & TYPE_ENERGY)
 					photons[y][x] = PMAP(i, t);
 				else
 				{
@@ -4803,7 +5417,7 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 					if (!pmap[y][x] || (t != PT_INVIS && t != PT_FILT))
 						pmap[y][x] = PMAP(i, t);
 					// (there are a few exceptions, including energy particles - currently no limit on stacking those)
-					if (t != PT_THDR && t != PT_EMBR && t != PT_FIGH && t != PT_PLSM)
+					if (!incrementalPmap && t != PT_THDR && t != PT_EMBR && t != PT_FIGH && t != PT_PLSM)
 						pmap_count[y][x]++;
 				}
 				inBounds = true;
@@ -4842,9 +5456,18 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 					continue;
 				}
 			}
+			if (sleepEnabled && inBounds)
+				TrackActivity(i, x, y);
+			if (partListType[i] != t)
+				UpdatePartList(i);
 		}
 		else
 		{
+			// (set to PT_NONE without kill_part)
+			if (!rebuild && partCell[i] >= 0)
+				MovePartCell(i, -1);
+			if (partListType[i])
+				UpdatePartList(i);
 			if (lastPartUnused < 0)
 				pfree = i;
 			else
@@ -4866,81 +5489,328 @@ void Simulation::RecalcFreeParticles(bool do_life_dec)
 		else
 			parts[lastPartUnused].life = parts_lastActiveIndex + 1;
 	}
+	// Slots past the end of the loop can still be listed if clear_sim, Restore or
+	// CompactParticles lowered parts_lastActiveIndex
+	for (int i = parts_lastActiveIndex + 1; i < partListEnd; i++)
+		if (partListType[i])
+			UpdatePartList(i);
+	partListEnd = std::min(partListEnd, parts_lastActiveIndex + 1);
 	parts_lastActiveIndex = lastPartUsed;
 	if (elementRecount && (!sys_pause || framerender))
 		elementRecount = false;
+#ifdef DEBUG
+	// Particles killed above can leave pmap entries that a rebuild would fill, so only check when nothing died
+	if (!rebuild && !(do_life_dec && (!sys_pause || framerender)))
+		assert(ValidatePmap() && "pmap differs from a rebuild, see pmapMismatch");
+#endif
+}
+
+// Moves every particle into the lowest free slot it can have without changing the order
+// of particles, so that parts_lastActiveIndex drops to the number of particles. Order
+// decides which particle ends up in pmap and photons, so those and partCell only need
+// their IDs changed. Everything else known to hold particle IDs is updated too; for
+// anything else, such as Lua scripts, compactMap maps old IDs to new ones. Returns the
+// number of particles moved.
+int Simulation::CompactParticles()
+{
+	int end = parts_lastActiveIndex + 1;
+	int moved = 0, n = 0;
+	std::vector<int> newIDs(end, -1);
+	for (int i = 0; i < end; i++)
+	{
+		if (!parts[i].type)
+			continue;
+		newIDs[i] = n;
+		if (i != n)
+		{
+			parts[n] = parts[i];
+			partCell[n] = partCell[i];
+			sleepHash[n] = sleepHash[i];
+			sleepTemp[n] = sleepTemp[i];
+			moved++;
+		}
+		n++;
+	}
+	// The map from the last compaction that did anything stays for Lua to use
+	if (!moved)
+		return 0;
+	compactMap.swap(newIDs);
+
+	// Same free list RecalcFreeParticles would make for empty slots past the last particle
+	for (int i = n; i < end; i++)
+	{
+		parts[i].type = PT_NONE;
+		parts[i].life = i + 1;
+		partCell[i] = -1;
+	}
+	if (end == NPART)
+		parts[NPART - 1].life = -1;
+	pfree = n < NPART ? n : -1;
+	parts_lastActiveIndex = n ? n - 1 : 0;
+
+	auto remap = [this](int &r) {
+		if (r)
+		{
+			int i = ID(r) < int(compactMap.size()) ? compactMap[ID(r)] : -1;
+			r = i >= 0 ? PMAP(i, TYP(r)) : 0;
+		}
+	};
+	for (int y = 0; y < YRES; y++)
+		for (int x = 0; x < XRES; x++)
+		{
+			remap(pmap[y][x]);
+			remap(photons[y][x]);
+		}
+
+	auto remapID = [this](int id) {
+		return id >= 0 && id < int(compactMap.size()) ? compactMap[id] : -1;
+	};
+	// SOAP links to a particle that is gone are dropped, as the slot may now hold another SOAP
+	for (int i = 0; i < n; i++)
+	{
+		if (parts[i].type != PT_SOAP)
+			continue;
+		if (parts[i].ctype & 2)
+		{
+			parts[i].tmp = remapID(parts[i].tmp);
+			if (parts[i].tmp < 0)
+			{
+				parts[i].tmp = 0;
+				parts[i].ctype &= ~2;
+			}
+		}
+		if (parts[i].ctype & 4)
+		{
+			parts[i].tmp2 = remapID(parts[i].tmp2);
+			if (parts[i].tmp2 < 0)
+			{
+				parts[i].tmp2 = 0;
+				parts[i].ctype &= ~4;
+			}
+		}
+	}
+	if (player.spawnID >= 0)
+		player.spawnID = remapID(player.spawnID);
+	if (player2.spawnID >= 0)
+		player2.spawnID = remapID(player2.spawnID);
+
+	compactions++;
+	return moved;
+}
+
+// Compares pmap, photons and pmap_count with a full rebuild from parts, and describes
+// the first difference found in pmapMismatch. Returns true if they match.
+bool Simulation::ValidatePmap()
+{
+	validPmap.assign(XRES * YRES, 0);
+	validPhotons.assign(XRES * YRES, 0);
+	validCount.assign(XRES * YRES, 0);
+	pmapMismatch.clear();
+	for (int i = 0; i <= parts_lastActiveIndex; i++)
+	{
+		int t = parts[i].type;
+		int x = (int)(parts[i].x + 0.5f);
+		int y = (int)(parts[i].y + 0.5f);
+		if (!t || x < 0 || y < 0 || x >= XRES || y >= YRES)
+			continue;
+		if (elements[t].Properties & TYPE_ENERGY)
+			validPhotons[y * XRES + x] = PMAP(i, t);
+		else
+		{
+			if (!validPmap[y * XRES + x] || (t != PT_INVIS && t != PT_FILT))
+				validPmap[y * XRES + x] = PMAP(i, t);
+			if (t != PT_THDR && t != PT_EMBR && t != PT_FIGH && t != PT_PLSM)
+				validCount[y * XRES + x]++;
+		}
+	}
+	for (int y = 0; y < YRES; y++)
+	{
+		for (int x = 0; x < XRES; x++)
+		{
+			char const *map = nullptr;
+			long long have, want;
+			if (pmap[y][x] != validPmap[y * XRES + x])
+			{
+				map = "pmap";
+				have = pmap[y][x];
+				want = validPmap[y * XRES + x];
+			}
+			else if (photons[y][x] != validPhotons[y * XRES + x])
+			{
+				map = "photons";
+				have = photons[y][x];
+				want = validPhotons[y * XRES + x];
+			}
+			else if (pmap_count[y][x] != validCount[y * XRES + x])
+			{
+				map = "pmap_count";
+				have = pmap_count[y][x];
+				want = validCount[y * XRES + x];
+			}
+			if (map)
+			{
+				pmapMismatch = ByteString::Build(map, " at ", x, ", ", y, " is ", have, ", rebuilt ", want);
+				return false;
+			}
+		}
+	}
+	return true;
 }
 
 void Simulation::SimulateGoL()
 {
+	ProfileScope profile(Profiler::SimulateGoL);
 	CGOL = 0;
-	for (int i = 0; i <= parts_lastActiveIndex; ++i)
+	if (golGenerations > 1 && SimulateGoLTiles())
+	{
+		return;
+	}
+	for (int generation = 0; generation < std::max(golGenerations, 1); ++generation)
+	{
+		StepGoL();
+	}
+}
+
+// Runs golGenerations generations on golTiles, if that leaves the same cells alive as running
+// them one at a time: nothing but LIFE of one two state rule without B0, all of it alive and
+// the same colour, nothing stacked and no walls to stop cells being born. Returns false
+// without touching anything otherwise, or if running them one at a time would have run out of
+// particles. Cells end up the same but particles may end up in other slots.
+bool Simulation::SimulateGoLTiles()
+{
+	for (int t = 1; t < PT_NUM; ++t)
+	{
+		if (t != PT_LIFE && elementCount[t])
+		{
+			return false;
+		}
+	}
+	for (int y = 0; y < YRES / CELL; ++y)
+	{
+		for (int x = 0; x < XRES / CELL; ++x)
+		{
+			if (bmap[y][x])
+			{
+				return false;
+			}
+		}
+	}
+	bool first = true;
+	int ctype = 0, tmp = 0;
+	unsigned int dcolour = 0;
+	int population = 0, outside = 0;
+	for (int i : partLists[PT_LIFE])
 	{
 		auto &part = parts[i];
 		if (part.type != PT_LIFE)
 		{
-			continue;
+			return false;
 		}
 		auto x = int(part.x + 0.5f);
 		auto y = int(part.y + 0.5f);
 		if (x < CELL || y < CELL || x >= XRES - CELL || y >= YRES - CELL)
 		{
+			// * Left alone by SimulateGoL as well.
+			outside += 1;
 			continue;
 		}
-		unsigned int golnum = part.ctype;
-		unsigned int ruleset = golnum;
-		if (golnum < NGOL)
+		if (first)
 		{
-			ruleset = builtinGol[golnum].ruleset;
-			golnum += 1;
+			ctype = part.ctype;
+			dcolour = part.dcolour;
+			tmp = part.tmp;
+			unsigned int ruleset = ctype;
+			if (ruleset < NGOL)
+			{
+				ruleset = builtinGol[ruleset].ruleset;
+			}
+			if (((ruleset >> 17) & 0xF) || (ruleset & 0x100))
+			{
+				return false;
+			}
+			golTiles.Clear(ruleset);
+			first = false;
 		}
-		if (part.tmp2 == int((ruleset >> 17) & 0xF) + 1)
+		if (part.ctype != ctype || part.tmp2 != 1 || part.dcolour != dcolour || part.tmp != tmp)
 		{
-			for (int yy = -1; yy <= 1; ++yy)
+			return false;
+		}
+		if (pmap[y][x] != PMAP(i, PT_LIFE) || golTiles.Get(x - CELL, y - CELL))
+		{
+			return false;
+		}
+		golTiles.Set(x - CELL, y - CELL);
+		population += 1;
+	}
+	if (first)
+	{
+		return false;
+	}
+	for (int generation = 0; generation < golGenerations; ++generation)
+	{
+		// * StepGoL creates cells before it kills any.
+		if (outside + population + golTiles.Step() >= NPART)
+		{
+			return false;
+		}
+		population = golTiles.Population();
+	}
+	// * Same order as StepGoL: new cells first, then dead ones, both in pmap scan order.
+	for (int y = CELL; y < YRES - CELL; ++y)
+	{
+		for (int x = CELL; x < XRES - CELL; ++x)
+		{
+			if (!pmap[y][x] && golTiles.Get(x - CELL, y - CELL))
 			{
-				for (int xx = -1; xx <= 1; ++xx)
+				int i = create_part(-1, x, y, PT_LIFE, ctype | 0x200000);
+				if (i >= 0)
 				{
-					if (xx || yy)
-					{
-						// * Calculate address of the neighbourList, taking wraparound
-						//   into account. The fact that the GOL space is 2 CELL's worth
-						//   narrower in both dimensions than the simulation area makes
-						//   this a bit awkward.
-						int ax = ((x + xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
-						int ay = ((y + yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
-						unsigned int(&neighbourList)[5] = gol[ay][ax];
-						// * Bump overall neighbour counter (bits 30..28) for the entire list.
-						neighbourList[0] += 1U << 28;
-						for (int l = 0; l < 5; ++l)
-						{
-							auto neighbourRuleset = neighbourList[l] & 0x001FFFFFU;
-							if (neighbourRuleset == golnum)
-							{
-								// * Bump population counter (bits 23..21) of the
-								//   same kind of cell.
-								neighbourList[l] += 1U << 21;
-								break;
-							}
-							if (neighbourRuleset == 0)
-							{
-								// * Add the new kind of cell to the population. Both counters
-								//   have a bias of -1, so they're intentionally initialised
-								//   to 0 instead of 1 here. This is all so they can both
-								//   fit in 3 bits.
-								neighbourList[l] = ((yy & 3) << 26) | ((xx & 3) << 24) | golnum;
-								break;
-							}
-							// * If after 5 iterations the cell still hasn't contributed
-							//   to a list entry, it's surely a 6th kind of cell, meaning
-							//   there could be at most 3 of it in the neighbourhood,
-							//   as there are already 5 other kinds of cells present in
-							//   the list. This in turn means that it couldn't possibly
-							//   win the population ratio-based contest later on.
-						}
-					}
+					parts[i].dcolour = dcolour;
+					parts[i].tmp = tmp;
 				}
 			}
 		}
+	}
+	for (int y = CELL; y < YRES - CELL; ++y)
+	{
+		for (int x = CELL; x < XRES - CELL; ++x)
+		{
+			if (pmap[y][x] && !golTiles.Get(x - CELL, y - CELL))
+			{
+				kill_part(ID(pmap[y][x]));
+			}
+		}
+	}
+	return true;
+}
+
+void Simulation::StepGoL()
+{
+	golBoard.Clear();
+	// * Neither this nor collecting dead cells below depends on the order
+	//   particles are visited in, so the list needn't be sorted.
+	for (int i : partLists[PT_LIFE])
+	{
+		auto &part = parts[i];
+		if (part.type != PT_LIFE)
+		{
+			continue;
+		}
+		auto x = int(part.x + 0.5f);
+		auto y = int(part.y + 0.5f);
+		if (x < CELL || y < CELL || x >= XRES - CELL || y >= YRES - CELL)
+		{
+			continue;
+		}
+		unsigned int ruleset = part.ctype;
+		if (ruleset < NGOL)
+		{
+			ruleset = builtinGol[ruleset].ruleset;
+		}
+		if (part.tmp2 == int((ruleset >> 17) & 0xF) + 1)
+		{
+			golBoard.Set(golBoard.Kind(part.ctype), x - CELL, y - CELL);
+		}
 		else
 		{
 			if (!(bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8))
@@ -4949,101 +5819,112 @@ void Simulation::SimulateGoL()
 			}
 		}
 	}
-	for (int y = CELL; y < YRES - CELL; ++y)
-	{
-		for (int x = CELL; x < XRES - CELL; ++x)
+	// * Only cells the boards say may be born or die this generation need
+	//   looking at, everything else stays as it is.
+	golBoard.Step();
+	golBoard.ForCandidates([this](int gx, int gy) {
+		int x = gx + CELL;
+		int y = gy + CELL;
+		int r = pmap[y][x];
+		if (r && TYP(r) != PT_LIFE)
 		{
-			int r = pmap[y][x];
-			if (r && TYP(r) != PT_LIFE)
+			return;
+		}
+		if (bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8)
+		{
+			return;
+		}
+		unsigned int neighbours = golBoard.Neighbours(gx, gy);
+		if (r)
+		{
+			auto &part = parts[ID(r)];
+			unsigned int ruleset = part.ctype;
+			if (ruleset < NGOL)
+			{
+				ruleset = builtinGol[ruleset].ruleset;
+			}
+			if (!((ruleset >> neighbours) & 1) && part.tmp2 == int(ruleset >> 17) + 1)
+			{
+				// * Start death sequence.
+				part.tmp2 -= 1;
+			}
+			return;
+		}
+		// * The kind with the lowest ctype that is born with this many neighbours
+		//   and makes up at least half of them takes the cell.
+		unsigned int majority = neighbours / 2 + neighbours % 2;
+		for (int c = 0; c < golBoard.KindCount(); ++c)
+		{
+			int kind = golBoard.Contender(c);
+			unsigned int golnum = golBoard.CType(kind);
+			unsigned int ruleset = golnum;
+			if (golnum < NGOL)
+			{
+				ruleset = builtinGol[golnum].ruleset;
+			}
+			if (!((ruleset >> (neighbours + 8)) & 1))
 			{
 				continue;
 			}
-			unsigned int(&neighbourList)[5] = gol[y][x];
-			auto nl0 = neighbourList[0];
-			if (r || nl0)
+			unsigned int population = golBoard.Neighbours(kind, gx, gy);
+			if (!population || population < majority)
 			{
-				// * Get overall neighbour count (bits 30..28).
-				unsigned int neighbours = nl0 ? ((nl0 >> 28) & 7) + 1 : 0;
-				if (!(bmap[y / CELL][x / CELL] == WL_STASIS && emap[y / CELL][x / CELL] < 8))
+				continue;
+			}
+			// * Colours come from the oldest (lowest index) neighbour of that kind.
+			int sample = -1;
+			for (int yy = -1; yy <= 1; ++yy)
+			{
+				for (int xx = -1; xx <= 1; ++xx)
 				{
-					if (r)
+					int ax = (gx + xx + GOLBoard::width) % GOLBoard::width;
+					int ay = (gy + yy + GOLBoard::height) % GOLBoard::height;
+					if ((xx || yy) && golBoard.Alive(kind, ax, ay))
 					{
-						auto &part = parts[ID(r)];
-						unsigned int ruleset = part.ctype;
-						if (ruleset < NGOL)
-						{
-							ruleset = builtinGol[ruleset].ruleset;
-						}
-						if (!((ruleset >> neighbours) & 1) && part.tmp2 == int(ruleset >> 17) + 1)
-						{
-							// * Start death sequence.
-							part.tmp2 -= 1;
-						}
-					}
-					else
-					{
-						unsigned int golnumToCreate = 0xFFFFFFFFU;
-						unsigned int createFromEntry = 0U;
-						unsigned int majority = neighbours / 2 + neighbours % 2;
-						for (int l = 0; l < 5; ++l)
-						{
-							auto golnum = neighbourList[l] & 0x001FFFFFU;
-							if (!golnum)
-							{
-								break;
-							}
-							auto ruleset = golnum;
-							if (golnum - 1 < NGOL)
-							{
-								ruleset = builtinGol[golnum - 1].ruleset;
-								golnum -= 1;
-							}
-							if ((ruleset >> (neighbours + 8)) & 1 && ((neighbourList[l] >> 21) & 7) + 1 >= majority && golnum < golnumToCreate)
-							{
-								golnumToCreate = golnum;
-								createFromEntry = neighbourList[l];
-							}
-						}
-						if (golnumToCreate != 0xFFFFFFFFU)
+						int s = ID(pmap[ay + CELL][ax + CELL]);
+						if (sample < 0 || s < sample)
 						{
-							// * 0x200000: No need to look for colours, they'll be set later anyway.
-							int i = create_part(-1, x, y, PT_LIFE, golnumToCreate | 0x200000);
-							int xx = (createFromEntry >> 24) & 3;
-							int yy = (createFromEntry >> 26) & 3;
-							if (xx == 3)
-								xx = -1;
-							if (yy == 3)
-								yy = -1;
-							int ax = ((x - xx + XRES - 3 * CELL) % (XRES - 2 * CELL)) + CELL;
-							int ay = ((y - yy + YRES - 3 * CELL) % (YRES - 2 * CELL)) + CELL;
-							auto &sample = parts[ID(pmap[ay][ax])];
-							parts[i].dcolour = sample.dcolour;
-							parts[i].tmp = sample.tmp;
+							sample = s;
 						}
 					}
 				}
-				for (int l = 0; l < 5 && neighbourList[l]; ++l)
-				{
-					neighbourList[l] = 0;
-				}
 			}
+			// * 0x200000: No need to look for colours, they'll be set later anyway.
+			int i = create_part(-1, x, y, PT_LIFE, golnum | 0x200000);
+			if (i >= 0)
+			{
+				parts[i].dcolour = parts[sample].dcolour;
+				parts[i].tmp = parts[sample].tmp;
+			}
+			break;
 		}
-	}
-	for (int y = CELL; y < YRES - CELL; ++y)
+	});
+	// * Kill in the order a scan over pmap would find the cells, which is the
+	//   order their slots are handed out again.
+	golDead.clear();
+	for (int i : partLists[PT_LIFE])
 	{
-		for (int x = CELL; x < XRES - CELL; ++x)
+		if (parts[i].tmp2 > 0)
 		{
-			int r = pmap[y][x];
-			if (r && TYP(r) == PT_LIFE && parts[ID(r)].tmp2 <= 0)
-			{
-				kill_part(ID(r));
-			}
+			continue;
+		}
+		auto x = int(parts[i].x + 0.5f);
+		auto y = int(parts[i].y + 0.5f);
+		if (x >= CELL && y >= CELL && x < XRES - CELL && y < YRES - CELL && pmap[y][x] == PMAP(i, PT_LIFE))
+		{
+			golDead.push_back(y * XRES + x);
 		}
 	}
+	std::sort(golDead.begin(), golDead.end());
+	for (int pos : golDead)
+	{
+		kill_part(ID(pmap[pos / XRES][pos % XRES]));
+	}
 }
 
 void Simulation::CheckStacking()
 {
+	ProfileScope profile(Profiler::CheckStacking);
 	bool excessive_stacking_found = false;
 	force_stacking_check = false;
 	for (int y = 0; y < YRES; y++)
@@ -5073,6 +5954,8 @@ void Simulation::CheckStacking()
 	}
 	if (excessive_stacking_found)
 	{
+		// pmap_count now holds the marks above, so it is rebuilt next frame
+		pmapRebuild = true;
 		for (int i = 0; i <= parts_lastActiveIndex; i++)
 		{
 			if (parts[i].type)
@@ -5104,18 +5987,118 @@ void Simulation::CheckStacking()
 	}
 }
 
+// Marks the cell of particle i as active if the particle moved, changed or heated up or
+// cooled down noticeably since the last time it did. Elements in serialUpdateOnly can reach
+// far outside their own cell and stickmen follow player input, so those are always active,
+// and so are elements with Lua update functions.
+void Simulation::TrackActivity(int i, int x, int y)
+{
+	Particle const &part = parts[i];
+	unsigned int position[2];
+	std::memcpy(position, &part.x, sizeof(float));
+	std::memcpy(position + 1, &part.y, sizeof(float));
+	unsigned int hash = 2166136261U;
+	for (unsigned int value : { unsigned(part.type), unsigned(part.life), unsigned(part.ctype), unsigned(part.tmp), unsigned(part.tmp2), unsigned(part.flags), position[0], position[1] })
+		hash = (hash ^ value) * 16777619U;
+	bool alwaysActive = serialUpdateOnly[part.type];
+#if !defined(RENDERER) && defined(LUACONSOLE)
+	if (lua_el_mode[part.type])
+		alwaysActive = true;
+#endif
+	if (hash != sleepHash[i] || std::abs(part.temp - sleepTemp[i]) > SLEEP_TEMP_DELTA || alwaysActive)
+	{
+		sleepHash[i] = hash;
+		sleepTemp[i] = part.temp;
+		cellIdle[y / CELL][x / CELL] = 0;
+	}
+}
+
+// Decides which cells are asleep this frame: those where neither the cell nor any of its
+// neighbours has seen activity in the last SLEEP_FRAMES frames. Activity is noted in cellIdle
+// by TrackActivity, kill_part, do_move, the air and heat updates, tools and walls.
+void Simulation::UpdateSleep()
+{
+	if (!sleepEnabled)
+	{
+		if (sleepActive)
+		{
+			memset(cellAsleep, 0, sizeof(cellAsleep));
+			sleepActive = false;
+		}
+		return;
+	}
+	std::array<int, 8> settings = {{ gravityMode, edgeMode, legacy_enable, aheat_enable, water_equal_test, air->airMode, grav->IsEnabled(), (int)air->ambientAirTemp }};
+	if (!sleepActive || settings != sleepSettings)
+	{
+		WakeAll();
+		sleepSettings = settings;
+		sleepActive = true;
+	}
+	for (int y = 0; y < YRES / CELL; y++)
+	{
+		for (int x = 0; x < XRES / CELL; x++)
+		{
+			bool asleep = true;
+			for (int ny = std::max(y - 1, 0); asleep && ny <= std::min(y + 1, YRES / CELL - 1); ny++)
+				for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, XRES / CELL - 1); nx++)
+					if (cellIdle[ny][nx] < SLEEP_FRAMES)
+					{
+						asleep = false;
+						break;
+					}
+			cellAsleep[y][x] = asleep;
+		}
+	}
+	for (int y = 0; y < YRES / CELL; y++)
+		for (int x = 0; x < XRES / CELL; x++)
+			if (cellIdle[y][x] < 255)
+				cellIdle[y][x]++;
+}
+
+void Simulation::WakeCell(int x, int y)
+{
+	if (x >= 0 && y >= 0 && x < XRES && y < YRES)
+		cellIdle[y / CELL][x / CELL] = 0;
+}
+
+void Simulation::WakeAll()
+{
+	memset(cellIdle, 0, sizeof(cellIdle));
+	memset(cellAsleep, 0, sizeof(cellAsleep));
+}
+
 //updates pmap, gol, and some other simulation stuff (but not particles)
 void Simulation::BeforeSim()
 {
+	ProfileScope profile(Profiler::BeforeSim);
+	RNGScope rngScope(rng);
 	if (!sys_pause || framerender)
 	{
-		air->update_air();
+		currentTick++;
+		rng.seed(rngSeed, currentTick, 0);
+		UpdateSleep();
+		liquidBodies.Invalidate();
 
-		if (aheat_enable)
-			air->update_airh();
+		air->gravityMode = gravityMode;
+		if (pipelineAir)
+		{
+			// particles this frame see the air from the update started last frame
+			airPipeline->Finish();
+			airPipeline->Start(aheat_enable);
+		}
+		else
+		{
+			airPipeline->Discard();
+			air->pool = updateThreads > 1 ? &UpdatePool() : nullptr;
+			air->update_air();
+
+			if (aheat_enable)
+				air->update_airh();
+		}
 
 		if (grav->IsEnabled())
 		{
+			ProfileScope profile(Profiler::GravityHandoff);
 			grav->gravity_update_async();
 
 			//Get updated buffer pointers for gravity
@@ -5131,8 +6114,6 @@ void Simulation::BeforeSim()
 		etrd_count_valid = false;
 		etrd_life0_count = 0;
 
-		currentTick++;
-
 		elementRecount |= !(currentTick % 180);
 		if (elementRecount)
 			std::fill(elementCount, elementCount + PT_NUM, 0);
@@ -5147,7 +6128,13 @@ void Simulation::BeforeSim()
 	}
 
 	if (debug_currentParticle == 0)
+	{
+		// Worth doing whenever paused, otherwise only once the gaps take up most of parts
+		int gaps = parts_lastActiveIndex + 1 - NUM_PARTS;
+		if (compactParticles && (sys_pause && !framerender ? gaps > 0 : gaps > NUM_PARTS && gaps > NPART / 16))
+			CompactParticles();
 		RecalcFreeParticles(true);
+	}
 
 	if (!sys_pause || framerender)
 	{
@@ -5158,7 +6145,10 @@ void Simulation::BeforeSim()
 			for (x = 0; x < XRES / CELL; x++)
 			{
 				if (emap[y][x])
+				{
 					emap[y][x]--;
+					cellIdle[y][x] = 0;
+				}
 				air->bmap_blockair[y][x] = (bmap[y][x] == WL_WALL || bmap[y][x] == WL_WALLELEC || bmap[y][x] == WL_BLOCKAIR || (bmap[y][x] == WL_EWALL && !emap[y][x]));
 				air->bmap_blockairh[y][x] = (bmap[y][x] == WL_WALL || bmap[y][x] == WL_WALLELEC || bmap[y][x] == WL_BLOCKAIR || bmap[y][x] == WL_GRAV || (bmap[y][x] == WL_EWALL && !emap[y][x])) ? 0x8 : 0;
 			}
@@ -5173,26 +6163,25 @@ void Simulation::BeforeSim()
 		// LOVE and LOLZ element handling
 		if (elementCount[PT_LOVE] > 0 || elementCount[PT_LOLZ] > 0)
 		{
-			int nx, nnx, ny, nny, r, rt;
-			for (ny = 0; ny < YRES - 4; ny++)
+			int nx, nnx, ny, nny, rt;
+			for (int t : { PT_LOVE, PT_LOLZ })
 			{
-				for (nx = 0; nx < XRES - 4; nx++)
+				auto &ids = ElementParts(t);
+				// Backwards, as killing a particle moves the last one in the list into its place
+				for (int k = int(ids.size()) - 1; k >= 0; k--)
 				{
-					r = pmap[ny][nx];
-					if (!r)
-					{
+					int i = ids[k];
+					nx = (int)(parts[i].x + 0.5f);
+					ny = (int)(parts[i].y + 0.5f);
+					// Only the particle pmap shows counts
+					if (parts[i].type != t || nx < 0 || ny < 0 || nx >= XRES - 4 || ny >= YRES - 4 || !pmap[ny][nx] || ID(pmap[ny][nx]) != i)
 						continue;
-					}
-					else if ((ny < 9 || nx < 9 || ny > YRES - 7 || nx > XRES - 10) && (parts[ID(r)].type == PT_LOVE || parts[ID(r)].type == PT_LOLZ))
-						kill_part(ID(r));
-					else if (parts[ID(r)].type == PT_LOVE)
-					{
+					if (ny < 9 || nx < 9 || ny > YRES - 7 || nx > XRES - 10)
+						kill_part(i);
+					else if (t == PT_LOVE)
 						Element_LOVE_love[nx / 9][ny / 9] = 1;
-					}
-					else if (parts[ID(r)].type == PT_LOLZ)
-					{
+					else
 						Element_LOLZ_lolz[nx / 9][ny / 9] = 1;
-					}
 				}
 			}
 			for (nx = 9; nx <= XRES - 18; nx++)
@@ -5242,23 +6231,20 @@ void Simulation::BeforeSim()
 		// make WIRE work
 		if (elementCount[PT_WIRE] > 0)
 		{
-			for (int nx = 0; nx < XRES; nx++)
+			for (int i : ElementParts(PT_WIRE))
 			{
-				for (int ny = 0; ny < YRES; ny++)
-				{
-					int r = pmap[ny][nx];
-					if (!r)
-						continue;
-					if (parts[ID(r)].type == PT_WIRE)
-						parts[ID(r)].tmp = parts[ID(r)].ctype;
-				}
+				int nx = (int)(parts[i].x + 0.5f);
+				int ny = (int)(parts[i].y + 0.5f);
+				// Only the particle pmap shows counts
+				if (parts[i].type == PT_WIRE && nx >= 0 && ny >= 0 && nx < XRES && ny < YRES && pmap[ny][nx] && ID(pmap[ny][nx]) == i)
+					parts[i].tmp = parts[i].ctype;
 			}
 		}
 
 		// update PPIP tmp?
 		if (Element_PPIP_ppip_changed)
 		{
-			for (int i = 0; i <= parts_lastActiveIndex; i++)
+			for (int i : ElementParts(PT_PPIP))
 			{
 				if (parts[i].type == PT_PPIP)
 				{
@@ -5299,6 +6285,8 @@ void Simulation::BeforeSim()
 
 void Simulation::AfterSim()
 {
+	ProfileScope profile(Profiler::AfterSim);
+	RNGScope rngScope(rng);
 	if (emp_trigger_count)
 	{
 		// pitiful attempt at trying to keep code relating to a given element in the same file
@@ -5306,11 +6294,18 @@ void Simulation::AfterSim()
 		Element_EMP_Trigger(this, emp_trigger_count);
 		emp_trigger_count = 0;
 	}
+	if (loadNextSave && savePreloaded)
+		SwapInNextSave();
+	rewind->Frame();
 }
 
 Simulation::~Simulation()
 {
+	rewind.reset();
+	if (savePreload.joinable())
+		savePreload.join();
 	delete grav;
+	airPipeline.reset();
 	delete air;
 }
 
@@ -5327,6 +6322,7 @@ Simulation::Simulation() : replaceModeSelected(0),
 						   gravWallChanged(false),
 						   CGOL(0),
 						   GSPEED(1),
+						   golGenerations(1),
 						   edgeMode(0),
 						   gravityMode(0),
 						   legacy_enable(0),
@@ -5336,7 +6332,19 @@ Simulation::Simulation() : replaceModeSelected(0),
 						   framerender(0),
 						   pretty_powder(0),
 						   sandcolour_frame(0),
-						   deco_space(0)
+						   deco_space(0),
+						   tiledUpdate(false),
+						   updateThreads(WorkerPool::DefaultSize()),
+						   tiledUpdateCheck(false),
+						   tiledUpdateOverreach(0),
+						   pipelineAir(false),
+						   incrementalPmap(true),
+						   sleepEnabled(false),
+						   compactParticles(false),
+						   compactions(0),
+						   pmapRebuild(true),
+						   partListEnd(NPART),
+						   sleepActive(false)
 {
 	int tportal_rx[] = {-1, 0, 1, 1, 1, 0, -1, -1};
 	int tportal_ry[] = {-1, -1, -1, 0, 1, 1, 1, 0};
@@ -5345,6 +6353,7 @@ Simulation::Simulation() : replaceModeSelected(0),
 	memcpy(portal_ry, tportal_ry, sizeof(tportal_ry));
 
 	currentTick = 0;
+	NewRngSeed();
 	std::fill(elementCount, elementCount + PT_NUM, 0);
 	elementRecount = true;
 
@@ -5365,6 +6374,10 @@ Simulation::Simulation() : replaceModeSelected(0),
 	air->emap = emap;
 	air->fvx = fvx;
 	air->fvy = fvy;
+	air->cellIdle = cellIdle;
+	air->cellAsleep = cellAsleep;
+	airPipeline.reset(new AirPipeline(*air));
+	rewind.reset(new RewindBuffer(*this));
 	//Air sim gives us maps to use
 	vx = air->vx;
 	vy = air->vy;
@@ -5380,6 +6393,17 @@ Simulation::Simulation() : replaceModeSelected(0),
 	player.comm = 0;
 	player2.comm = 0;
 
+	// Elements that reach far across the screen or touch shared state in their
+	// update functions, see NeedsSerialUpdate
+	std::fill(serialUpdateOnly, serialUpdateOnly + PT_NUM, false);
+	for (int t : {
+		PT_STKM, PT_STKM2, PT_FIGH, PT_SPAWN, PT_SPAWN2, PT_LIGH, PT_TESC, PT_ARAY, PT_CRAY, PT_DRAY,
+		PT_FRAY, PT_DTEC, PT_LDTC, PT_TSNS, PT_PSNS, PT_LSNS, PT_VSNS, PT_PSTN, PT_SOAP, PT_SING,
+		PT_EMP, PT_ETRD, PT_WIFI, PT_PRTI, PT_PRTO, PT_PIPE, PT_PPIP, PT_LOVE, PT_LOLZ, PT_LOAD,
+		PT_NOTE, PT_CLIP, PT_BANG,
+	})
+		serialUpdateOnly[t] = true;
+
 	init_can_move();
 	clear_sim();
 
@@ -6,6 +6,9 @@
 #include <cstddef>
 #include <vector>
 #include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
 
 #include "Particle.h"
 #include "Stickman.h"
@@ -13,8 +16,14 @@
 #include "Sign.h"
 #include "ElementDefs.h"
 #include "BuiltinGOL.h"
+#include "GOLBoard.h"
+#include "GOLTiles.h"
+#include "InstNetwork.h"
+#include "LiquidBodies.h"
+#include "SimulationData.h"
 #include "MenuSection.h"
 #include "CoordStack.h"
+#include "common/tpt-rand.h"
 
 #include "Element.h"
 
@@ -32,6 +41,10 @@ class Renderer;
 class Gravity;
 class Air;
 class GameSave;
+class WorkerPool;
+class AirPipeline;
+class RewindBuffer;
+class LevelPack;
 
 class Simulation
 {
@@ -39,6 +52,8 @@ public:
 
 	Gravity * grav;
 	Air * air;
+	// Captures of the last few hundred frames, see AfterSim
+	std::unique_ptr<RewindBuffer> rewind;
 
 	std::vector<sign> signs;
 	std::array<Element, PT_NUM> elements;
@@ -49,9 +64,14 @@ public:
 	std::vector<menu_section> msections;
 
 	int currentTick;
+	// Everything random in a frame comes from streams keyed on rngSeed and
+	// currentTick, see BeforeSim. rng is the stream of the serial update.
+	uint64_t rngSeed;
+	RNG rng;
 	int replaceModeSelected;
 	int replaceModeFlags;
 
+	// The level LoadNextSave loads next, from the level pack if there is one and filePaths otherwise
 	int saveIndex = 0;
 	std::vector<ByteString> filePaths = { "level1.cps", "level2.cps", "level3.cps", "level4.cps" };
 
@@ -83,7 +103,14 @@ public:
 	//Gol sim
 	int CGOL;
 	int GSPEED;
-	unsigned int gol[YRES][XRES][5];
+	// Generations each SimulateGoL runs. GSPEED still sets how often that happens, so raising
+	// this runs patterns faster without drawing every generation. At most MaxGolGenerations, as
+	// patterns golTiles can't run fall back to a whole SimulateGoL per generation.
+	int golGenerations;
+	static const int MaxGolGenerations = 256;
+	GOLBoard golBoard;
+	GOLTiles golTiles;
+	std::vector<int> golDead;
 	//Air sim
 	float (*vx)[XRES/CELL];
 	float (*vy)[XRES/CELL];
@@ -110,19 +137,60 @@ public:
 	int legacy_enable;
 	int aheat_enable;
 	int water_equal_test;
+	// Bodies of liquid for water_equal_test, labelled at most once per frame
+	LiquidBodies liquidBodies;
 	int sys_pause;
 	int framerender;
 	int pretty_powder;
 	int sandcolour;
 	int sandcolour_frame;
 	int deco_space;
+	//Spread UpdateParticles over updateThreads threads, see UpdateParticlesTiled
+	bool tiledUpdate;
+	int updateThreads;
+	//With tiledUpdate, update particles in index order on this thread instead, which comes out exactly as the serial
+	//loop does, and count what the particles given to tiles did further away than tiles allow, see CheckTiledUpdate
+	bool tiledUpdateCheck;
+	unsigned int tiledUpdateOverreach;
+	//Tells CheckTiledUpdate that the particle being updated changed something at x, y, for element
+	//functions that change other particles without going through create_part, kill_part and the like
+	void CheckReach(int x, int y);
+	//Pool of updateThreads threads, also used for the ambient heat update
+	WorkerPool &UpdatePool();
+	//Update air one frame behind on another thread, overlapping with the particle update, see AirPipeline
+	bool pipelineAir;
+	//Keep pmap, photons and pmap_count up to date as particles change instead of rebuilding them every frame
+	bool incrementalPmap;
+	//Skip particles and air in areas where nothing has happened for a while, see UpdateSleep
+	bool sleepEnabled;
+	unsigned char cellIdle[YRES/CELL][XRES/CELL];
+	unsigned char cellAsleep[YRES/CELL][XRES/CELL];
+	//Move particles down to close the gaps in parts while paused or when most of parts is gaps, see CompactParticles
+	bool compactParticles;
+	//Old ID -> new ID from the last CompactParticles that moved anything, -1 for empty slots; compactions counts those calls
+	std::vector<int> compactMap;
+	unsigned int compactions;
 	
 	int LoadNextSave();
+	// Loads the level at index instead of the next one, see LoadNextSave
+	void LoadLevel(int index);
+	int LevelCount();
+	ByteString LevelName(int index);
+	// The index of the level called name, or -1
+	int FindLevel(ByteString name);
+	// Takes levels from pack rather than filePaths, starting from the first; null goes back to filePaths
+	void SetLevelPack(std::shared_ptr<LevelPack> pack);
+	std::shared_ptr<LevelPack> GetLevelPack()
+	{
+		return levelPack;
+	}
 	int Load(GameSave * save, bool includePressure);
 	int Load(GameSave * save, bool includePressure, int x, int y);
 	GameSave * Save(bool includePressure);
 	GameSave * Save(bool includePressure, int x1, int y1, int x2, int y2);
 	void SaveSimOptions(GameSave * gameSave);
+	// Picks a random rngSeed, for when the sim starts over
+	void NewRngSeed();
 	SimulationSample GetSample(int x, int y);
 
 	Snapshot * CreateSnapshot();
@@ -161,8 +229,19 @@ public:
 	int parts_avg(int ci, int ni, int t);
 	void create_arc(int sx, int sy, int dx, int dy, int midpoints, int variance, int type, int flags);
 	void UpdateParticles(int start, int end);
+	void UpdateParticlesTiled();
 	void SimulateGoL();
 	void RecalcFreeParticles(bool do_life_dec);
+	//IDs of the particles of type t, in increasing order. Particles retyped by writing to parts directly only move
+	//to the right list in RecalcFreeParticles, and those killed during a tiled update stay until then, so check types.
+	std::vector<int> const &ElementParts(int t);
+	int CompactParticles();
+	bool ValidatePmap();
+	//The first difference ValidatePmap found, empty if it found none
+	ByteString pmapMismatch;
+	void UpdateSleep();
+	void WakeCell(int x, int y);
+	void WakeAll();
 	void CheckStacking();
 	void BeforeSim();
 	void AfterSim();
@@ -245,6 +324,107 @@ public:
 
 private:
 	CoordStack& getCoordStackSingleton();
+
+	// A rectangle of the field updated by one thread during a tiled update
+	struct UpdateTile
+	{
+		int x0, y0, x1, y1;
+		std::vector<int> ids;
+		std::vector<int> deferred;
+		// Particles killed by this tile, handed out again before new slots
+		int freeHead, freeTail;
+		// New particles come from the unused tail of parts, every slotStride'th slot
+		int slotNext, slotStride;
+		int lastActive;
+		RNG rng;
+		std::array<int, PT_NUM> countChange;
+	};
+	static thread_local UpdateTile *currentTile;
+	// The tile the particle being updated by CheckTiledUpdate would have been given to
+	UpdateTile *checkTile = nullptr;
+	std::vector<int> updateTileOf;
+	// Rebuilt by ValidatePmap, kept so that checking every frame doesn't allocate
+	std::vector<int> validPmap, validPhotons;
+	std::vector<unsigned int> validCount;
+	std::unique_ptr<WorkerPool> updatePool;
+	std::unique_ptr<AirPipeline> airPipeline;
+	// Shares the pages of the last snapshot taken or restored, which the next
+	// snapshot is taken against, see PagedArray
+	std::unique_ptr<Snapshot> snapshotBase;
+	std::shared_ptr<LevelPack> levelPack;
+	// The level at preloadIndex, read and parsed by savePreload while the
+	// one before it runs, see LoadNextSave
+	std::thread savePreload;
+	std::atomic<bool> savePreloaded { false };
+	std::unique_ptr<GameSave> preloadedSave;
+	int preloadIndex = -1;
+	bool loadNextSave = false;
+	std::vector<UpdateTile> updateTiles;
+	std::vector<int> updateTileIndex;
+	int updatePassStart[5];
+	std::vector<int> updateSerial;
+	bool serialUpdateOnly[PT_NUM];
+
+	int AllocParticle();
+	void FreeParticle(int i);
+	void PreloadNextSave();
+	void SwapInNextSave();
+	void CountElement(int t, int change);
+	bool NeedsSerialUpdate(int i, int x, int y);
+	void CheckTiledUpdate();
+	void UpdateParticleList(int const *ids, int start, int end);
+
+	// Where each particle is entered in pmap_count and pmap/photons, see PartCellOf
+	int partCell[NPART];
+	// Set when pmap, photons, pmap_count and partCell must be rebuilt from scratch
+	bool pmapRebuild;
+	int PartCellOf(int t, int x, int y);
+	void MovePartCell(int i, int cell);
+	void UpdatePartCell(int i);
+	void ReconcilePmap(int i, int t, int x, int y);
+
+	// Particles of each type, see ElementParts. partListType is the type each particle is listed
+	// under and partListIndex where it is in that list; slots from partListEnd on are in no list.
+	std::array<std::vector<int>, PT_NUM> partLists;
+	std::array<bool, PT_NUM> partListSorted;
+	int partListType[NPART];
+	int partListIndex[NPART];
+	int partListEnd;
+	void UpdatePartList(int i);
+
+	// INST laid out as runs for FloodINST, kept until INST appears, disappears or moves
+	InstNetwork instNetwork;
+
+	// Cases try_move and eval_move would otherwise have to look for on every move
+	enum MoveFlags
+	{
+		MOVE_BOUNCEEFFECT = 0x1, // something happens when the move is refused
+		MOVE_SWAPEFFECT = 0x2, // something happens instead of or before swapping
+		MOVE_NONSOLID = 0x4, // neither type is solid, so they may share an unpowered EHOLE
+	};
+	enum WallMove
+	{
+		WALLMOVE_PASS,
+		WALLMOVE_BLOCK,
+		WALLMOVE_EWALL, // blocks unless powered
+		WALLMOVE_EHOLE,
+	};
+	// What walls do to each type, see WallMove
+	unsigned char wallMove[PT_NUM][UI_WALLCOUNT];
+	// MoveFlags for each moving type and type at the destination, set by init_can_move along
+	// with can_move. Unlike can_move these only depend on element properties.
+	unsigned char moveFlags[PT_NUM][PT_NUM];
+
+	void StepGoL();
+	bool SimulateGoLTiles();
+
+	// State of each particle when it last counted as activity, see TrackActivity
+	unsigned int sleepHash[NPART];
+	float sleepTemp[NPART];
+	// Settings that wake everything up when changed
+	std::array<int, 8> sleepSettings;
+	bool sleepActive;
+	void TrackActivity(int i, int x, int y);
 };
 
 #endif /* SIMULATION_H */
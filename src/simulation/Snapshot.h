@@ -1,33 +1,101 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 #include "Particle.h"
 #include "json/json.h"
 
+// A copy of an array, kept in pages of about PageBytes. Pages that hold the
+// same bytes as in the copy it was taken against are shared with that copy
+// rather than copied again, so a history of copies of an array that changes
+// a little at a time costs little more than one copy. Pages never change once
+// made, so copies can be dropped in any order.
+template<class T>
+class PagedArray
+{
+	static constexpr size_t PageBytes = 16384;
+	static constexpr size_t PageSize = PageBytes / sizeof(T) ? PageBytes / sizeof(T) : 1;
+
+	typedef std::vector<T> Page;
+	std::vector<std::shared_ptr<Page const>> pages;
+	size_t size = 0;
+
+public:
+	// Copies count elements from data, sharing pages with base where they're the same
+	void Assign(T const *data, size_t count, PagedArray const *base)
+	{
+		size = count;
+		pages.resize((count + PageSize - 1) / PageSize);
+		for (size_t page = 0; page < pages.size(); page++)
+		{
+			T const *start = data + page * PageSize;
+			size_t length = std::min(PageSize, count - page * PageSize);
+			if (base && page < base->pages.size())
+			{
+				auto &basePage = base->pages[page];
+				if (basePage->size() == length && !std::memcmp(basePage->data(), start, length * sizeof(T)))
+				{
+					pages[page] = basePage;
+					continue;
+				}
+			}
+			pages[page] = std::make_shared<Page const>(start, start + length);
+		}
+	}
+
+	void CopyTo(T *out) const
+	{
+		for (auto &page : pages)
+			out = std::copy(page->begin(), page->end(), out);
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+	// Pages that only this copy holds, for measuring what a copy costs
+	size_t UniqueBytes() const
+	{
+		size_t bytes = 0;
+		for (auto &page : pages)
+			if (page.use_count() == 1)
+				bytes += page->size() * sizeof(T);
+		return bytes;
+	}
+};
+
+/*
+ * The state of a simulation, for undo. Simulation::CreateSnapshot takes each
+ * one against the last one it took or restored, so only the pages that have
+ * changed since then take up memory.
+ */
 class Snapshot
 {
 public:
-	std::vector<float> AirPressure;
-	std::vector<float> AirVelocityX;
-	std::vector<float> AirVelocityY;
-	std::vector<float> AmbientHeat;
+	PagedArray<float> AirPressure;
+	PagedArray<float> AirVelocityX;
+	PagedArray<float> AirVelocityY;
+	PagedArray<float> AmbientHeat;
 
-	std::vector<Particle> Particles;
+	PagedArray<Particle> Particles;
 
-	std::vector<float> GravVelocityX;
-	std::vector<float> GravVelocityY;
-	std::vector<float> GravValue;
-	std::vector<float> GravMap;
+	PagedArray<float> GravVelocityX;
+	PagedArray<float> GravVelocityY;
+	PagedArray<float> GravValue;
+	PagedArray<float> GravMap;
 
-	std::vector<unsigned char> BlockMap;
-	std::vector<unsigned char> ElecMap;
+	PagedArray<unsigned char> BlockMap;
+	PagedArray<unsigned char> ElecMap;
 
-	std::vector<float> FanVelocityX;
-	std::vector<float> FanVelocityY;
+	PagedArray<float> FanVelocityX;
+	PagedArray<float> FanVelocityY;
 
 
-	std::vector<Particle> PortalParticles;
+	PagedArray<Particle> PortalParticles;
 	std::vector<int> WirelessData;
 	std::vector<playerst> stickmen;
 	std::vector<sign> signs;
@@ -35,20 +103,6 @@ public:
 	Json::Value Authors;
 
 	Snapshot() :
-		AirPressure(),
-		AirVelocityX(),
-		AirVelocityY(),
-		AmbientHeat(),
-		Particles(),
-		GravVelocityX(),
-		GravVelocityY(),
-		GravValue(),
-		GravMap(),
-		BlockMap(),
-		ElecMap(),
-		FanVelocityX(),
-		FanVelocityY(),
-		PortalParticles(),
 		WirelessData(),
 		stickmen(),
 		signs()
@@ -60,4 +114,15 @@ public:
 	{
 
 	}
+
+	// Memory held by this snapshot alone
+	size_t UniqueBytes() const
+	{
+		return AirPressure.UniqueBytes() + AirVelocityX.UniqueBytes() + AirVelocityY.UniqueBytes() + AmbientHeat.UniqueBytes() +
+			Particles.UniqueBytes() +
+			GravVelocityX.UniqueBytes() + GravVelocityY.UniqueBytes() + GravValue.UniqueBytes() + GravMap.UniqueBytes() +
+			BlockMap.UniqueBytes() + ElecMap.UniqueBytes() + FanVelocityX.UniqueBytes() + FanVelocityY.UniqueBytes() +
+			PortalParticles.UniqueBytes() +
+			WirelessData.size() * sizeof(int) + stickmen.size() * sizeof(playerst);
+	}
 };
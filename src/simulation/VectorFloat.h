@@ -0,0 +1,141 @@
+#ifndef VECTORFLOAT_H
+#define VECTORFLOAT_H
+#include "Config.h"
+
+#include <cstring>
+
+/*
+ * A handful of float vector operations, enough to write the air stencils once
+ * for every instruction set. Which one is used is decided at compile time by
+ * the x86_sse meson option (X86_AVX2 / X86_SSE2 in Config.h), or by what the
+ * compiler targets with native builds; ARM builds get NEON. Everything else
+ * gets a one lane fallback so code using these always compiles.
+ *
+ * Loads and stores are unaligned. Masks are built from rows of unsigned char
+ * maps such as bmap_blockair, one byte per lane.
+ */
+
+#if defined(X86_AVX2) || defined(__AVX2__)
+# include <immintrin.h>
+# define VECTORFLOAT_NAME "avx2"
+
+struct VectorFloat
+{
+	static const int Width = 8;
+	__m256 v;
+	VectorFloat() {}
+	VectorFloat(__m256 v_) : v(v_) {}
+	VectorFloat(float f) : v(_mm256_set1_ps(f)) {}
+	static VectorFloat Load(float const *p) { return _mm256_loadu_ps(p); }
+	void Store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+struct VectorMask
+{
+	__m256 v;
+	VectorMask(__m256 v_) : v(v_) {}
+	// Lanes where bytes[lane] is zero
+	static VectorMask Zero(unsigned char const *bytes)
+	{
+		__m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(bytes)));
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(wide, _mm256_setzero_si256()));
+	}
+};
+inline VectorFloat operator +(VectorFloat a, VectorFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline VectorFloat operator -(VectorFloat a, VectorFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline VectorFloat operator *(VectorFloat a, VectorFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline VectorMask operator &(VectorMask a, VectorMask b) { return _mm256_and_ps(a.v, b.v); }
+// a where mask is set, b elsewhere
+inline VectorFloat Select(VectorMask mask, VectorFloat a, VectorFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+#elif defined(X86_SSE2) || defined(__SSE2__) || defined(_M_X64)
+# include <emmintrin.h>
+# define VECTORFLOAT_NAME "sse2"
+
+struct VectorFloat
+{
+	static const int Width = 4;
+	__m128 v;
+	VectorFloat() {}
+	VectorFloat(__m128 v_) : v(v_) {}
+	VectorFloat(float f) : v(_mm_set1_ps(f)) {}
+	static VectorFloat Load(float const *p) { return _mm_loadu_ps(p); }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+};
+struct VectorMask
+{
+	__m128 v;
+	VectorMask(__m128 v_) : v(v_) {}
+	static VectorMask Zero(unsigned char const *bytes)
+	{
+		int packed;
+		std::memcpy(&packed, bytes, sizeof(packed));
+		__m128i zero = _mm_setzero_si128();
+		__m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(wide, zero));
+	}
+};
+inline VectorFloat operator +(VectorFloat a, VectorFloat b) { return _mm_add_ps(a.v, b.v); }
+inline VectorFloat operator -(VectorFloat a, VectorFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline VectorFloat operator *(VectorFloat a, VectorFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline VectorMask operator &(VectorMask a, VectorMask b) { return _mm_and_ps(a.v, b.v); }
+inline VectorFloat Select(VectorMask mask, VectorFloat a, VectorFloat b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define VECTORFLOAT_NAME "neon"
+
+struct VectorFloat
+{
+	static const int Width = 4;
+	float32x4_t v;
+	VectorFloat() {}
+	VectorFloat(float32x4_t v_) : v(v_) {}
+	VectorFloat(float f) : v(vdupq_n_f32(f)) {}
+	static VectorFloat Load(float const *p) { return vld1q_f32(p); }
+	void Store(float *p) const { vst1q_f32(p, v); }
+};
+struct VectorMask
+{
+	uint32x4_t v;
+	VectorMask(uint32x4_t v_) : v(v_) {}
+	static VectorMask Zero(unsigned char const *bytes)
+	{
+		uint32_t packed;
+		std::memcpy(&packed, bytes, sizeof(packed));
+		uint16x4_t wide = vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed))));
+		return vceqq_u32(vmovl_u16(wide), vdupq_n_u32(0));
+	}
+};
+inline VectorFloat operator +(VectorFloat a, VectorFloat b) { return vaddq_f32(a.v, b.v); }
+inline VectorFloat operator -(VectorFloat a, VectorFloat b) { return vsubq_f32(a.v, b.v); }
+inline VectorFloat operator *(VectorFloat a, VectorFloat b) { return vmulq_f32(a.v, b.v); }
+inline VectorMask operator &(VectorMask a, VectorMask b) { return vandq_u32(a.v, b.v); }
+inline VectorFloat Select(VectorMask mask, VectorFloat a, VectorFloat b) { return vbslq_f32(mask.v, a.v, b.v); }
+
+#else
+# define VECTORFLOAT_NAME "none"
+
+struct VectorFloat
+{
+	static const int Width = 1;
+	float v;
+	VectorFloat() {}
+	VectorFloat(float f) : v(f) {}
+	static VectorFloat Load(float const *p) { return *p; }
+	void Store(float *p) const { *p = v; }
+};
+struct VectorMask
+{
+	bool v;
+	VectorMask(bool v_) : v(v_) {}
+	static VectorMask Zero(unsigned char const *bytes) { return !*bytes; }
+};
+inline VectorFloat operator +(VectorFloat a, VectorFloat b) { return a.v + b.v; }
+inline VectorFloat operator -(VectorFloat a, VectorFloat b) { return a.v - b.v; }
+inline VectorFloat operator *(VectorFloat a, VectorFloat b) { return a.v * b.v; }
+inline VectorMask operator &(VectorMask a, VectorMask b) { return a.v && b.v; }
+inline VectorFloat Select(VectorMask mask, VectorFloat a, VectorFloat b) { return mask.v ? a : b; }
+
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadCount):
+	nextIndex(0)
+{
+	for (int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread([this]() { Work(); }));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> g(mutex);
+		stopping = true;
+	}
+	startcv.notify_all();
+	for (auto &thread : threads)
+		thread.join();
+}
+
+int WorkerPool::DefaultSize()
+{
+	int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void WorkerPool::Drain()
+{
+	int index;
+	while ((index = nextIndex.fetch_add(1)) < jobCount)
+		job(index);
+}
+
+void WorkerPool::Work()
+{
+	unsigned int seen = 0;
+	std::unique_lock<std::mutex> l(mutex);
+	while (true)
+	{
+		startcv.wait(l, [this, seen]() { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+		busy++;
+		l.unlock();
+		Drain();
+		l.lock();
+		if (!--busy)
+			donecv.notify_one();
+	}
+}
+
+void WorkerPool::Run(int count, std::function<void(int)> fn)
+{
+	if (count <= 0)
+		return;
+	if (threads.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+	{
+		// A worker that woke up late for the previous job may still be inside Drain
+		std::unique_lock<std::mutex> l(mutex);
+		donecv.wait(l, [this]() { return busy == 0; });
+		job = std::move(fn);
+		jobCount = count;
+		nextIndex = 0;
+		generation++;
+	}
+	startcv.notify_all();
+	Drain();
+	// Wait for workers that picked up this job; workers that wake up late find
+	// nothing left to do and only bump busy briefly
+	std::unique_lock<std::mutex> l(mutex);
+	donecv.wait(l, [this]() { return busy == 0 && nextIndex >= jobCount; });
+	job = nullptr;
+}
@@ -0,0 +1,48 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include "Config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small fixed-size pool of threads used to spread simulation work
+// over several cores. Jobs are handed out as a range of indices; the
+// calling thread takes part in the work and Run only returns once every
+// index has been processed.
+class WorkerPool
+{
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startcv;
+	std::condition_variable donecv;
+	bool stopping = false;
+	unsigned int generation = 0;
+	int busy = 0;
+
+	std::function<void(int)> job;
+	int jobCount = 0;
+	std::atomic<int> nextIndex;
+
+	void Work();
+	void Drain();
+
+public:
+	// threadCount includes the calling thread, so a pool of 1 starts no threads
+	WorkerPool(int threadCount);
+	~WorkerPool();
+
+	int Size() const { return int(threads.size()) + 1; }
+
+	// Calls fn(0) .. fn(count - 1), spread over the pool. Each index is processed
+	// exactly once, but in no particular order or thread.
+	void Run(int count, std::function<void(int)> fn);
+
+	static int DefaultSize();
+};
+
+#endif
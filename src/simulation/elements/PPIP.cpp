@@ -113,6 +113,8 @@ void Element_PPIP_flood_trigger(Simulation * sim, int x, int y, int sparkedBy)
 			}
 			x2++;
 		}
+		sim->CheckReach(x1, y);
+		sim->CheckReach(x2, y);
 		// fill span
 		for (x=x1; x<=x2; x++)
 		{
@@ -0,0 +1,211 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "Test.h"
+#include "client/GameSave.h"
+#include "client/LevelPack.h"
+
+/*
+ * Writes level packs with LevelPack::Write and reads them back, then damages
+ * the file in the ways a pack can be damaged (cut short, spans pointing past
+ * the end, the wrong magic or version) and checks that opening it throws
+ * ParseException rather than reading outside the file.
+ *
+ * The packs are written to the current directory and removed afterwards.
+ *
+ * Usage: test_levelpack
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	char const *path = "test_levelpack.tmp";
+	const size_t headerSize = 12;
+	const size_t entrySize = 32;
+
+	std::vector<char> ReadFile(char const *name)
+	{
+		std::ifstream file(name, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(char const *name, std::vector<char> const &data)
+	{
+		std::ofstream(name, std::ios::binary).write(data.data(), data.size());
+	}
+
+	void PatchU32(std::vector<char> &data, size_t at, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			data[at + i] = char(value >> (i * 8));
+	}
+
+	uint32_t ReadU32At(std::vector<char> const &data, size_t at)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= uint32_t((unsigned char)data[at + i]) << (i * 8);
+		return value;
+	}
+
+	std::vector<char> Bytes(ByteString text)
+	{
+		return std::vector<char>(text.begin(), text.end());
+	}
+
+	// Opens path and checks that it throws ParseException with result, for a damaged file
+	void CheckRejected(ParseException::ParseResult result, ByteString what)
+	{
+		try
+		{
+			LevelPack pack(path);
+			TestCheck(false, what + ": opened");
+		}
+		catch (ParseException &e)
+		{
+			TestCheck(e.result == result, ByteString::Build(what, ": wrong error, ", e.what()));
+		}
+	}
+
+	void RoundTrip()
+	{
+		std::vector<LevelPack::Level> levels(3);
+		levels[0].name = "intro";
+		levels[0].save = Bytes("save 0");
+		levels[0].thumbnail = Bytes("thumbnail 0");
+		levels[0].metadata = "{\"par\":3}";
+		// Zeros and high bytes must come back as they were
+		levels[1].name = "last";
+		levels[1].save = { 0, 1, char(0xFF), 0, char(0x80) };
+		levels[1].metadata = "{}";
+		// Named like an index, which Find only takes as a name
+		levels[2].name = "1";
+		levels[2].save = Bytes("save 2");
+
+		if (!TestCheck(LevelPack::Write(path, levels), "round trip: Write failed"))
+			return;
+		try
+		{
+			LevelPack pack(path);
+			TestCheck(pack.GetPath() == path, "round trip: wrong path");
+			if (!TestCheck(pack.Count() == 3, ByteString::Build("round trip: ", pack.Count(), " levels")))
+				return;
+			for (int i = 0; i < 3; i++)
+			{
+				ByteString level = ByteString::Build("round trip: level ", i);
+				TestCheck(pack.Name(i) == levels[i].name, level + " name");
+				TestCheck(pack.Save(i) == levels[i].save, level + " save");
+				TestCheck(pack.Thumbnail(i) == levels[i].thumbnail, level + " thumbnail");
+				TestCheck(pack.Metadata(i) == levels[i].metadata, level + " metadata");
+			}
+			TestCheck(pack.Find("intro") == 0, "round trip: Find intro");
+			TestCheck(pack.Find("1") == 2, "round trip: Find 1");
+			TestCheck(pack.Find("missing") == -1, "round trip: Find missing");
+			TestCheck(pack.Name(3) == "" && pack.Save(-1).empty() && pack.Thumbnail(3).empty() && pack.Metadata(-1) == "", "round trip: levels out of range");
+		}
+		catch (ParseException &e)
+		{
+			TestCheck(false, ByteString::Build("round trip: ", e.what()));
+		}
+
+		if (!TestCheck(LevelPack::Write(path, {}), "empty pack: Write failed"))
+			return;
+		try
+		{
+			LevelPack pack(path);
+			TestCheck(pack.Count() == 0, "empty pack: has levels");
+		}
+		catch (ParseException &e)
+		{
+			TestCheck(false, ByteString::Build("empty pack: ", e.what()));
+		}
+	}
+
+	void Damaged()
+	{
+		std::vector<LevelPack::Level> levels(2);
+		levels[0].name = "first";
+		levels[0].save = Bytes("first save");
+		levels[1].name = "second";
+		levels[1].save = Bytes("second save");
+		levels[1].metadata = "{}";
+		if (!TestCheck(LevelPack::Write(path, levels), "damaged: Write failed"))
+			return;
+		std::vector<char> good = ReadFile(path);
+		// The save span of the second level
+		size_t offsetAt = headerSize + entrySize + 8, sizeAt = offsetAt + 4;
+
+		std::remove(path);
+		CheckRejected(ParseException::Corrupt, "missing file");
+
+		WriteFile(path, std::vector<char>());
+		CheckRejected(ParseException::Corrupt, "empty file");
+
+		WriteFile(path, std::vector<char>(good.begin(), good.begin() + headerSize - 1));
+		CheckRejected(ParseException::Corrupt, "cut in the header");
+
+		WriteFile(path, std::vector<char>(good.begin(), good.begin() + headerSize + entrySize + 5));
+		CheckRejected(ParseException::Corrupt, "cut in the index");
+
+		WriteFile(path, std::vector<char>(good.begin(), good.end() - 1));
+		CheckRejected(ParseException::Corrupt, "cut in the data");
+
+		auto patched = good;
+		PatchU32(patched, sizeAt, uint32_t(good.size()));
+		WriteFile(path, patched);
+		CheckRejected(ParseException::Corrupt, "span past the end");
+
+		patched = good;
+		PatchU32(patched, offsetAt, uint32_t(good.size()) + 1);
+		PatchU32(patched, sizeAt, 0);
+		WriteFile(path, patched);
+		CheckRejected(ParseException::Corrupt, "offset past the end");
+
+		// offset + size wraps around 32 bits
+		patched = good;
+		PatchU32(patched, sizeAt, UINT32_MAX);
+		WriteFile(path, patched);
+		CheckRejected(ParseException::Corrupt, "oversized span");
+
+		patched = good;
+		PatchU32(patched, 8, UINT32_MAX);
+		WriteFile(path, patched);
+		CheckRejected(ParseException::Corrupt, "oversized level count");
+
+		patched = good;
+		patched[3] = 'X';
+		WriteFile(path, patched);
+		CheckRejected(ParseException::Corrupt, "wrong magic");
+
+		patched = good;
+		PatchU32(patched, 4, LevelPack::Version + 1);
+		WriteFile(path, patched);
+		CheckRejected(ParseException::WrongVersion, "newer version");
+
+		// A span ending exactly at the end of the file is fine
+		patched = good;
+		PatchU32(patched, sizeAt, uint32_t(good.size()) - ReadU32At(good, offsetAt));
+		WriteFile(path, patched);
+		try
+		{
+			LevelPack pack(path);
+			TestCheck(pack.Save(1).size() == good.size() - ReadU32At(good, offsetAt), "span to the end: wrong size");
+		}
+		catch (ParseException &e)
+		{
+			TestCheck(false, ByteString::Build("span to the end: ", e.what()));
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	RoundTrip();
+	Damaged();
+	std::remove(path);
+	return TestResult();
+}
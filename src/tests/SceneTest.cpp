@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+#include "Test.h"
+#include "simulation/Air.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Runs scenes with the serial particle update and compares the result with
+ * the hashes recorded below, so that a change which is meant to leave the
+ * simulation as it was can show that it did. Each scene is also run with
+ * the options that are meant to make no difference, and the pipelined air
+ * update, which is a frame behind, is compared across thread counts.
+ *
+ * The hashes depend on floating point coming out the same, and were taken
+ * from an x86-64 build using SSE2. Other targets, and builds that let the
+ * compiler fuse multiplies and adds, such as -Dnative=true, may differ. Run
+ * with "print" to list the hashes the build at hand gives.
+ *
+ * Usage: test_scenes [print]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	const int frames = 60;
+
+	struct Recorded
+	{
+		char const *scene;
+		uint64_t hash;
+	};
+
+	// After 60 frames
+	const Recorded recorded[] = {
+		{ "mixed", 0xfdb26fe76e8d570bULL },
+		{ "lake", 0x57261164ab77e996ULL },
+		{ "inst", 0x5bba64404762ed36ULL },
+	};
+
+	uint64_t Run(TestScene const &scene, std::function<void(Simulation &)> options)
+	{
+		auto sim = TestSimulation(scene);
+		options(*sim);
+		TestRun(*sim, frames);
+		return TestHash(*sim);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bool print = argc > 1 && ByteString(argv[1]) == "print";
+	for (auto &entry : recorded)
+	{
+		auto &scene = TestGetScene(entry.scene);
+		uint64_t hash = Run(scene, [](Simulation &sim) {
+			sim.updateThreads = 1;
+		});
+		if (print)
+			std::cout << scene.name << " " << TestHex(hash) << std::endl;
+		else
+			TestCheck(hash == entry.hash, scene.name + ": got " + TestHex(hash) + ", expected " + TestHex(entry.hash));
+
+		// Ambient heat is updated in bands on the update threads
+		TestCheck(Run(scene, [](Simulation &sim) {
+			sim.updateThreads = 4;
+		}) == hash, scene.name + ": the serial update depends on the number of threads");
+		TestCheck(Run(scene, [](Simulation &sim) {
+			sim.incrementalPmap = false;
+		}) == hash, scene.name + ": rebuilding pmap every frame changed the result");
+		TestCheck(Run(scene, [](Simulation &sim) {
+			sim.air->vectorise = false;
+		}) == hash, scene.name + ": the scalar air update changed the result");
+
+		uint64_t pipelined = Run(scene, [](Simulation &sim) {
+			sim.pipelineAir = true;
+			sim.updateThreads = 1;
+		});
+		TestCheck(Run(scene, [](Simulation &sim) {
+			sim.pipelineAir = true;
+			sim.updateThreads = 4;
+		}) == pipelined, scene.name + ": the pipelined air update depends on the number of threads");
+	}
+	return TestResult();
+}
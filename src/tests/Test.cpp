@@ -0,0 +1,215 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "common/tpt-rand.h"
+#include "simulation/ElementClasses.h"
+#include "simulation/Simulation.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Fill(Simulation &sim, int x1, int y1, int x2, int y2, int type)
+	{
+		for (int y = y1; y < y2; y++)
+			for (int x = x1; x < x2; x++)
+				if (!sim.pmap[y][x])
+					sim.create_part(-1, x, y, type);
+	}
+
+	void Mixed(Simulation &sim)
+	{
+		static const int types[] = {
+			PT_DUST, PT_WATR, PT_OIL, PT_FIRE, PT_GAS, PT_LAVA, PT_SALT, PT_PLNT,
+			PT_WOOD, PT_METL, PT_ACID, PT_NITR, PT_LIFE, PT_SAND, PT_BCOL, PT_SNOW,
+		};
+		sim.aheat_enable = 1;
+		int k = 0;
+		for (int y = 20; y < YRES - 40; y += 40)
+			for (int x = 20; x < XRES - 40; x += 40)
+			{
+				int type = types[(k++) % 16];
+				for (int yy = y; yy <= y + 30; yy++)
+					for (int xx = x; xx <= x + 30; xx++)
+						sim.create_part(-2, xx, yy, type);
+			}
+	}
+
+	void Lake(Simulation &sim)
+	{
+		sim.water_equal_test = 1;
+		for (int y = 0; y < YRES / CELL; y++)
+			for (int x = 0; x < XRES / CELL; x++)
+				if (!x || !y || x == XRES / CELL - 1 || y == YRES / CELL - 1)
+					sim.bmap[y][x] = WL_WALL;
+		for (int y = CELL; y < YRES - CELL; y++)
+			for (int x = CELL; x < XRES - CELL; x++)
+				if (y > YRES / 2 || (y > 40 && x < 60))
+					sim.create_part(-2, x, y, PT_WATR);
+	}
+
+	void Inst(Simulation &sim)
+	{
+		// Its own generator, so that the layout doesn't depend on what the simulation draws
+		unsigned int state = 99;
+		auto random = [&state](int n) {
+			state = state * 1103515245u + 12345u;
+			return int((state >> 8) % unsigned(n));
+		};
+		for (int wire = 0; wire < 120; wire++)
+		{
+			if (random(2))
+			{
+				int y = CELL + 2 + random(YRES - 2 * CELL - 4), x1 = CELL + 2 + random(XRES - 2 * CELL - 4);
+				int x2 = std::min(XRES - CELL - 3, x1 + random(300));
+				for (int x = x1; x <= x2; x++)
+					sim.create_part(-1, x, y, PT_INST);
+				// Sparked at its left end every few frames
+				if (!(wire % 3) && !sim.pmap[y][x1 - 1])
+				{
+					sim.create_part(-1, x1 - 1, y, PT_PSCN);
+					sim.create_part(-1, x1 - 2, y, PT_BTRY);
+				}
+			}
+			else
+			{
+				int x = CELL + 2 + random(XRES - 2 * CELL - 4), y1 = CELL + 2 + random(YRES - 2 * CELL - 4);
+				int y2 = std::min(YRES - CELL - 3, y1 + random(200));
+				for (int y = y1; y <= y2; y++)
+					sim.create_part(-1, x, y, PT_INST);
+			}
+		}
+		Fill(sim, 300, 100, 360, 140, PT_INST);
+	}
+
+	void Ppip(Simulation &sim)
+	{
+		// Water above pipes that run across the screen, sparked on and off at their ends
+		Fill(sim, CELL, CELL, XRES - CELL, 60, PT_WATR);
+		for (int y = 80; y < YRES - 40; y += 30)
+		{
+			Fill(sim, 60, y, XRES - 60, y + 3, PT_PPIP);
+			Fill(sim, 60, y - 10, 63, y, PT_PPIP);
+			sim.create_part(-1, 59, y + 1, PT_PSCN);
+			sim.create_part(-1, 58, y + 1, PT_BTRY);
+			sim.create_part(-1, XRES - 60, y + 1, PT_NSCN);
+			sim.create_part(-1, XRES - 59, y + 1, PT_BTRY);
+		}
+	}
+
+	void Bang(Simulation &sim)
+	{
+		for (int x = 40; x < XRES - 80; x += 90)
+		{
+			Fill(sim, x, 100, x + 60, 200, PT_BANG);
+			Fill(sim, x + 20, 98, x + 24, 100, PT_FIRE);
+			Fill(sim, x, 250, x + 60, 300, PT_DUST);
+		}
+	}
+
+	void Portals(Simulation &sim)
+	{
+		for (int x = 40; x < XRES - 80; x += 110)
+		{
+			Fill(sim, x, 100, x + 40, 104, PT_PRTI);
+			Fill(sim, x, 280, x + 40, 284, PT_PRTO);
+			for (int cx = x + 5; cx < x + 35; cx += 5)
+			{
+				int i = sim.create_part(-1, cx, 90, PT_CLNE);
+				if (i >= 0)
+					sim.parts[i].ctype = PT_PHOT;
+			}
+		}
+	}
+}
+
+std::vector<TestScene> const &TestScenes()
+{
+	static const std::vector<TestScene> scenes = {
+		{ "mixed", Mixed },
+		{ "lake", Lake },
+		{ "inst", Inst },
+		{ "ppip", Ppip },
+		{ "bang", Bang },
+		{ "portals", Portals },
+	};
+	return scenes;
+}
+
+TestScene const &TestGetScene(ByteString name)
+{
+	for (auto &scene : TestScenes())
+		if (scene.name == name)
+			return scene;
+	throw std::runtime_error("No scene called " + name);
+}
+
+std::unique_ptr<Simulation> TestSimulation(TestScene const &scene)
+{
+	RNG::Ref().seed(1234);
+	std::unique_ptr<Simulation> sim(new Simulation());
+	scene.build(*sim);
+	return sim;
+}
+
+void TestFrame(Simulation &sim)
+{
+	sim.BeforeSim();
+	sim.UpdateParticles(0, NPART);
+	sim.AfterSim();
+}
+
+void TestRun(Simulation &sim, int frames)
+{
+	for (int i = 0; i < frames; i++)
+		TestFrame(sim);
+}
+
+uint64_t TestHash(Simulation const &sim)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto add = [&hash](unsigned char byte) {
+		hash ^= byte;
+		hash *= 1099511628211ULL;
+	};
+	for (int i = 0; i < NPART; i++)
+	{
+		if (!sim.parts[i].type)
+			continue;
+		auto bytes = reinterpret_cast<unsigned char const *>(&sim.parts[i]);
+		for (size_t k = 0; k < sizeof(Particle); k++)
+			add(bytes[k]);
+		hash ^= uint64_t(i);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+ByteString TestHex(uint64_t hash)
+{
+	std::ostringstream out;
+	out << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return out.str();
+}
+
+bool TestCheck(bool ok, ByteString what)
+{
+	if (!ok)
+	{
+		std::cout << "FAIL " << what << std::endl;
+		failures++;
+	}
+	return ok;
+}
+
+int TestResult()
+{
+	if (failures)
+		std::cout << failures << " failed" << std::endl;
+	return failures ? 1 : 0;
+}
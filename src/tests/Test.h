@@ -0,0 +1,57 @@
+#ifndef TEST_H
+#define TEST_H
+#include "Config.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "common/String.h"
+
+class Simulation;
+
+/*
+ * Helpers shared by the test programs in this directory. Each program is a
+ * small standalone executable built with -Dbuild_tests=true and run by
+ * `meson test`. It prints a line for each check that fails and exits with
+ * status 1 if any did.
+ *
+ * Scenes are built here rather than shipped as saves, from a fixed random
+ * seed, so every run starts from the same state:
+ *
+ *   mixed    blocks of sixteen powders, liquids, gases and solids, with ambient heat on
+ *   lake     a walled lake and a column of water, with water equalisation on
+ *   inst     crossing INST wires, some sparked through PSCN by batteries
+ *   ppip     PPIP pipes switched on and off by sparked PSCN and NSCN
+ *   bang     blocks of BANG set off by fire
+ *   portals  photons cloned next to PRTI, coming out of PRTO
+ */
+
+struct TestScene
+{
+	ByteString name;
+	std::function<void(Simulation &)> build;
+};
+
+std::vector<TestScene> const &TestScenes();
+TestScene const &TestGetScene(ByteString name);
+
+// A new simulation with the scene in it. The shared random generator is
+// seeded first, so the simulation's own seed is the same every time.
+std::unique_ptr<Simulation> TestSimulation(TestScene const &scene);
+
+// Runs one full frame the way GameController::Update does
+void TestFrame(Simulation &sim);
+void TestRun(Simulation &sim, int frames);
+
+// FNV-1a hash of every live particle and its index
+uint64_t TestHash(Simulation const &sim);
+ByteString TestHex(uint64_t hash);
+
+// Prints what if ok is false, and remembers the failure for TestResult
+bool TestCheck(bool ok, ByteString what);
+
+// Exit status for main, 1 if any check failed
+int TestResult();
+
+#endif
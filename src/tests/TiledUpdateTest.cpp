@@ -0,0 +1,56 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "Test.h"
+#include "simulation/Simulation.h"
+
+/*
+ * Checks the tiled particle update against the serial loop on every scene:
+ *
+ *   - with tiledUpdateCheck on, the result is the serial loop's, bit for bit,
+ *     and no particle given to a tile reaches further than tiles allow
+ *   - the tiled update comes out the same on one thread and on four, twice
+ *
+ * The tiled update itself visits particles in a different order from the
+ * serial loop, so its result is only compared with itself.
+ *
+ * Usage: test_tiled [frames]
+ */
+
+#ifdef main
+# undef main
+#endif
+
+namespace
+{
+	uint64_t Run(TestScene const &scene, int frames, bool tiled, int threads, bool check, unsigned int *overreach = nullptr)
+	{
+		auto sim = TestSimulation(scene);
+		sim->tiledUpdate = tiled;
+		sim->tiledUpdateCheck = check;
+		sim->updateThreads = threads;
+		TestRun(*sim, frames);
+		if (overreach)
+			*overreach = sim->tiledUpdateOverreach;
+		return TestHash(*sim);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 40;
+	for (auto &scene : TestScenes())
+	{
+		uint64_t serial = Run(scene, frames, false, 1, false);
+		unsigned int overreach;
+		uint64_t checked = Run(scene, frames, true, 4, true, &overreach);
+		TestCheck(checked == serial, scene.name + ": checking the tiled update changed the result");
+		TestCheck(!overreach, ByteString::Build(scene.name, ": particles reached outside their tiles ", overreach, " times"));
+
+		uint64_t single = Run(scene, frames, true, 1, false);
+		for (int repeat = 0; repeat < 2; repeat++)
+			TestCheck(Run(scene, frames, true, 4, false) == single, scene.name + ": the tiled update depends on the number of threads");
+		std::cout << scene.name << " serial " << TestHex(serial) << " tiled " << TestHex(single) << " overreach " << overreach << std::endl;
+	}
+	return TestResult();
+}